@@ -0,0 +1,179 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QStringList>
+
+#include "armnnoptions.h"
+
+#define ARMNN_OPTIONS_FILE "armnn-options.ini"
+#define ARMNN_TIMES_FILE "armnn-times.ini"
+
+#define ARMNN_OPTION_DEFAULT "default"
+#define ARMNN_OPTION_FAST_MATH "fast-math"
+#define ARMNN_OPTION_FP16 "fp16"
+#define ARMNN_OPTION_THREADS "threads="
+
+static QMutex optionsMutex;
+static QMap<QString, armnnOptionSet> modelOptions;
+static armnnOptionSet commandLineOptions;
+static bool commandLineSet = false;
+
+/* Parse a comma separated list of "fast-math", "fp16" and "threads=n", or
+ * "default" for the ArmNN defaults */
+bool armnnOptions::parse(QString optionString, armnnOptionSet &options)
+{
+    armnnOptionSet parsed;
+
+    foreach (QString option, optionString.split(",", QString::SkipEmptyParts)) {
+        option = option.trimmed();
+
+        if (option == ARMNN_OPTION_DEFAULT) {
+            continue;
+        } else if (option == ARMNN_OPTION_FAST_MATH) {
+            parsed.fastMath = true;
+        } else if (option == ARMNN_OPTION_FP16) {
+            parsed.reduceFp16 = true;
+        } else if (option.startsWith(ARMNN_OPTION_THREADS)) {
+            bool valid;
+
+            parsed.threads = option.mid(QString(ARMNN_OPTION_THREADS).length()).toInt(&valid);
+
+            if (!valid || parsed.threads < 1)
+                return false;
+        } else {
+            return false;
+        }
+    }
+
+    options = parsed;
+
+    return true;
+}
+
+/* The inverse of parse(), also used to name the option set in the recorded
+ * times and the benchmark results */
+QString armnnOptions::describe(const armnnOptionSet &options)
+{
+    QStringList optionList;
+
+    if (options.fastMath)
+        optionList << ARMNN_OPTION_FAST_MATH;
+
+    if (options.reduceFp16)
+        optionList << ARMNN_OPTION_FP16;
+
+    if (options.threads > 0)
+        optionList << ARMNN_OPTION_THREADS + QString::number(options.threads);
+
+    if (optionList.isEmpty())
+        return ARMNN_OPTION_DEFAULT;
+
+    return optionList.join(",");
+}
+
+void armnnOptions::setCommandLine(const armnnOptionSet &options)
+{
+    QMutexLocker locker(&optionsMutex);
+
+    commandLineOptions = options;
+    commandLineSet = true;
+}
+
+/* Options set from the menu during this run come first, then the command
+ * line, then the options saved for the model */
+armnnOptionSet armnnOptions::get(QString modelLocation)
+{
+    QString modelKey = QFileInfo(modelLocation).fileName();
+    QMutexLocker locker(&optionsMutex);
+    armnnOptionSet options;
+
+    if (modelOptions.contains(modelKey))
+        return modelOptions[modelKey];
+
+    if (commandLineSet)
+        return commandLineOptions;
+
+    QSettings settings(settingsPath(), QSettings::IniFormat);
+
+    settings.beginGroup(modelKey);
+    options.fastMath = settings.value("fastMath", false).toBool();
+    options.reduceFp16 = settings.value("reduceFp16", false).toBool();
+    options.threads = settings.value("threads", 0).toInt();
+    settings.endGroup();
+
+    modelOptions[modelKey] = options;
+
+    return options;
+}
+
+void armnnOptions::set(QString modelLocation, const armnnOptionSet &options)
+{
+    QString modelKey = QFileInfo(modelLocation).fileName();
+    QMutexLocker locker(&optionsMutex);
+    QSettings settings(settingsPath(), QSettings::IniFormat);
+
+    modelOptions[modelKey] = options;
+
+    settings.beginGroup(modelKey);
+    settings.setValue("fastMath", options.fastMath);
+    settings.setValue("reduceFp16", options.reduceFp16);
+    settings.setValue("threads", options.threads);
+    settings.endGroup();
+
+    if (settings.status() != QSettings::NoError)
+        qWarning("Warning: Cannot save ArmNN options to %s", qPrintable(settingsPath()));
+}
+
+/* Keep the latest delegate init time and mean invoke time of the option set,
+ * and log them so that option sets can be compared from the console */
+void armnnOptions::recordTimes(QString modelLocation, const armnnOptionSet &options, qint64 initTimeMs,
+                               double invokeTimeMs, unsigned long invokeCount)
+{
+    QString modelKey = QFileInfo(modelLocation).fileName();
+    QString optionKey = describe(options);
+    QMutexLocker locker(&optionsMutex);
+    QSettings times(timesPath(), QSettings::IniFormat);
+
+    qInfo("ArmNN %s [%s]: delegate init %lld ms, mean invoke %.1f ms over %lu frames", qPrintable(modelKey),
+          qPrintable(optionKey), initTimeMs, invokeTimeMs, invokeCount);
+
+    times.beginGroup(modelKey);
+    times.beginGroup(optionKey);
+    times.setValue("initMs", initTimeMs);
+    times.setValue("invokeMs", invokeTimeMs);
+    times.setValue("invokeCount", qulonglong(invokeCount));
+
+    times.endGroup();
+    times.endGroup();
+}
+
+QString armnnOptions::settingsPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/" + ARMNN_OPTIONS_FILE;
+}
+
+QString armnnOptions::timesPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + ARMNN_TIMES_FILE;
+}
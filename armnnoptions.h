@@ -0,0 +1,53 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef ARMNNOPTIONS_H
+#define ARMNNOPTIONS_H
+
+#include <QString>
+
+/* Optimizer options passed to the ArmNN delegate. A thread count of 0 uses
+ * the inference thread count of the worker */
+struct armnnOptionSet {
+    bool fastMath = false;
+    bool reduceFp16 = false;
+    int threads = 0;
+};
+
+/* Holds the ArmNN delegate options of each model. Options chosen from the
+ * Inference Engine menu are saved per model file name and used on the next
+ * start, --armnn-options replaces them for every model for one run. The
+ * delegate init time and the mean invoke time are recorded for each option
+ * set so they can be compared later */
+class armnnOptions
+{
+public:
+    static bool parse(QString optionString, armnnOptionSet &options);
+    static QString describe(const armnnOptionSet &options);
+    static void setCommandLine(const armnnOptionSet &options);
+    static armnnOptionSet get(QString modelLocation);
+    static void set(QString modelLocation, const armnnOptionSet &options);
+    static void recordTimes(QString modelLocation, const armnnOptionSet &options, qint64 initTimeMs,
+                            double invokeTimeMs, unsigned long invokeCount);
+
+private:
+    static QString settingsPath();
+    static QString timesPath();
+};
+
+#endif // ARMNNOPTIONS_H
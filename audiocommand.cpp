@@ -17,7 +17,10 @@
  *****************************************************************************************/
 
 #include "audiocommand.h"
+#include "audiotrace.h"
 #include "edge-utils.h"
+#include "pipelinetrace.h"
+#include "threadplacement.h"
 
 #include "ui_mainwindow.h"
 
@@ -76,6 +79,8 @@
 #define VOLUME_THRESHOLD_MAX		0.7
 #define VOLUME_THRESHOLD_DEFAULT	0.2
 
+#define DEBUG_TRACE_FILE "debug.trace"
+
 audioCommand::audioCommand(Ui::MainWindow *ui, QStringList labelFileList, QString inferenceEngine)
 {
     uiAC = ui;
@@ -145,8 +150,11 @@ audioCommand::audioCommand(Ui::MainWindow *ui, QStringList labelFileList, QStrin
 	    audioMode = audio;
 
     debug = false;
-    if (audioMode == audioDebug or audioMode == audioRecordDebug or audioMode == audioPlaybackDebug)
+    debugTrace = nullptr;
+    if (audioMode == audioDebug or audioMode == audioRecordDebug or audioMode == audioPlaybackDebug) {
         debug = true;
+        debugTrace = new audioTrace(DEBUG_TRACE_FILE, sampleRate);
+    }
 
     record = false;
     if (audioMode == audioRecord or audioMode == audioRecordDebug)
@@ -253,6 +261,7 @@ void audioCommand::clearTrail()
 
 void audioCommand::interpretInference(const QVector<float> &receivedTensor, int receivedTimeElapsed)
 {
+    TRACE_SCOPE("interpretInference");
     QString label = "Unknown";
     float confidence = AUDIO_DETECT_THRESHOLD;
 
@@ -349,6 +358,7 @@ void audioCommand::micVolumeDialChanged(int value)
 
 void audioCommand::readAudioFile(QString filePath)
 {
+    TRACE_SCOPE("readAudioFile");
     char* filePath_c = new char [filePath.length() + 1];
     float data[BUFFER_SIZE];
     sf_count_t readFloats;
@@ -451,37 +461,10 @@ static void save_wav(float *buffer, int sampling_rate, int number_of_samples) {
 	sf_close(outfile);
 }
 
-static void debug_to_file(float *input_buffer, float *debug_buffer, int buffer_size,
-		   float threshold) {
-	static FILE *fp = NULL;
-	static int sample = 0;
-	float marker;
-	int i;
-
-	if (fp == NULL) {
-		fp = fopen("debug.txt", "w");
-	}
-
-	for (i = 0; i < buffer_size; i++) {
-		if (i == 0)
-			marker = 1.0;
-		if (i == 1)
-			marker = -1.0;
-		if (i == 2)
-			marker = 0.0;
-		fprintf(fp, "%d %f %f %f %f\n",
-			sample++,
-			marker,
-			input_buffer[i],
-			debug_buffer[i],
-			threshold
-			);
-	}
-}
-
 static enum word_location locate_word(int sampling_rate, int *left, int *right,
-		float *input_buffer, float *working_buffer, float *debug_buffer,
-		int buffers_size, float threshold, bool debug) {
+		float *input_buffer, float *working_buffer,
+		int buffers_size, float threshold, audioTrace *trace) {
+	TRACE_SCOPE("locate_word");
 	int i, j, slice, _left, _right;
 	int window = sampling_rate / 24;
 	float max, absolute;
@@ -512,18 +495,11 @@ static enum word_location locate_word(int sampling_rate, int *left, int *right,
 		}
 	}
 
-	if (debug) {
-		for (i = 0; i < slice; i++) {
-			for (j = i * window;
-			     (j < ((i + 1) * window)) && (j < buffers_size);
-			     j++
-			    ) {
-			     debug_buffer[j] = working_buffer[i];
-			}
-		}
-		debug_to_file(input_buffer, debug_buffer, buffers_size,
-			      threshold);
-	}
+	/* Only the per-window peaks are traced, the debug plot value of
+	 * sample j is working_buffer[j / window] */
+	if (trace)
+		trace->writeRecord(input_buffer, buffers_size, working_buffer,
+				   slice, window, threshold);
 
 	if (_left == -1)
 		return WORD_NOT_FOUND;
@@ -550,7 +526,7 @@ void audioCommand::processWordsFromInputStream(int sampling_rate, bool debug) {
 	bool run_inference = false;
 	int buffer_size = sampling_rate;
 
-	if (!buffer1 or !buffer2 or !buffer3 or !debug_buffer or !working_buffer)
+	if (!buffer1 or !buffer2 or !buffer3 or !working_buffer)
 		return;
 
 	while (true) {
@@ -591,8 +567,8 @@ void audioCommand::processWordsFromInputStream(int sampling_rate, bool debug) {
 		current_search = locate_word(sampling_rate,
 					     &current_left, &current_right,
 					     current_buffer, working_buffer,
-					     debug_buffer, buffer_size,
-					     current_volume_threshold, debug);
+					     buffer_size, current_volume_threshold,
+					     debug ? debugTrace : NULL);
 
 		// At the moment we are discarding WORD_BOTH_EDGES
 		if (current_search == WORD_FOUND) {
@@ -665,7 +641,11 @@ void audioCommand::processWordsFromInputStream(int sampling_rate, bool debug) {
 
 void audioCommand::startListening()
 {
+    pipelineTrace::setThreadName("audio");
+
     if (inputModeAC == micMode && !buttonIdleBlue) {
+        /* Only the microphone is read on its own thread */
+        threadPlacement::applyRole(audioRole);
         processWordsFromInputStream(sampleRate, debug);
     } else if (inputModeAC == audioFileMode) {
         emit requestInference(content.data(), (size_t) sampleRate * sizeof(float));
@@ -821,7 +801,6 @@ bool audioCommand::setupMic()
         buffer1 = (float*)malloc(sizeof(float) * sampleRate);
         buffer2 = (float*)malloc(sizeof(float) * sampleRate);
         buffer3 = (float*)malloc(sizeof(float) * sampleRate);
-        debug_buffer = (float*)malloc(sizeof(float) * sampleRate);
         working_buffer = (float*)malloc(sizeof(float) * sampleRate);
         left = 0;
         right = 0;
@@ -863,7 +842,6 @@ void audioCommand::closeMic()
 
 
     free(working_buffer);
-    free(debug_buffer);
     free(buffer3);
     free(buffer2);
     free(buffer1);
@@ -871,7 +849,6 @@ void audioCommand::closeMic()
     buffer1 = NULL;
     buffer2 = NULL;
     buffer3 = NULL;
-    debug_buffer = NULL;
     working_buffer = NULL;
 
     if (recording_fd != -1)
@@ -880,6 +857,7 @@ void audioCommand::closeMic()
 
 bool audioCommand::recordSecond(float *inputBuffer)
 {
+    TRACE_SCOPE("recordSecond");
     int err;
 
     if (buttonIdleBlue)
@@ -940,4 +918,6 @@ audioCommand::~audioCommand()
 
     if (not playback)
         clearAlsaMixer();
+
+    delete debugTrace;
 }
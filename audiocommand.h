@@ -42,6 +42,7 @@ enum word_location {
 };
 
 class QGraphicsPolygonItem;
+class audioTrace;
 
 namespace Ui { class MainWindow; }
 
@@ -82,6 +83,7 @@ private:
     Input inputModeAC;
     std::thread secThread;
     bool debug;
+    audioTrace *debugTrace;
     bool record;
     bool playback;
     int recording_fd;
@@ -91,7 +93,6 @@ private:
     float *buffer2;
     float *buffer3;
     float *working_buffer;
-    float *debug_buffer;
     float *current_buffer;
     int left, right;
     int sample_left, sample_right, sample_center;
@@ -0,0 +1,152 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <cstring>
+
+#include <QtGlobal>
+
+#include "audiotrace.h"
+
+/* Each buffer holds roughly 20 seconds of 44.1kHz audio */
+#define AUDIO_TRACE_BUFFER_SIZE (4 * 1024 * 1024)
+
+audioTrace::audioTrace(const char *filePath, unsigned int sampleRate) :
+    frontBuffer(AUDIO_TRACE_BUFFER_SIZE), backBuffer(AUDIO_TRACE_BUFFER_SIZE),
+    frontUsed(0), backUsed(0), backPending(false), stopping(false), droppedRecords(0)
+{
+    audioTraceFileHeader fileHeader;
+
+    traceFile = fopen(filePath, "wb");
+
+    if (traceFile == NULL) {
+        qWarning("Warning: Cannot open audio trace file %s", filePath);
+        return;
+    }
+
+    memcpy(fileHeader.magic, AUDIO_TRACE_MAGIC, AUDIO_TRACE_MAGIC_SIZE);
+    fileHeader.version = AUDIO_TRACE_VERSION;
+    fileHeader.sampleRate = sampleRate;
+
+    fwrite(&fileHeader, sizeof(fileHeader), 1, traceFile);
+
+    writerThread = std::thread(&audioTrace::writerLoop, this);
+}
+
+audioTrace::~audioTrace()
+{
+    if (traceFile == NULL)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        stopping = true;
+    }
+    bufferReady.notify_one();
+
+    if (writerThread.joinable())
+        writerThread.join();
+
+    fclose(traceFile);
+
+    if (droppedRecords > 0)
+        qWarning("Warning: Audio trace writer fell behind, %lu records dropped", droppedRecords);
+}
+
+bool audioTrace::isOpen()
+{
+    return traceFile != NULL;
+}
+
+/* Called from the audio capture thread. Only copies the record into the
+ * front buffer, the file is written by the writer thread so the capture
+ * thread is never blocked on disk I/O */
+void audioTrace::writeRecord(const float *inputBuffer, int sampleCount, const float *slices,
+                             int sliceCount, int window, float threshold)
+{
+    audioTraceRecordHeader header;
+
+    if (traceFile == NULL)
+        return;
+
+    header.sampleCount = sampleCount;
+    header.sliceCount = sliceCount;
+    header.window = window;
+    header.threshold = threshold;
+
+    std::lock_guard<std::mutex> lock(bufferMutex);
+
+    if (!appendRecord(header, inputBuffer, slices))
+        droppedRecords++;
+}
+
+bool audioTrace::appendRecord(const audioTraceRecordHeader &header, const float *inputBuffer, const float *slices)
+{
+    size_t inputSize = header.sampleCount * sizeof(float);
+    size_t slicesSize = header.sliceCount * sizeof(float);
+    size_t recordSize = sizeof(header) + inputSize + slicesSize;
+    char *record;
+
+    if (recordSize > frontBuffer.size())
+        return false;
+
+    if (frontUsed + recordSize > frontBuffer.size()) {
+        /* Writer has not finished with the previous buffer yet */
+        if (backPending)
+            return false;
+
+        std::swap(frontBuffer, backBuffer);
+        backUsed = frontUsed;
+        frontUsed = 0;
+        backPending = true;
+        bufferReady.notify_one();
+    }
+
+    record = frontBuffer.data() + frontUsed;
+
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), inputBuffer, inputSize);
+    memcpy(record + sizeof(header) + inputSize, slices, slicesSize);
+
+    frontUsed += recordSize;
+
+    return true;
+}
+
+void audioTrace::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(bufferMutex);
+
+    while (true) {
+        bufferReady.wait(lock, [this] { return backPending || stopping; });
+
+        if (backPending) {
+            /* The back buffer is owned by this thread until backPending is cleared */
+            lock.unlock();
+            fwrite(backBuffer.data(), 1, backUsed, traceFile);
+            lock.lock();
+
+            backUsed = 0;
+            backPending = false;
+        } else {
+            /* Flush whatever is left in the front buffer before exiting */
+            fwrite(frontBuffer.data(), 1, frontUsed, traceFile);
+            frontUsed = 0;
+            break;
+        }
+    }
+}
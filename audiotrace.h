@@ -0,0 +1,81 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef AUDIOTRACE_H
+#define AUDIOTRACE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Binary trace file layout, all values in native (little-endian) byte order:
+ *
+ *   File header:   char magic[8] ("RZATRACE"), uint32 version, uint32 sample rate
+ *   Record header: uint32 sample count, uint32 slice count, uint32 window, float threshold
+ *   Record data:   float input[sample count], float slices[slice count]
+ *
+ * Each record holds one call of locate_word. The slices are the per-window
+ * peak values, so the debug trace value of sample n is slices[n / window].
+ * tools/audio-trace-convert turns the file back into the debug.txt format */
+#define AUDIO_TRACE_MAGIC "RZATRACE"
+#define AUDIO_TRACE_MAGIC_SIZE 8
+#define AUDIO_TRACE_VERSION 1
+
+struct audioTraceFileHeader {
+    char magic[AUDIO_TRACE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t sampleRate;
+};
+
+struct audioTraceRecordHeader {
+    uint32_t sampleCount;
+    uint32_t sliceCount;
+    uint32_t window;
+    float threshold;
+};
+
+class audioTrace
+{
+public:
+    audioTrace(const char *filePath, unsigned int sampleRate);
+    ~audioTrace();
+    bool isOpen();
+    void writeRecord(const float *inputBuffer, int sampleCount, const float *slices,
+                     int sliceCount, int window, float threshold);
+
+private:
+    void writerLoop();
+    bool appendRecord(const audioTraceRecordHeader &header, const float *inputBuffer, const float *slices);
+
+    FILE *traceFile;
+    std::vector<char> frontBuffer;
+    std::vector<char> backBuffer;
+    size_t frontUsed;
+    size_t backUsed;
+    bool backPending;
+    bool stopping;
+    unsigned long droppedRecords;
+    std::mutex bufferMutex;
+    std::condition_variable bufferReady;
+    std::thread writerThread;
+};
+
+#endif // AUDIOTRACE_H
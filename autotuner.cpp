@@ -0,0 +1,149 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QThread>
+
+#include "autotuner.h"
+#include "inferencebenchmark.h"
+
+#define AUTO_TUNE_CACHE_FILE "auto-tune.json"
+#define AUTO_TUNE_WARMUP 3
+#define AUTO_TUNE_ITERATIONS 10
+
+autoTuner::autoTuner(QString boardName)
+{
+    board = boardName;
+    cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + AUTO_TUNE_CACHE_FILE;
+
+    loadCache();
+}
+
+void autoTuner::loadCache()
+{
+    QFile cacheFile(cachePath);
+
+    if (!cacheFile.open(QIODevice::ReadOnly))
+        return;
+
+    cache = QJsonDocument::fromJson(cacheFile.readAll()).object();
+}
+
+void autoTuner::saveCache()
+{
+    QFile cacheFile(cachePath);
+
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+
+    if (!cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Warning: Cannot write auto-tune cache %s", qPrintable(cachePath));
+        return;
+    }
+
+    cacheFile.write(QJsonDocument(cache).toJson());
+}
+
+/* The model is identified by its content so that replacing a model file
+ * with a different one under the same name is tuned again */
+QString autoTuner::cacheKey(QString modelLocation)
+{
+    QCryptographicHash modelHash(QCryptographicHash::Sha256);
+    QFile modelFile(modelLocation);
+
+    if (!modelFile.open(QIODevice::ReadOnly) || !modelHash.addData(&modelFile))
+        return QString();
+
+    return board + "/" + modelHash.result().toHex();
+}
+
+/* Set delegate and threads to the cached configuration for the model, or
+ * tune it now if there is none. Only delegates in candidateDelegates are
+ * considered so the restrictions of each demo mode are kept */
+void autoTuner::selectConfiguration(QString modelLocation, QList<Delegate> candidateDelegates,
+                                    Delegate& delegate, int& threads)
+{
+    QString key = cacheKey(modelLocation);
+    QList<int> candidateThreads;
+    QJsonObject best;
+    qint64 bestTime = -1;
+
+    if (key.isEmpty() || candidateDelegates.isEmpty())
+        return;
+
+    if (cache.contains(key)) {
+        QJsonObject cached = cache[key].toObject();
+        QList<Delegate> cachedDelegate;
+
+        if (inferenceBenchmark::parseDelegates(cached["delegate"].toString(), cachedDelegate) &&
+            candidateDelegates.contains(cachedDelegate.first())) {
+            delegate = cachedDelegate.first();
+            threads = cached["threads"].toInt(threads);
+            return;
+        }
+    }
+
+    /* Try 1, 2, 4... threads up to the number of CPU cores */
+    for (int count = 1; count < QThread::idealThreadCount(); count *= 2)
+        candidateThreads.append(count);
+    candidateThreads.append(QThread::idealThreadCount());
+
+    qInfo("Auto-tuning %s, this is only done once per model...", qPrintable(QFileInfo(modelLocation).fileName()));
+
+    inferenceBenchmark benchmark(board, QStringList() << modelLocation, QString());
+    benchmark.setDelegates(candidateDelegates);
+    benchmark.setThreadCounts(candidateThreads);
+    benchmark.setIterations(AUTO_TUNE_WARMUP, AUTO_TUNE_ITERATIONS);
+
+    foreach (QJsonValue value, benchmark.run()["results"].toArray()) {
+        QJsonObject result = value.toObject();
+
+        if (!result.contains("p50_us") || result["failures"].toInt() > 0)
+            continue;
+
+        if (bestTime < 0 || result["p50_us"].toVariant().toLongLong() < bestTime) {
+            bestTime = result["p50_us"].toVariant().toLongLong();
+            best = result;
+        }
+    }
+
+    if (best.isEmpty()) {
+        qWarning("Warning: Auto-tuning failed, using default configuration");
+        return;
+    }
+
+    inferenceBenchmark::parseDelegates(best["delegate"].toString(), candidateDelegates);
+    delegate = candidateDelegates.first();
+    threads = best["threads"].toInt();
+
+    cache[key] = QJsonObject {
+        { "model", QFileInfo(modelLocation).fileName() },
+        { "delegate", best["delegate"] },
+        { "threads", threads },
+        { "p50_us", best["p50_us"] }
+    };
+    saveCache();
+
+    qInfo("Auto-tune selected %s with %d threads (%lld us)", qPrintable(best["delegate"].toString()),
+          threads, bestTime);
+}
@@ -0,0 +1,48 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+#include "tfliteworker.h"
+
+/* Picks the fastest delegate and thread count for a model by timing a few
+ * invokes of every candidate. Results are cached on disk per model content
+ * and board, so each model is only tuned once per board */
+class autoTuner
+{
+public:
+    explicit autoTuner(QString boardName);
+    void selectConfiguration(QString modelLocation, QList<Delegate> candidateDelegates,
+                             Delegate& delegate, int& threads);
+
+private:
+    QString cacheKey(QString modelLocation);
+    void loadCache();
+    void saveCache();
+
+    QString board;
+    QString cachePath;
+    QJsonObject cache;
+};
+
+#endif // AUTOTUNER_H
@@ -18,6 +18,9 @@
 
 #include <cmath>
 
+#include <QFile>
+#include <QRegularExpression>
+
 #include "edge-utils.h"
 
 enum AudioMode audioMode;
@@ -50,3 +53,52 @@ float edgeUtils::calculateSigmoid(float realNumber)
 {
     return (1 / (1 + exp(-realNumber)));
 }
+
+Board edgeUtils::getBoard(QString boardName)
+{
+    if (boardName == "hihope-rzg2m")
+        return G2M;
+    else if (boardName == "smarc-rzg2l")
+        return G2L;
+    else if (boardName == "smarc-rzg2lc")
+        return G2LC;
+    else if (boardName == "ek874")
+        return G2E;
+
+    return Unknown;
+}
+
+QStringList edgeUtils::readLabelFile(QString labelPath)
+{
+    QFile labelFile;
+    QString fileLine;
+    QStringList labelList;
+
+    labelFile.setFileName(labelPath);
+    if (!labelFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        qFatal("%s could not be opened.", labelPath.toStdString().c_str());
+
+    while (!labelFile.atEnd()) {
+        fileLine = labelFile.readLine();
+        fileLine.remove(QRegularExpression("^\\s*\\d*\\s*"));
+        fileLine.remove(QRegularExpression("\n"));
+        labelList.append(fileLine);
+    }
+
+    labelFile.close();
+
+    return labelList;
+}
+
+bool edgeUtils::isVideoFile(QString mediaPath)
+{
+    QStringList supportedFormats = {".asf", ".avi", ".3gp", ".mp4", ".m4v", ".mov",
+                                    ".flv", ".mpeg", ".mkv", ".webm", ".mxf", ".ogg"};
+
+    foreach(QString format, supportedFormats) {
+        if (mediaPath.endsWith(format, Qt::CaseInsensitive))
+            return true;
+    }
+
+    return false;
+}
@@ -21,7 +21,11 @@
 
 #include <chrono>
 
+#include <QString>
+#include <QStringList>
+
 #define MODEL_PATH_FD_FACE_DETECTION "/opt/rz-edge-ai-demo/models/face_detection_short_range.tflite"
+#define MODEL_PATH_FD_FACE_LANDMARK "/opt/rz-edge-ai-demo/models/face_landmark.tflite"
 
 #define TEXT_INFERENCE "Inference Time: "
 #define TEXT_LOAD_FILE "Load Image/Video"
@@ -56,7 +60,9 @@
 
 enum Board { G2E, G2L, G2LC, G2M, Unknown };
 enum Input { cameraMode, imageMode, videoMode, audioFileMode, micMode };
+enum CameraFormat { uyvyCapture, mjpegCapture, mjpegFullCapture };
 enum Mode { SB, OD, PE, FD, AC };
+enum ThreadRole { guiRole, captureRole, inferenceRole, audioRole };
 enum FaceModel { faceDetect, faceLandmark, irisLandmarkL, irisLandmarkR };
 enum AudioMode {
 	no_audio_selection = 0,
@@ -78,6 +84,9 @@ public:
     void timeTotalFps(bool startingTimer);
     float calculateTotalFps();
     static float calculateSigmoid(float realNumber);
+    static Board getBoard(QString boardName);
+    static QStringList readLabelFile(QString labelPath);
+    static bool isVideoFile(QString mediaPath);
 
 private:
     std::chrono::high_resolution_clock::time_point startTime;
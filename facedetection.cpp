@@ -17,29 +17,31 @@
  *****************************************************************************************/
 
 #include "facedetection.h"
+#include "framepool.h"
+#include "pipelinetrace.h"
+#include "postprocess.h"
 #include "ui_mainwindow.h"
 
+#include <cmath>
+
 #include <opencv2/imgproc/imgproc.hpp>
 
-#include <QEventLoop>
 #include <QGraphicsScene>
 #include <QGraphicsTextItem>
 
-#define FACE_DETECTION_BOX_INDEX 4
-#define FACE_DETECTION_INPUT_SIZE 128.0
-#define FACE_DETECTION_OUTPUT_INDEX 16
-#define FACE_LANDMARK_INPUT_SIZE 192.0
 #define IRIS_LANDMARK_INPUT_SIZE 64.0
 #define IRIS_LANDMARK_IRIS_OUTPUT_INDEX 10
 
-#define ANCHOR_CENTER 0.5
-#define DETECT_BOUNDING_BOX_INCREASE 0.1 //Needed to ensure crop contains entire face
-
 #define IRIS_DIAGRAM_PATH "/opt/rz-edge-ai-demo/logos/iris-detection-diagram.png"
 
 #define STACK_WIDGET_INDEX_FACE_LANDMARK 0
 #define STACK_WIDGET_INDEX_IRIS_LANDMARK 1
 
+#define FACE_BOX_SIZE 4
+
+/* Set with --max-faces */
+static int maxFaces = FACE_DETECTION_MAX_FACES;
+
 struct {
     float x;
     float y;
@@ -48,18 +50,14 @@ struct {
 } eyeLeft, eyeRight;
 
 faceDetection::faceDetection(Ui::MainWindow *ui, QString inferenceEngine, DetectMode detectModeToUse, bool cameraConnect)
+    : modeController(ui, cameraConnect)
 {
     QPixmap irisDiagram(IRIS_DIAGRAM_PATH);
 
     uiFD = ui;
-    inputModeFD = cameraMode;
     faceModel = faceDetect;
     detectMode = detectModeToUse;
-    buttonState = true;
     faceVisible = false;
-    camConnect = cameraConnect;
-
-    utilFD = new edgeUtils();
 
     frameHeight = GRAPHICS_VIEW_HEIGHT;
     frameWidth = GRAPHICS_VIEW_WIDTH;
@@ -86,6 +84,8 @@ faceDetection::faceDetection(Ui::MainWindow *ui, QString inferenceEngine, Detect
     QGraphicsScene *scenePointProjection = new QGraphicsScene(this);
     uiFD->graphicsViewPointPlotFace->setScene(scenePointProjection);
 
+    setStartStopButton(uiFD->pushButtonStartStopFace, uiFD->labelTotalFpsFace);
+
     if (detectMode == irisMode)
         detectIrisMode();
     else
@@ -121,62 +121,9 @@ faceDetection::faceDetection(Ui::MainWindow *ui, QString inferenceEngine, Detect
     faceParts->push_back(pointsIndexREyebrowTop);
 }
 
-void faceDetection::setButtonState(bool enable)
-{
-    buttonState = enable;
-
-    if (buttonState) {
-        uiFD->pushButtonStartStopFace->setText("Start\nInference");
-        uiFD->pushButtonStartStopFace->setStyleSheet(BUTTON_BLUE);
-    } else {
-        uiFD->pushButtonStartStopFace->setText("Stop\nInference");
-        uiFD->pushButtonStartStopFace->setStyleSheet(BUTTON_RED);
-    }
-
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
-}
-
-QVector<float> faceDetection::sortTensorFaceLandmark(const QVector<float> receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-    float nanValue = std::nanf("NAN");
-    float confidenceLevel = edgeUtils::calculateSigmoid(receivedTensor.at(receivedStride));
-
-    for (int i = 0; i < receivedStride; i += 3) {
-
-        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= 1.0) {
-            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
-            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
-        } else {
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-        }
-     }
-
-    return sortedTensor;
-}
-
-QVector<float> faceDetection::sortTensorIrisLandmark(const QVector<float> receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensorIris = QVector<float>();
-
-    float nanValueIris = std::nanf("NAN");
-
-    for (int i = receivedStride; i < receivedTensor.size(); i += 3) {
-        if (receivedTensor.at(i) >= 0 && receivedTensor.at(i + 1) >= 0) {
-            sortedTensorIris.push_back(receivedTensor.at(i));     // x-coordinate
-            sortedTensorIris.push_back(receivedTensor.at(i + 1)); // y-coordinate
-        } else {
-            sortedTensorIris.push_back(nanValueIris);
-            sortedTensorIris.push_back(nanValueIris);
-        }
-    }
-
-    return sortedTensorIris;
-}
-
 void faceDetection::drawPointsFaceLandmark(const QVector<float> &outputTensor, bool updateGraphicalView)
 {
+    TRACE_SCOPE("drawPointsFaceLandmark");
     QPen pen;
     xCoordinate = QVector<float>();
     yCoordinate = QVector<float>();
@@ -216,11 +163,11 @@ void faceDetection::drawPointsFaceLandmark(const QVector<float> &outputTensor, b
         float x = outputTensor[i] * widthMultiplier;
         float y = outputTensor[i + 1] * heightMultiplier;
 
-        /* Ensure coordinates drawn onto image frame are relative to the cropping
-         * region of the original image */
+        /* Ensure coordinates drawn onto image frame are mapped back from the
+         * aligned crop to the original image */
         if (!updateGraphicalView) {
-            y += faceTopLeftY;
-            x += faceTopLeftX;
+            x = faceToFrame(0, 0) * outputTensor[i] + faceToFrame(0, 1) * outputTensor[i + 1] + faceToFrame(0, 2);
+            y = faceToFrame(1, 0) * outputTensor[i] + faceToFrame(1, 1) * outputTensor[i + 1] + faceToFrame(1, 2);
         }
 
         xCoordinate.push_back(x);
@@ -255,40 +202,21 @@ void faceDetection::drawPointsFaceLandmark(const QVector<float> &outputTensor, b
 
 void faceDetection::drawPointsIrisLandmark(const QVector<float> &outputTensor, bool drawLeftEye)
 {
+    TRACE_SCOPE("drawPointsIrisLandmark");
     QBrush brush = QBrush(Qt::white, Qt::Dense6Pattern);
     QPen pen;
     xCoordinate = QVector<float>();
     yCoordinate = QVector<float>();
-    float displayWidth;
-    float displayHeight;
+    const cv::Matx23f &eyeTransform = drawLeftEye ? eyeLeftToFrame : eyeRightToFrame;
 
     pen.setColor(Qt::yellow);
     pen.setWidth(PEN_THICKNESS);
 
-    if (drawLeftEye) {
-        displayWidth = eyeLeft.width / IRIS_LANDMARK_INPUT_SIZE;
-        displayHeight = eyeLeft.height / IRIS_LANDMARK_INPUT_SIZE;
-    } else {
-        displayWidth = eyeRight.width / IRIS_LANDMARK_INPUT_SIZE;
-        displayHeight = eyeRight.height / IRIS_LANDMARK_INPUT_SIZE;
-    }
-
     /* Save x and y coordinates in separate vectors and ensure that they
-     * are relative to the cropping region of the original image */
+     * are mapped back from the eye crop to the original image */
     for (int i = 0; i < IRIS_LANDMARK_IRIS_OUTPUT_INDEX; i += 2) {
-        float xIrisPosition;
-        float yIrisPosition;
-
-        if (drawLeftEye) {
-            xIrisPosition = eyeLeft.x;
-            yIrisPosition = eyeLeft.y;
-        } else {
-            xIrisPosition = eyeRight.x;
-            yIrisPosition = eyeRight.y;
-        }
-
-        xIrisPosition += outputTensor[i] * displayWidth;
-        yIrisPosition += outputTensor[i + 1] * displayHeight;
+        float xIrisPosition = eyeTransform(0, 0) * outputTensor[i] + eyeTransform(0, 1) * outputTensor[i + 1] + eyeTransform(0, 2);
+        float yIrisPosition = eyeTransform(1, 0) * outputTensor[i] + eyeTransform(1, 1) * outputTensor[i + 1] + eyeTransform(1, 2);
 
         xCoordinate.push_back(xIrisPosition);
         yCoordinate.push_back(yIrisPosition);
@@ -319,57 +247,61 @@ void faceDetection::connectLandmarks(int landmark1, int landmark2, bool drawGrap
     }
 }
 
+/* Iris mode results, the right iris being the last model of the chain */
 void faceDetection::runInference(const QVector<float> &receivedTensor, int receivedStride, int receivedTimeElapsed)
 {
-    float totalFps;
-
-    if (detectMode == irisMode)
-        outputTensor = sortTensorIrisLandmark(receivedTensor, receivedStride);
-    else
-        outputTensor = sortTensorFaceLandmark(receivedTensor, receivedStride);
+    outputTensor = postProcess::sortTensorIrisLandmark(receivedTensor, receivedStride);
 
     uiFD->labelInferenceTimeFaceDetection->setText(TEXT_INFERENCE_FACE_DETECTION + QString("%1 ms").arg(timeElaspedFaceDetection));
-
-    if (detectMode == irisMode) {
-        uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK + QString("%1 ms").arg(timeElaspedFaceLandmark));
-        uiFD->labelInferenceTimeIrisLandmark->setText(TEXT_INFERENCE_IRIS_LANDMARK + QString("%1 ms").arg(timeElaspedIrisLeft) + QString(" + %1ms").arg(receivedTimeElapsed));
-    } else {
-        uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK + QString("%1 ms").arg(receivedTimeElapsed));
-    }
+    uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK + QString("%1 ms").arg(timeElaspedFaceLandmark));
+    uiFD->labelInferenceTimeIrisLandmark->setText(TEXT_INFERENCE_IRIS_LANDMARK + QString("%1 ms").arg(timeElaspedIrisLeft) + QString(" + %1ms").arg(receivedTimeElapsed));
 
     emit sendMatToView(resizedMat);
 
-    if (continuousMode) {
-        /* Stop Total FPS timer and display it to GUI, then restart timer before getting the next frame */
-        utilFD->timeTotalFps(false);
-        totalFps = utilFD->calculateTotalFps();
-        uiFD->labelTotalFpsFace->setText(TEXT_TOTAL_FPS + QString::number(double(totalFps), 'f', 1));
-        utilFD->timeTotalFps(true);
+    finishFrame();
 
-        emit getFrame();
-    } else {
-        setButtonState(true);
-    }
+    /* Draw left iris first and then right iris */
+    if (!(eyeLeft.x < 1 || eyeLeft.y < 1 || eyeLeft.width < 1 || eyeLeft.height < 1))
+        drawPointsIrisLandmark(leftEyeTensor, true);
 
-    if (detectMode == irisMode) {
-        /* Draw left iris first and then right iris */
-        if (!(eyeLeft.x < 1 || eyeLeft.y < 1 || eyeLeft.width < 1 || eyeLeft.height < 1))
-            drawPointsIrisLandmark(leftEyeTensor, true);
+    if (!(eyeRight.x < 1 || eyeRight.y < 1 || eyeRight.width < 1 || eyeRight.height < 1))
+        drawPointsIrisLandmark(outputTensor, false);
+}
 
+/* Face mode results of every face found, in the order of faceBoxes. The
+ * point projection shows the most confident face */
+void faceDetection::runFaceLandmarks(const QList<QVector<float>> &receivedTensors, int receivedStride, int receivedTimeElapsed)
+{
+    QString landmarkTime = TEXT_INFERENCE_FACE_LANDMARK + QString("%1 ms").arg(receivedTimeElapsed);
 
-        if (!(eyeRight.x < 1 || eyeRight.y < 1 || eyeRight.width < 1 || eyeRight.height < 1))
-            drawPointsIrisLandmark(outputTensor, false);
+    if (receivedTensors.size() > 1)
+        landmarkTime += QString(" (%1 faces)").arg(receivedTensors.size());
+
+    uiFD->labelInferenceTimeFaceDetection->setText(TEXT_INFERENCE_FACE_DETECTION + QString("%1 ms").arg(timeElaspedFaceDetection));
+    uiFD->labelInferenceTimeFaceLandmark->setText(landmarkTime);
+
+    emit sendMatToView(resizedMat);
+
+    finishFrame();
+
+    for (int i = 0; i < receivedTensors.size() && (i + 1) * FACE_BOX_SIZE <= faceBoxes.size(); i++) {
+        selectFace(i);
+        outputTensor = postProcess::sortTensorFaceLandmark(receivedTensors.at(i), receivedStride);
 
-    } else {
         /* Draw onto image first then the graphical view */
         drawPointsFaceLandmark(outputTensor, false);
-        drawPointsFaceLandmark(outputTensor, true);
+
+        if (i == 0)
+            drawPointsFaceLandmark(outputTensor, true);
     }
 }
 
 void faceDetection::processFace(const cv::Mat &matToProcess)
 {
-    cv::Mat croppedFaceMat;
+    TRACE_SCOPE("processFace");
+    QVector<cv::Mat> faceMats;
+    cv::Mat detectInputMat;
+    cv::Mat faceInputMat;
     bool detectIris;
 
     if (detectMode == irisMode)
@@ -379,73 +311,73 @@ void faceDetection::processFace(const cv::Mat &matToProcess)
 
     faceModel = faceDetect;
 
-    /* Resize cv::Mat and run inference using Face Detection model */
-    cv::resize(matToProcess, resizedMat, cv::Size(frameWidth, frameHeight));
+    /* Resize cv::Mat for display. The last frame may still be shown, so
+     * resize into a free buffer */
+    resizedMat = framePool::acquire(cv::Size(frameWidth, frameHeight), matToProcess.type());
+    cv::resize(matToProcess, resizedMat, resizedMat.size());
+
+    /* Each model input is made straight from the source frame, so it is
+     * only resampled once and keeps the detail of the camera image. Run
+     * inference using Face Detection model */
+    detectInputMat = framePool::acquire(cv::Size(FACE_DETECTION_INPUT_SIZE, FACE_DETECTION_INPUT_SIZE), matToProcess.type());
+    cv::resize(matToProcess, detectInputMat, detectInputMat.size());
+
+    emit sendMatForInference(detectInputMat, faceModel, detectIris);
+
+    /* Crop every face found and run the Face Landmark model on all of them
+     * with one batched inference */
+    if (detectMode == faceMode) {
+        for (int i = 0; (i + 1) * FACE_BOX_SIZE <= faceBoxes.size(); i++) {
+            selectFace(i);
+            faceMats.push_back(warpToInput(matToProcess, faceToFrame, FACE_LANDMARK_INPUT_SIZE));
+        }
 
-    emit sendMatForInference(resizedMat, faceModel, detectIris);
+        emit sendFacesForInference(faceMats);
+        return;
+    }
 
     faceModel = faceLandmark;
 
-    /* Crop cv::Mat using coordinates provided by Face Detection and
-     * run inference using Face Landmark model */
-    cv::Rect cropRegionFace(faceTopLeftX, faceTopLeftY, faceWidth, faceHeight);
+    /* Crop and align the face using coordinates provided by Face Detection
+     * and run inference using Face Landmark model */
+    faceInputMat = warpToInput(matToProcess, faceToFrame, FACE_LANDMARK_INPUT_SIZE);
 
-    croppedFaceMat = resizedMat(cropRegionFace);
-
-    emit sendMatForInference(croppedFaceMat, faceModel, detectIris);
+    emit sendMatForInference(faceInputMat, faceModel, detectIris);
 
     if (detectMode == irisMode)
-        processIris(resizedMat, croppedFaceMat, detectIris);
+        processIris(matToProcess, detectIris);
 }
 
 void faceDetection::updateFrameWithoutInference()
 {
-    int totalIrisModeFps;
-
     uiFD->labelInferenceTimeFaceDetection->setText(TEXT_INFERENCE_FACE_DETECTION + QString("%1 ms").arg(timeElaspedFaceDetection));
     uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK + QString("%1 ms").arg(timeElaspedFaceLandmark));
     uiFD->labelInferenceTimeIrisLandmark->setText(TEXT_INFERENCE_IRIS_LANDMARK);
 
     emit displayFrame();
 
-    if (continuousMode) {
-        /* Stop Total FPS timer and display it to GUI, then restart timer before getting the next frame */
-        utilFD->timeTotalFps(false);
-        totalIrisModeFps = utilFD->calculateTotalFps();
-        uiFD->labelTotalFpsFace->setText(TEXT_TOTAL_FPS + QString::number(double(totalIrisModeFps), 'f', 1));
-        utilFD->timeTotalFps(true);
-
-        emit getFrame();
-    } else {
-        setButtonState(true);
-    }
+    finishFrame();
 }
 
-void faceDetection::processIris(const cv::Mat &resizedInputMat, const cv::Mat &croppedFaceMat, bool detectIris)
+void faceDetection::processIris(const cv::Mat &sourceMat, bool detectIris)
 {
+    TRACE_SCOPE("processIris");
+
     if (faceVisible) {
         cv::Mat croppedEyeMat;
         bool leftEyeInvalid, rightEyeInvalid;
-        float irisScaleWidth = croppedFaceMat.cols / FACE_LANDMARK_INPUT_SIZE;
-        float irisScaleHeight = croppedFaceMat.rows / FACE_LANDMARK_INPUT_SIZE;
-
-        eyeLeft.x = eyeCropCoords.at(0) * irisScaleWidth;
-        eyeLeft.y = eyeCropCoords.at(1) * irisScaleHeight;
-        eyeLeft.width = (eyeCropCoords.at(2) * irisScaleWidth) - eyeLeft.x;
-        eyeLeft.height = (eyeCropCoords.at(3) * irisScaleHeight) - eyeLeft.y;
-
-        /* Scale left eye to the resized image */
-        eyeLeft.x += faceTopLeftX;
-        eyeLeft.y += faceTopLeftY;
 
-        eyeRight.x = eyeCropCoords.at(4) * irisScaleWidth;
-        eyeRight.y = eyeCropCoords.at(5) * irisScaleHeight;
-        eyeRight.width = (eyeCropCoords.at(6) * irisScaleWidth) - eyeRight.x;
-        eyeRight.height = (eyeCropCoords.at(7) * irisScaleHeight) - eyeRight.y;
+        /* Eye regions are kept in Face Landmark input pixels, where the
+         * face is aligned, and mapped to the frame by eyeToFrame() */
+        eyeLeft.x = eyeCropCoords.at(0);
+        eyeLeft.y = eyeCropCoords.at(1);
+        eyeLeft.width = eyeCropCoords.at(2) - eyeLeft.x;
+        eyeLeft.height = eyeCropCoords.at(3) - eyeLeft.y;
 
-        /* Scale right eye to the resized image */
-        eyeRight.x += faceTopLeftX;
-        eyeRight.y += faceTopLeftY;
+        eyeRight.x = eyeCropCoords.at(4);
+        eyeRight.y = eyeCropCoords.at(5);
+        eyeRight.width = eyeCropCoords.at(6) - eyeRight.x;
+        eyeRight.height = eyeCropCoords.at(7) - eyeRight.y;
 
         leftEyeInvalid = eyeLeft.x < 1 || eyeLeft.y < 1 || eyeLeft.width < 1 || eyeLeft.height < 1;
         rightEyeInvalid = eyeRight.x < 1 || eyeRight.y < 1 || eyeRight.width < 1 || eyeRight.height < 1;
@@ -462,9 +394,9 @@ void faceDetection::processIris(const cv::Mat &resizedInputMat, const cv::Mat &c
 
             /* Crop cv::Mat using coordinates provided by Face Landmark and
              * run inference on left eye using Iris Landmark model */
-            cv::Rect cropRegionEyeL(eyeLeft.x, eyeLeft.y, eyeLeft.width, eyeLeft.height);
+            eyeLeftToFrame = eyeToFrame(eyeLeft.x, eyeLeft.y, eyeLeft.width, eyeLeft.height);
 
-            croppedEyeMat = resizedInputMat(cropRegionEyeL);
+            croppedEyeMat = warpToInput(sourceMat, eyeLeftToFrame, IRIS_LANDMARK_INPUT_SIZE);
 
             emit sendMatForInference(croppedEyeMat, faceModel, detectIris);
         }
@@ -479,10 +411,9 @@ void faceDetection::processIris(const cv::Mat &resizedInputMat, const cv::Mat &c
 
             /* Crop cv::Mat using coordinates provided by Face Landmark and
              * run inference on right eye using Iris Landmark model */
-            cv::Rect cropRegionEyeR(eyeRight.x, eyeRight.y, eyeRight.width, eyeRight.height);
-
-            croppedEyeMat = resizedInputMat(cropRegionEyeR);
+            eyeRightToFrame = eyeToFrame(eyeRight.x, eyeRight.y, eyeRight.width, eyeRight.height);
 
+            croppedEyeMat = warpToInput(sourceMat, eyeRightToFrame, IRIS_LANDMARK_INPUT_SIZE);
         }
 
         emit sendMatForInference(croppedEyeMat, faceModel, detectIris);
@@ -494,135 +425,92 @@ void faceDetection::processIris(const cv::Mat &resizedInputMat, const cv::Mat &c
 
 void faceDetection::cropImageFace(const QVector<float> &faceDetectOutputTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat)
 {
-    QVector<QPair<float, float>> anchorCoords;
-    QVector<float> coordinatesTensor;
-    QVector<float> confidenceTensor;
-    QVector<float> croppedFaceDims;
-    float inputImageHeight = receivedMat.rows;
-    float inputImageWidth = receivedMat.cols;
-    float faceDetectScaleHeight = inputImageHeight / FACE_DETECTION_INPUT_SIZE;
-    float faceDetectScaleWidth = inputImageWidth / FACE_DETECTION_INPUT_SIZE;
+    TRACE_SCOPE("cropImageFace");
 
-    timeElaspedFaceDetection = receivedTimeElapsed;
+    /* The model input is scaled from the source frame, the faces are found
+     * in the display frame */
+    Q_UNUSED(receivedMat);
 
-    anchorCoords = generateAnchorCoords(inputImageHeight, inputImageWidth);
-
-    for (int j = receivedStride; j < faceDetectOutputTensor.size(); j ++) {
-        int iteration = j - receivedStride;
-        float confidenceLevel = edgeUtils::calculateSigmoid(faceDetectOutputTensor.at(j));
-
-        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= 1.0) {
-            /* BlazeFace outputs the x and y coordinates as offsets from an anchor point, so
-             * the anchor coordinates must be added to the values */
-            float yCenter = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX) + anchorCoords.at(iteration).second;
-            float xCenter = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 1) + anchorCoords.at(iteration).first;
-            float height = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 2);
-            float width = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 3);
-
-            /* Scale coordinates to the input image and provide the top left coordinates
-             * along with the height and width of the box */
-            float xTopLeft = (xCenter - 2 * width);
-            float yTopLeft = (yCenter - 2 * height);
-            float scaledWidth = width * faceDetectScaleWidth;
-            float scaledHeight = height * faceDetectScaleHeight;
-
-            coordinatesTensor.push_back(xTopLeft);
-            coordinatesTensor.push_back(yTopLeft);
-            coordinatesTensor.push_back(scaledWidth);
-            coordinatesTensor.push_back(scaledHeight);
-            confidenceTensor.push_back(confidenceLevel);
-        }
-    }
+    timeElaspedFaceDetection = receivedTimeElapsed;
 
-    croppedFaceDims = sortBoundingBoxes(confidenceTensor, coordinatesTensor);
+    /* The iris models follow a single face */
+    faceBoxes = postProcess::detectFaces(faceDetectOutputTensor, receivedStride, frameHeight, frameWidth,
+                                         detectMode == irisMode ? 1 : maxFaces, &faceAngles);
 
-    setFaceCropDims(croppedFaceDims);
+    selectFace(0);
 }
 
-QVector<QPair<float, float>> faceDetection::generateAnchorCoords(int inputHeight, int inputWidth)
+/* Crop region of a face found by Face Detection, and the transform from Face
+ * Landmark input pixels to the display frame. The crop is rotated about its
+ * centre so that the eyes are level in the model input */
+void faceDetection::selectFace(int face)
 {
-    /* BlazeFace uses two Conv layers (16x16, 8x8) for anchor computation */
-    QVector<int> anchorGridDims = {16, 8};
-    QVector<int> anchorTotalPoints = {2, 6};
-    QPair<float, float> anchor;
-    QVector<QPair<float, float>> anchorList;
-
-    /* Get x and y anchor coordinates and store the points to a QVector */
-    for (int i = 0; i < anchorGridDims.size(); i++) {
-        int gridSize = anchorGridDims.at(i);
-        float strideHeight = inputHeight / gridSize;
-        float strideWidth = inputWidth / gridSize;
-        int anchorAmount = anchorTotalPoints.at(i);
-
-        for (int y = 0; y < gridSize; y++) {
-            anchor.second = strideHeight * (y + ANCHOR_CENTER);
-
-            for (int x = 0; x < gridSize; x++) {
-                anchor.first = strideWidth * (x + ANCHOR_CENTER);
-
-                for (int n = 0; n < anchorAmount; n++)
-                    anchorList.push_back(anchor);
-            }
-        }
-    }
+    float angle = faceAngles.value(face);
+    float cosAngle = std::cos(angle);
+    float sinAngle = std::sin(angle);
+    float centreX, centreY;
+
+    setFaceCropDims(faceBoxes.mid(face * FACE_BOX_SIZE, FACE_BOX_SIZE));
 
-    return anchorList;
+    centreX = faceTopLeftX + faceWidth / 2;
+    centreY = faceTopLeftY + faceHeight / 2;
+
+    faceToFrame = cv::Matx23f(cosAngle * faceWidth / FACE_LANDMARK_INPUT_SIZE, -sinAngle * faceHeight / FACE_LANDMARK_INPUT_SIZE,
+                              centreX - (cosAngle * faceWidth - sinAngle * faceHeight) / 2,
+                              sinAngle * faceWidth / FACE_LANDMARK_INPUT_SIZE, cosAngle * faceHeight / FACE_LANDMARK_INPUT_SIZE,
+                              centreY - (sinAngle * faceWidth + cosAngle * faceHeight) / 2);
 }
 
-QVector<float> faceDetection::sortBoundingBoxes(const QVector<float> receivedConfidenceTensor, const QVector<float> receivedCoordinatesTensor)
+/* Transform from Iris Landmark input pixels to the display frame, for an eye
+ * region given in Face Landmark input pixels */
+cv::Matx23f faceDetection::eyeToFrame(float eyeX, float eyeY, float eyeWidth, float eyeHeight)
 {
-    QVector<float> identifiedFaceDims;
-
-    /* Find highest confidence bounding box and store its coordinates into a vector */
-    float maxConfidence = *std::max_element(receivedConfidenceTensor.constBegin(), receivedConfidenceTensor.constEnd());
+    float scaleX = eyeWidth / IRIS_LANDMARK_INPUT_SIZE;
+    float scaleY = eyeHeight / IRIS_LANDMARK_INPUT_SIZE;
 
-    if (maxConfidence > 0) {
-        int indexMaxConfidence = receivedConfidenceTensor.indexOf(maxConfidence, 0);
+    return cv::Matx23f(faceToFrame(0, 0) * scaleX, faceToFrame(0, 1) * scaleY,
+                       faceToFrame(0, 0) * eyeX + faceToFrame(0, 1) * eyeY + faceToFrame(0, 2),
+                       faceToFrame(1, 0) * scaleX, faceToFrame(1, 1) * scaleY,
+                       faceToFrame(1, 0) * eyeX + faceToFrame(1, 1) * eyeY + faceToFrame(1, 2));
+}
 
-        identifiedFaceDims.push_back(receivedCoordinatesTensor.at(FACE_DETECTION_BOX_INDEX * indexMaxConfidence));
-        identifiedFaceDims.push_back(receivedCoordinatesTensor.at((FACE_DETECTION_BOX_INDEX * indexMaxConfidence) + 1));
-        identifiedFaceDims.push_back(receivedCoordinatesTensor.at((FACE_DETECTION_BOX_INDEX * indexMaxConfidence) + 2));
-        identifiedFaceDims.push_back(receivedCoordinatesTensor.at((FACE_DETECTION_BOX_INDEX * indexMaxConfidence) + 3));
-    } else {
-        /* Set crop dimensions to Face Landmark input size when a face is not identified */
-        identifiedFaceDims.push_back(0);
-        identifiedFaceDims.push_back(0);
-        identifiedFaceDims.push_back(FACE_LANDMARK_INPUT_SIZE);
-        identifiedFaceDims.push_back(FACE_LANDMARK_INPUT_SIZE);
+/* Resample a region of the source frame into a square model input with one
+ * warp, instead of resizing the frame, cropping it and letting the worker
+ * resize the crop again. inputToFrame is in display frame pixels, so it is
+ * scaled up to the source frame first */
+cv::Mat faceDetection::warpToInput(const cv::Mat &sourceMat, const cv::Matx23f &inputToFrame, int inputSize)
+{
+    TRACE_SCOPE("warpToInput");
+    float sourceScaleX = float(sourceMat.cols) / frameWidth;
+    float sourceScaleY = float(sourceMat.rows) / frameHeight;
+    cv::Matx23f inputToSource = inputToFrame;
+    cv::Mat inputMat = framePool::acquire(cv::Size(inputSize, inputSize), sourceMat.type());
+
+    for (int i = 0; i < 3; i++) {
+        inputToSource(0, i) *= sourceScaleX;
+        inputToSource(1, i) *= sourceScaleY;
     }
 
-    return identifiedFaceDims;
+    cv::warpAffine(sourceMat, inputMat, inputToSource, inputMat.size(),
+                   cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT);
+
+    return inputMat;
 }
 
 void faceDetection::setFaceCropDims(const QVector<float> &faceCropTensor)
 {
-    float heightOffset = DETECT_BOUNDING_BOX_INCREASE * frameHeight;
-    float widthOffset = DETECT_BOUNDING_BOX_INCREASE * frameWidth;
-
-    /* Increase the dimensions of the bounding box to ensure crop contains entire face */
-    faceTopLeftX = faceCropTensor.at(0) - widthOffset;
-    faceTopLeftY = faceCropTensor.at(1) - heightOffset;
-    faceWidth = faceCropTensor.at(2) + (2 * widthOffset);
-    faceHeight = faceCropTensor.at(3) + (2 * heightOffset);
-
-    /* Ensure that cropping coordinates are not outside of the image */
-    if (faceTopLeftX < 0)
-        faceTopLeftX = 0;
-
-    if (faceTopLeftY < 0)
-        faceTopLeftY = 0;
+    QVector<float> faceCropDims = postProcess::getFaceCropDims(faceCropTensor, frameHeight, frameWidth);
 
-    if ((faceWidth + faceTopLeftX) > frameWidth)
-        faceWidth = frameWidth - faceTopLeftX;
-
-    if ((faceHeight + faceTopLeftY) > frameHeight)
-        faceHeight = frameHeight - faceTopLeftY;
+    faceTopLeftX = faceCropDims.at(0);
+    faceTopLeftY = faceCropDims.at(1);
+    faceWidth = faceCropDims.at(2);
+    faceHeight = faceCropDims.at(3);
 }
 
 void faceDetection::setIrisCropDims(const QVector<float> &detectedFaceTensor, int receivedStride, int timeElapsed)
 {
     QVector <int> pointsEye = { 108, 109, 8, 9, 8, 569, 560, 561 };
-    QVector<float> sortedFaceTensor = sortTensorFaceLandmark(detectedFaceTensor, receivedStride);
+    QVector<float> sortedFaceTensor = postProcess::sortTensorFaceLandmark(detectedFaceTensor, receivedStride);
     float confidenceLevel = edgeUtils::calculateSigmoid(detectedFaceTensor.last());
 
     timeElaspedFaceLandmark = timeElapsed;
@@ -693,12 +581,9 @@ void faceDetection::detectIrisMode()
         displayFrame();
 }
 
-void faceDetection::stopContinuousMode()
+void faceDetection::clearResults()
 {
-    continuousMode = false;
-
-    stopVideo();
-    setButtonState(true);
+    modeController::clearResults();
 
     uiFD->labelInferenceTimeFaceDetection->setText(TEXT_INFERENCE_FACE_DETECTION);
     uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK);
@@ -706,80 +591,23 @@ void faceDetection::stopContinuousMode()
     if (detectMode == irisMode)
         uiFD->labelInferenceTimeIrisLandmark->setText(TEXT_INFERENCE_IRIS_LANDMARK);
 
-    uiFD->labelTotalFpsFace->setText(TEXT_TOTAL_FPS);
     uiFD->graphicsViewPointPlotFace->scene()->clear();
-
-    if (inputModeFD != videoMode)
-        emit startVideo();
 }
 
-void faceDetection::triggerInference()
-{
-    if (inputModeFD == imageMode) {
-        continuousMode = false;
-
-        stopVideo();
-        setButtonState(false);
-
-        emit getFrame();
-    } else {
-        if (buttonState) {
-            continuousMode = true;
-
-            utilFD->timeTotalFps(true);
-            setButtonState(false);
-            stopVideo();
-            emit getFrame();
-        } else {
-            continuousMode = false;
-
-            setButtonState(true);
-
-            if (inputModeFD == videoMode) {
-                stopVideo();
-            } else {
-                startVideo();
-                uiFD->labelInferenceTimeFaceDetection->setText(TEXT_INFERENCE_FACE_DETECTION);
-                uiFD->labelInferenceTimeFaceLandmark->setText(TEXT_INFERENCE_FACE_LANDMARK);
-
-                if (detectMode == irisMode)
-                    uiFD->labelInferenceTimeIrisLandmark->setText(TEXT_INFERENCE_IRIS_LANDMARK);
-
-                uiFD->labelTotalFpsFace->setText(TEXT_TOTAL_FPS);
-                uiFD->graphicsViewPointPlotFace->scene()->clear();
-            }
-        }
-    }
-}
-
-void faceDetection::setCameraMode()
-{
-    inputModeFD = cameraMode;
-
-    uiFD->actionLoad_Periph->setEnabled(false);
-    uiFD->actionLoad_File->setText(TEXT_LOAD_FILE);
-}
-
-void faceDetection::setImageMode()
+void faceDetection::setFrameDims(int height, int width)
 {
-    inputModeFD = imageMode;
-
-    uiFD->actionLoad_Periph->setEnabled(camConnect);
-    uiFD->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
+    frameHeight = height;
+    frameWidth = width;
 }
 
-void faceDetection::setVideoMode()
+void faceDetection::setMaxFaces(int faces)
 {
-    inputModeFD = videoMode;
-
-    uiFD->actionLoad_Periph->setEnabled(camConnect);
-    uiFD->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
+    maxFaces = faces;
 }
 
-void faceDetection::setFrameDims(int height, int width)
+int faceDetection::getMaxFaces()
 {
-    frameHeight = height;
-    frameWidth = width;
+    return maxFaces;
 }
 
 bool faceDetection::getUseIrisMode()
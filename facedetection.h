@@ -24,6 +24,7 @@
 #include <opencv2/videoio.hpp>
 
 #include "edge-utils.h"
+#include "modecontroller.h"
 
 #define TEXT_FACE_MODEL "face_detection_short_range.tflite\nface_landmark.tflite"
 #define TEXT_FACE_MODEL_WITH_IRIS_MODEL "\nface_detection_short_range.tflite\nface_landmark.tflite\niris_landmark.tflite"
@@ -31,70 +32,70 @@
 #define TEXT_INFERENCE_FACE_LANDMARK "Face Landmark: "
 #define TEXT_INFERENCE_IRIS_LANDMARK "Iris Landmark: "
 
+/* Default of --max-faces */
+#define FACE_DETECTION_MAX_FACES 4
+
 namespace Ui { class MainWindow; }
 
 enum DetectMode { faceMode, irisMode };
 
-class faceDetection : public QObject
+class faceDetection : public modeController
 {
     Q_OBJECT
 
 public:
     faceDetection(Ui::MainWindow *ui, QString inferenceEngine, DetectMode detectModeToUse, bool cameraConnect);
     void processFace(const cv::Mat &matToProcess);
-    void setCameraMode();
-    void setImageMode();
-    void setVideoMode();
     void setFrameDims(int height, int width);
     bool getUseIrisMode();
 
+    static void setMaxFaces(int faces);
+    static int getMaxFaces();
+
 public slots:
     void runInference(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed);
+    void runFaceLandmarks(const QList<QVector<float>>& receivedTensors, int receivedStride, int receivedTimeElapsed);
     void cropImageFace(const QVector<float> &faceDetectOutputTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat);
     void setFaceCropDims(const QVector<float>& faceCropTensor);
     void setIrisCropDims(const QVector<float>& detectedFaceTensor, int receivedStride, int timeElapsed);
     void setLeftIrisTensor(const QVector<float>& outputIrisLeftTensor, int receivedStride, int receivedTimeElapsed);
     void detectFaceMode();
     void detectIrisMode();
-    void stopContinuousMode();
-    void triggerInference();
 
 signals:
-    void getFrame();
     void sendMatForInference(const cv::Mat &receivedMat, FaceModel faceModelToUse, bool useFaceDetection);
-    void sendMatToView(const cv::Mat&receivedMat);
-    void startVideo();
-    void stopVideo();
+    void sendFacesForInference(const QVector<cv::Mat> &faceMats);
     void displayFrame();
 
+protected:
+    void clearResults() override;
+
 private:
-    void setButtonState(bool enable);
-    QVector<float> sortTensorFaceLandmark(const QVector<float> receivedTensor, int receivedStride);
-    QVector<float> sortTensorIrisLandmark(const QVector<float> receivedTensor, int receivedStride);
     void drawPointsFaceLandmark(const QVector<float>& outputTensor, bool updateGraphicalView);
     void drawPointsIrisLandmark(const QVector<float>& outputTensor, bool drawLeftEye);
     void connectLandmarks(int landmark1, int landmark2, bool drawGraphicalViewLandmarks);
-    void processIris(const cv::Mat &resizedInputMat, const cv::Mat &croppedFaceMat, bool detectIris);
-    QVector<QPair<float, float>> generateAnchorCoords(int inputHeight, int inputWidth);
-    QVector<float> sortBoundingBoxes(const QVector<float> receivedConfidenceTensor, const QVector<float> receivedCoordinatesTensor);
+    void processIris(const cv::Mat &sourceMat, bool detectIris);
     void updateFrameWithoutInference();
+    void selectFace(int face);
+    cv::Matx23f eyeToFrame(float eyeX, float eyeY, float eyeWidth, float eyeHeight);
+    cv::Mat warpToInput(const cv::Mat &sourceMat, const cv::Matx23f &inputToFrame, int inputSize);
 
     Ui::MainWindow *uiFD;
-    Input inputModeFD;
     FaceModel faceModel;
     DetectMode detectMode;
-    edgeUtils *utilFD;
     QVector<float> outputTensor;
     QVector<float> xCoordinate;
     QVector<float> yCoordinate;
     QVector<float> eyeCropCoords;
+    QVector<float> faceBoxes;
+    QVector<float> faceAngles;
     QVector<float> leftEyeTensor;
     QList<QVector<int>> *faceParts;
     cv::Mat resizedMat;
-    bool continuousMode;
-    bool buttonState;
+    cv::Matx23f faceToFrame;
+    cv::Matx23f eyeLeftToFrame;
+    cv::Matx23f eyeRightToFrame;
     bool faceVisible;
-    bool camConnect;
     int frameHeight;
     int frameWidth;
     int timeElaspedFaceDetection;
@@ -0,0 +1,132 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <mutex>
+#include <vector>
+
+#include "framepool.h"
+
+static std::mutex framePoolMutex;
+static std::vector<cv::Mat> framePoolBuffers;
+static unsigned long framePoolHits = 0;
+static unsigned long framePoolMisses = 0;
+
+/* Only the reference held by the pool is left */
+static bool framePoolBufferFree(const cv::Mat &buffer)
+{
+    return CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+/* A free buffer of the given size and type, allocated when there is none.
+ * When the pool is full a free buffer of another size is dropped to make
+ * room, if every buffer is in use the new one is not pooled */
+cv::Mat framePool::acquire(cv::Size size, int type)
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+    std::vector<cv::Mat>::iterator unusedBuffer = framePoolBuffers.end();
+
+    for (std::vector<cv::Mat>::iterator buffer = framePoolBuffers.begin(); buffer != framePoolBuffers.end(); ++buffer) {
+        if (!framePoolBufferFree(*buffer))
+            continue;
+
+        if (buffer->size() == size && buffer->type() == type) {
+            framePoolHits++;
+            return *buffer;
+        }
+
+        unusedBuffer = buffer;
+    }
+
+    framePoolMisses++;
+
+    if (framePoolBuffers.size() >= FRAME_POOL_MAX_BUFFERS) {
+        if (unusedBuffer == framePoolBuffers.end())
+            return cv::Mat(size, type);
+
+        framePoolBuffers.erase(unusedBuffer);
+    }
+
+    framePoolBuffers.push_back(cv::Mat(size, type));
+
+    return framePoolBuffers.back();
+}
+
+/* A pooled deep copy, for frames that are kept beyond the life of the
+ * buffer they were read into */
+cv::Mat framePool::copy(const cv::Mat &source)
+{
+    cv::Mat copiedMat;
+
+    if (source.empty())
+        return copiedMat;
+
+    copiedMat = acquire(source.size(), source.type());
+    source.copyTo(copiedMat);
+
+    return copiedMat;
+}
+
+/* Allocate buffers up front, so that even the first frames do not allocate.
+ * Counts buffers of the same size and type that are already pooled */
+void framePool::reserve(cv::Size size, int type, unsigned int count)
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+    unsigned int matchingBuffers = 0;
+
+    for (const cv::Mat &buffer : framePoolBuffers) {
+        if (buffer.size() == size && buffer.type() == type)
+            matchingBuffers++;
+    }
+
+    while (matchingBuffers < count && framePoolBuffers.size() < FRAME_POOL_MAX_BUFFERS) {
+        framePoolBuffers.push_back(cv::Mat(size, type));
+        matchingBuffers++;
+    }
+}
+
+unsigned long framePool::getHits()
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+
+    return framePoolHits;
+}
+
+unsigned long framePool::getMisses()
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+
+    return framePoolMisses;
+}
+
+size_t framePool::getBufferCount()
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+
+    return framePoolBuffers.size();
+}
+
+size_t framePool::getBufferBytes()
+{
+    std::lock_guard<std::mutex> lock(framePoolMutex);
+    size_t bufferBytes = 0;
+
+    for (const cv::Mat &buffer : framePoolBuffers)
+        bufferBytes += buffer.total() * buffer.elemSize();
+
+    return bufferBytes;
+}
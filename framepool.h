@@ -0,0 +1,47 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <cstddef>
+
+#include <opencv2/core.hpp>
+
+/* Enough for the camera frames in flight, the model inputs and the frames
+ * held by the interpreter pool */
+#define FRAME_POOL_MAX_BUFFERS 48
+
+/* Reuses frame buffers instead of allocating new ones for every frame.
+ * Buffers are handed out as ordinary cv::Mat objects, which count the
+ * references to their data. The pool keeps one reference to each buffer,
+ * so a buffer is free again once every stage it was passed to has dropped
+ * its cv::Mat. Buffers come from cv::fastMalloc, aligned for SIMD */
+class framePool
+{
+public:
+    static cv::Mat acquire(cv::Size size, int type);
+    static cv::Mat copy(const cv::Mat &source);
+    static void reserve(cv::Size size, int type, unsigned int count);
+    static unsigned long getHits();
+    static unsigned long getMisses();
+    static size_t getBufferCount();
+    static size_t getBufferBytes();
+};
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,560 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <gst/video/video.h>
+
+#include "gstvideoreader.h"
+#include "pipelinetrace.h"
+
+#define GST_HW_DECODE_PIPELINE " ! qtdemux ! queue ! h264parse ! omxh264dec"
+#define GST_SW_DECODE_PIPELINE " ! decodebin"
+#define GST_REAL_TIME_PACING " ! identity sync=true"
+#define GST_LEAKY_QUEUE " leaky=downstream max-size-buffers=1"
+#define GST_HW_CONVERT "vspmfilter dmabuf-use=true"
+#define GST_SW_CONVERT "videoscale add-borders=false ! videoconvert"
+
+#define DISPLAY_SINK_NAME "displaysink"
+#define MODEL_SINK_NAME "modelsink"
+#define DISPLAY_QUEUE_NAME "displayqueue"
+#define MODEL_QUEUE_NAME "modelqueue"
+
+#define PREROLL_TIMEOUT (5 * GST_SECOND)
+
+gstVideoReader::gstVideoReader()
+{
+    pipeline = nullptr;
+    useModelSink = false;
+    queueLimit = GST_READER_DEFAULT_MAX_BUFFERS;
+    dropFrames = false;
+    realTime = false;
+    looping = false;
+    segmentDone = false;
+    droppedFrames = 0;
+    endReached = false;
+    flushing = false;
+
+    displayQueue.appsink = nullptr;
+    displayQueue.currentSample = nullptr;
+    displayQueue.currentBuffer = nullptr;
+    modelQueue.appsink = nullptr;
+    modelQueue.currentSample = nullptr;
+    modelQueue.currentBuffer = nullptr;
+}
+
+gstVideoReader::~gstVideoReader()
+{
+    close();
+}
+
+/* Number of decoded frames each sink may hold ahead of read(). When the
+ * limit is reached the oldest frame is dropped if drop is set, otherwise the
+ * streaming thread waits, which holds back the decoder */
+void gstVideoReader::setQueueLimit(unsigned int maxBuffers, bool drop)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    queueLimit = maxBuffers > 0 ? maxBuffers : 1;
+    dropFrames = drop;
+    queueChanged.notify_all();
+}
+
+/* In real time mode the decoded frames are released at the rate given by
+ * their timestamps, like a live camera. Frames that arrive while the reader
+ * is still busy with the previous one are dropped by a leaky queue ahead of
+ * the scaling and colour conversion, so no work is spent on them */
+void gstVideoReader::setRealTime(bool enable)
+{
+    realTime = enable;
+}
+
+/* Loop playback inside the pipeline. The file is played as a segment and
+ * each time the segment finishes a non-flushing seek queues the start of the
+ * file straight after the end, so there is no gap and nothing is rebuilt */
+void gstVideoReader::setLooping(bool enable)
+{
+    looping = enable;
+}
+
+/* Frames dropped by either branch since the pipeline was opened, counted
+ * once each as the display frames that read() never returned */
+unsigned long gstVideoReader::getDroppedFrames()
+{
+    return droppedFrames;
+}
+
+bool gstVideoReader::open(QString videoFilePath, bool hardwareDecode, cv::Size displaySize, cv::Size modelSize)
+{
+    QString convert = hardwareDecode ? GST_HW_CONVERT : GST_SW_CONVERT;
+    QString leaky = realTime ? GST_LEAKY_QUEUE : "";
+    QString videoPipeline;
+    GstStateChangeReturn stateChange = GST_STATE_CHANGE_SUCCESS;
+    GError *error = nullptr;
+
+    close();
+
+    if (!gst_is_initialized())
+        gst_init(nullptr, nullptr);
+
+    useModelSink = !modelSize.empty();
+
+    videoPipeline = "filesrc location=\"" + videoFilePath + "\"" +
+            (hardwareDecode ? GST_HW_DECODE_PIPELINE : GST_SW_DECODE_PIPELINE) +
+            (realTime ? GST_REAL_TIME_PACING : "") + " ! tee name=t" +
+            " t. ! queue name=" DISPLAY_QUEUE_NAME + leaky + " ! " + convert + " ! video/x-raw,format=RGB,width=" + QString::number(displaySize.width) +
+            ",height=" + QString::number(displaySize.height) + " ! appsink name=" DISPLAY_SINK_NAME;
+
+    if (useModelSink)
+        videoPipeline += " t. ! queue name=" MODEL_QUEUE_NAME + leaky + " ! " + convert + " ! video/x-raw,format=RGB,width=" + QString::number(modelSize.width) +
+                ",height=" + QString::number(modelSize.height) + " ! appsink name=" MODEL_SINK_NAME;
+
+    pipeline = gst_parse_launch(videoPipeline.toStdString().c_str(), &error);
+
+    if (error != nullptr) {
+        qWarning("Could not create video pipeline: %s", error->message);
+        g_error_free(error);
+
+        if (pipeline) {
+            gst_object_unref(pipeline);
+            pipeline = nullptr;
+        }
+
+        return false;
+    }
+
+    setupSink(displayQueue, DISPLAY_SINK_NAME);
+
+    if (useModelSink)
+        setupSink(modelQueue, MODEL_SINK_NAME);
+
+    /* Frames dropped on the display branch are counted here. The branches
+     * drop on their own, so a frame lost on the model branch is counted by
+     * read() when it skips the display frame left without a match */
+    if (realTime)
+        setupLeakyQueue(DISPLAY_QUEUE_NAME);
+
+    droppedFrames = 0;
+    endReached = false;
+    segmentDone = false;
+    flushing = false;
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    gst_bus_set_sync_handler(bus, busSyncHandler, this, nullptr);
+    gst_object_unref(bus);
+
+    /* A segment seek can only be made once the pipeline has prerolled. The
+     * real time pacing makes the pipeline behave as a live one, which does
+     * not preroll in PAUSED, so then the seek is made once it is playing */
+    if (looping) {
+        if (gst_element_set_state(pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE) {
+            qWarning("Could not preroll video pipeline");
+            close();
+
+            return false;
+        }
+
+        stateChange = gst_element_get_state(pipeline, nullptr, nullptr, PREROLL_TIMEOUT);
+
+        if (stateChange != GST_STATE_CHANGE_SUCCESS && stateChange != GST_STATE_CHANGE_NO_PREROLL) {
+            qWarning("Could not preroll video pipeline");
+            close();
+
+            return false;
+        }
+
+        if (stateChange == GST_STATE_CHANGE_SUCCESS && !seekToStart(true))
+            qWarning("Segment seek not supported, video will restart at the end instead");
+    }
+
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        qWarning("Could not start video pipeline");
+        close();
+
+        return false;
+    }
+
+    if (looping && stateChange == GST_STATE_CHANGE_NO_PREROLL &&
+        (gst_element_get_state(pipeline, nullptr, nullptr, PREROLL_TIMEOUT) == GST_STATE_CHANGE_FAILURE || !seekToStart(true)))
+        qWarning("Segment seek not supported, video will restart at the end instead");
+
+    return true;
+}
+
+/* Called on the thread that posts the message. Only errors are kept on the
+ * bus for checkBus(), anything else would build up while a video loops. The
+ * loop seek itself is made by read() so it never runs on a streaming thread */
+GstBusSyncReply gstVideoReader::busSyncHandler(GstBus *, GstMessage *message, gpointer userData)
+{
+    gstVideoReader *reader = static_cast<gstVideoReader*>(userData);
+
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+        return GST_BUS_PASS;
+
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_SEGMENT_DONE)
+        return GST_BUS_DROP;
+
+    {
+        std::lock_guard<std::mutex> lock(reader->queueMutex);
+        reader->segmentDone = true;
+    }
+    reader->queueChanged.notify_all();
+
+    return GST_BUS_DROP;
+}
+
+bool gstVideoReader::seekToStart(bool flush)
+{
+    int seekFlags = GST_SEEK_FLAG_KEY_UNIT;
+
+    if (flush)
+        seekFlags |= GST_SEEK_FLAG_FLUSH;
+
+    if (looping)
+        seekFlags |= GST_SEEK_FLAG_SEGMENT;
+
+    return gst_element_seek(pipeline, 1.0, GST_FORMAT_TIME, GstSeekFlags(seekFlags),
+                            GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+}
+
+void gstVideoReader::setupSink(sinkQueue &queue, const char *name)
+{
+    GstAppSinkCallbacks callbacks = {};
+
+    callbacks.eos = endOfStream;
+    callbacks.new_sample = newSample;
+
+    queue.appsink = gst_bin_get_by_name(GST_BIN(pipeline), name);
+
+    /* Samples are taken as soon as they arrive, the queue limit is applied
+     * by queueSample() so appsink itself never holds frames back */
+    gst_app_sink_set_emit_signals(GST_APP_SINK(queue.appsink), FALSE);
+    gst_app_sink_set_max_buffers(GST_APP_SINK(queue.appsink), 1);
+    gst_app_sink_set_drop(GST_APP_SINK(queue.appsink), FALSE);
+    g_object_set(queue.appsink, "sync", FALSE, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(queue.appsink), &callbacks, this, nullptr);
+}
+
+void gstVideoReader::setupLeakyQueue(const char *name)
+{
+    GstElement *queue = gst_bin_get_by_name(GST_BIN(pipeline), name);
+
+    g_signal_connect(queue, "overrun", G_CALLBACK(queueOverrun), this);
+    gst_object_unref(queue);
+}
+
+/* A full leaky queue drops its oldest frame for the new one */
+void gstVideoReader::queueOverrun(GstElement *, gpointer userData)
+{
+    gstVideoReader *reader = static_cast<gstVideoReader*>(userData);
+
+    reader->droppedFrames++;
+}
+
+void gstVideoReader::close()
+{
+    if (pipeline == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        flushing = true;
+    }
+    queueChanged.notify_all();
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    clearQueue(displayQueue);
+    clearQueue(modelQueue);
+
+    if (displayQueue.appsink) {
+        gst_object_unref(displayQueue.appsink);
+        displayQueue.appsink = nullptr;
+    }
+
+    if (modelQueue.appsink) {
+        gst_object_unref(modelQueue.appsink);
+        modelQueue.appsink = nullptr;
+    }
+
+    gst_object_unref(pipeline);
+    pipeline = nullptr;
+
+    if (droppedFrames > 0)
+        qWarning("Video playback could not keep up, %lu frames dropped", (unsigned long) droppedFrames);
+}
+
+bool gstVideoReader::isOpened()
+{
+    return pipeline != nullptr;
+}
+
+/* Called on the streaming thread of each branch */
+GstFlowReturn gstVideoReader::newSample(GstAppSink *appsink, gpointer userData)
+{
+    gstVideoReader *reader = static_cast<gstVideoReader*>(userData);
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+
+    if (sample == nullptr)
+        return GST_FLOW_EOS;
+
+    if (GST_ELEMENT(appsink) == reader->modelQueue.appsink)
+        reader->queueSample(reader->modelQueue, sample);
+    else
+        reader->queueSample(reader->displayQueue, sample);
+
+    return GST_FLOW_OK;
+}
+
+void gstVideoReader::endOfStream(GstAppSink *, gpointer userData)
+{
+    gstVideoReader *reader = static_cast<gstVideoReader*>(userData);
+
+    {
+        std::lock_guard<std::mutex> lock(reader->queueMutex);
+        reader->endReached = true;
+    }
+    reader->queueChanged.notify_all();
+}
+
+void gstVideoReader::queueSample(sinkQueue &queue, GstSample *sample)
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    if (!dropFrames)
+        queueChanged.wait(lock, [&] { return flushing || dropFrames || queue.samples.size() < queueLimit; });
+
+    if (flushing) {
+        gst_sample_unref(sample);
+        return;
+    }
+
+    while (queue.samples.size() >= queueLimit) {
+        gst_sample_unref(queue.samples.front());
+        queue.samples.pop_front();
+
+        if (&queue == &displayQueue)
+            droppedFrames++;
+    }
+
+    queue.samples.push_back(sample);
+    queueChanged.notify_all();
+}
+
+/* Returns the next display frame and, when the pipeline was opened with a
+ * model size, the model frame with the same timestamp. Both frames stay
+ * valid until the next call. Returns false at the end of the file or on a
+ * pipeline error */
+bool gstVideoReader::read(cv::Mat &displayFrame, cv::Mat &modelFrame)
+{
+    TRACE_SCOPE("videoRead");
+
+    if (pipeline == nullptr || !checkBus())
+        return false;
+
+    releaseCurrent(displayQueue);
+    releaseCurrent(modelQueue);
+
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+
+        while (true) {
+            queueChanged.wait(lock, [&] { return segmentDone || endReached || framesReady(); });
+
+            if (segmentDone) {
+                segmentDone = false;
+                lock.unlock();
+
+                if (!seekToStart(false))
+                    qWarning("Could not loop video playback");
+
+                lock.lock();
+                continue;
+            }
+
+            if (!framesReady())
+                return false;
+
+            if (!useModelSink)
+                break;
+
+            /* The branches only go out of step when frames were dropped, skip
+             * the older frame until both sinks hold the same one. Running time
+             * keeps increasing across loops, unlike the buffer timestamps */
+            GstClockTime displayTime = sampleRunningTime(displayQueue.samples.front());
+            GstClockTime modelTime = sampleRunningTime(modelQueue.samples.front());
+
+            if (displayTime == modelTime)
+                break;
+
+            sinkQueue &older = (displayTime < modelTime) ? displayQueue : modelQueue;
+            gst_sample_unref(older.samples.front());
+            older.samples.pop_front();
+
+            if (&older == &displayQueue)
+                droppedFrames++;
+
+            /* The streaming thread of that branch may be waiting for room */
+            queueChanged.notify_all();
+        }
+
+        displayQueue.currentSample = displayQueue.samples.front();
+        displayQueue.samples.pop_front();
+
+        if (useModelSink) {
+            modelQueue.currentSample = modelQueue.samples.front();
+            modelQueue.samples.pop_front();
+        }
+    }
+    queueChanged.notify_all();
+
+    if (!mapSample(displayQueue, displayFrame))
+        return false;
+
+    if (useModelSink)
+        return mapSample(modelQueue, modelFrame);
+
+    modelFrame.release();
+
+    return true;
+}
+
+/* Timestamp of the frame returned by the last read(), from the start of
+ * the file. Unlike the running time it starts again on every loop */
+GstClockTime gstVideoReader::getFrameTime()
+{
+    if (displayQueue.currentSample == nullptr)
+        return GST_CLOCK_TIME_NONE;
+
+    return GST_BUFFER_PTS(gst_sample_get_buffer(displayQueue.currentSample));
+}
+
+/* Must be called with queueMutex held */
+bool gstVideoReader::framesReady()
+{
+    return !displayQueue.samples.empty() && (!useModelSink || !modelQueue.samples.empty());
+}
+
+GstClockTime gstVideoReader::sampleRunningTime(GstSample *sample)
+{
+    return gst_segment_to_running_time(gst_sample_get_segment(sample), GST_FORMAT_TIME,
+                                       GST_BUFFER_PTS(gst_sample_get_buffer(sample)));
+}
+
+/* Wraps the sample memory in a cv::Mat without copying it */
+bool gstVideoReader::mapSample(sinkQueue &queue, cv::Mat &frame)
+{
+    GstVideoInfo videoInfo;
+
+    if (!gst_video_info_from_caps(&videoInfo, gst_sample_get_caps(queue.currentSample))) {
+        qWarning("Could not read video frame format");
+        return false;
+    }
+
+    queue.currentBuffer = gst_sample_get_buffer(queue.currentSample);
+
+    if (!gst_buffer_map(queue.currentBuffer, &queue.currentMap, GST_MAP_READ)) {
+        qWarning("Could not map video frame");
+        queue.currentBuffer = nullptr;
+        return false;
+    }
+
+    frame = cv::Mat(GST_VIDEO_INFO_HEIGHT(&videoInfo), GST_VIDEO_INFO_WIDTH(&videoInfo), CV_8UC3,
+                    queue.currentMap.data, GST_VIDEO_INFO_PLANE_STRIDE(&videoInfo, 0));
+
+    return true;
+}
+
+void gstVideoReader::releaseCurrent(sinkQueue &queue)
+{
+    if (queue.currentSample == nullptr)
+        return;
+
+    if (queue.currentBuffer)
+        gst_buffer_unmap(queue.currentBuffer, &queue.currentMap);
+
+    gst_sample_unref(queue.currentSample);
+    queue.currentSample = nullptr;
+    queue.currentBuffer = nullptr;
+}
+
+void gstVideoReader::clearQueue(sinkQueue &queue)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    releaseCurrent(queue);
+
+    for (GstSample *sample : queue.samples)
+        gst_sample_unref(sample);
+
+    queue.samples.clear();
+}
+
+/* Seek back to the start of the file after the end was reached, for when
+ * the segment seek loop is not available */
+bool gstVideoReader::rewind()
+{
+    if (pipeline == nullptr)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        flushing = true;
+    }
+    queueChanged.notify_all();
+
+    clearQueue(displayQueue);
+    clearQueue(modelQueue);
+
+    bool seeked = seekToStart(true) ||
+            gst_element_seek_simple(pipeline, GST_FORMAT_TIME, GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), 0);
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        flushing = false;
+        endReached = false;
+        segmentDone = false;
+    }
+
+    if (!seeked)
+        qWarning("Could not restart video playback");
+
+    return seeked;
+}
+
+bool gstVideoReader::checkBus()
+{
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+    bool pipelineOk = true;
+
+    if (message != nullptr) {
+        GError *error = nullptr;
+
+        gst_message_parse_error(message, &error, nullptr);
+        qWarning("Video pipeline error: %s", error ? error->message : "unknown");
+
+        if (error)
+            g_error_free(error);
+
+        gst_message_unref(message);
+        pipelineOk = false;
+    }
+
+    gst_object_unref(bus);
+
+    return pipelineOk;
+}
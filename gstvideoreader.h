@@ -0,0 +1,98 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef GSTVIDEOREADER_H
+#define GSTVIDEOREADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include <opencv2/core.hpp>
+
+#include <QString>
+
+#define GST_READER_DEFAULT_MAX_BUFFERS 2
+
+/* Video file reader built directly on appsink. The pipeline decodes, scales
+ * and converts to RGB itself, once at the display resolution and, when a
+ * model size is given, once at the model input resolution. Samples are
+ * queued by the appsink callbacks on GStreamer's streaming thread, so the
+ * next frames are already decoded when read() is called */
+class gstVideoReader
+{
+public:
+    gstVideoReader();
+    ~gstVideoReader();
+    void setQueueLimit(unsigned int maxBuffers, bool drop);
+    void setRealTime(bool enable);
+    void setLooping(bool enable);
+    unsigned long getDroppedFrames();
+    bool open(QString videoFilePath, bool hardwareDecode, cv::Size displaySize, cv::Size modelSize);
+    void close();
+    bool isOpened();
+    bool read(cv::Mat &displayFrame, cv::Mat &modelFrame);
+    bool rewind();
+    GstClockTime getFrameTime();
+
+private:
+    struct sinkQueue {
+        GstElement *appsink;
+        std::deque<GstSample*> samples;
+        GstSample *currentSample;
+        GstBuffer *currentBuffer;
+        GstMapInfo currentMap;
+    };
+
+    static GstFlowReturn newSample(GstAppSink *appsink, gpointer userData);
+    static void endOfStream(GstAppSink *appsink, gpointer userData);
+    static void queueOverrun(GstElement *queue, gpointer userData);
+    static GstBusSyncReply busSyncHandler(GstBus *bus, GstMessage *message, gpointer userData);
+    static GstClockTime sampleRunningTime(GstSample *sample);
+
+    void setupSink(sinkQueue &queue, const char *name);
+    void setupLeakyQueue(const char *name);
+    void queueSample(sinkQueue &queue, GstSample *sample);
+    bool mapSample(sinkQueue &queue, cv::Mat &frame);
+    void releaseCurrent(sinkQueue &queue);
+    void clearQueue(sinkQueue &queue);
+    bool checkBus();
+    bool framesReady();
+    bool seekToStart(bool flush);
+
+    GstElement *pipeline;
+    sinkQueue displayQueue;
+    sinkQueue modelQueue;
+    bool useModelSink;
+    unsigned int queueLimit;
+    bool dropFrames;
+    bool realTime;
+    bool looping;
+    bool segmentDone;
+    std::atomic<unsigned long> droppedFrames;
+    bool endReached;
+    bool flushing;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+};
+
+#endif // GSTVIDEOREADER_H
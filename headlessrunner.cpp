@@ -0,0 +1,365 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <cmath>
+#include <csignal>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "headlessrunner.h"
+#include "opencvworker.h"
+#include "pipelinetrace.h"
+#include "resultcache.h"
+
+#define DEFAULT_CAMERA "/dev/video0"
+
+#define SSD_ITEM_SIZE 6
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleStopSignal(int)
+{
+    stopRequested = 1;
+}
+
+headlessRunner::headlessRunner(Mode mode, QString modelLocation, QString labelLocation, QString boardName)
+{
+    demoMode = mode;
+    modelPath = modelLocation;
+    board = edgeUtils::getBoard(boardName);
+    delegateType = getDefaultDelegate(mode, modelLocation);
+    inferenceThreads = 2;
+    singleFrame = false;
+    realTime = false;
+    sharedFaceArena = false;
+    cvWorker = nullptr;
+    tfWorker = nullptr;
+    tfWorkerFaceLandmark = nullptr;
+    poseModel = postProcess::getPoseModel(modelLocation);
+
+    if (demoMode == SB || demoMode == OD)
+        labelList = edgeUtils::readLabelFile(labelLocation);
+}
+
+headlessRunner::~headlessRunner()
+{
+    delete tfWorker;
+    delete tfWorkerFaceLandmark;
+    delete cvWorker;
+}
+
+bool headlessRunner::isSupportedMode(Mode mode)
+{
+    return mode == SB || mode == OD || mode == PE || mode == FD;
+}
+
+/* Same default as the GUI: ArmNN where the model supports it, otherwise
+ * plain TensorFlow Lite */
+Delegate headlessRunner::getDefaultDelegate(Mode mode, QString modelLocation)
+{
+    if (mode == FD || (mode == PE && postProcess::getPoseModel(modelLocation) != MoveNet))
+        return none;
+
+    return armNN;
+}
+
+void headlessRunner::setDelegate(Delegate delegate, int threads)
+{
+    delegateType = delegate;
+    inferenceThreads = threads;
+}
+
+/* Play video files at their own frame rate and drop the frames inference
+ * cannot keep up with, as with a camera. Must be set before openFile() */
+void headlessRunner::setRealTime(bool enable)
+{
+    realTime = enable;
+}
+
+/* See tfliteWorker::setSharedArena(), must be set before the input is opened */
+void headlessRunner::setSharedFaceArena(bool enable)
+{
+    sharedFaceArena = enable;
+}
+
+bool headlessRunner::openCamera(QString cameraLocation, CameraFormat cameraFormat)
+{
+    if (cameraLocation.isEmpty())
+        cameraLocation = DEFAULT_CAMERA;
+
+    cvWorker = new opencvWorker(cameraLocation, board, cameraFormat);
+    createWorkers();
+
+    if (!cvWorker->cameraInit() || !cvWorker->getCameraOpen()) {
+        qWarning("Error: cannot open camera %s", qPrintable(cameraLocation));
+        return false;
+    }
+
+    return true;
+}
+
+bool headlessRunner::openFile(QString mediaLocation)
+{
+    if (!QFileInfo(mediaLocation).isFile()) {
+        qWarning("Error: %s does not exist", qPrintable(mediaLocation));
+        return false;
+    }
+
+    /* The camera is not used, so give the worker no device, which skips
+     * the camera setup */
+    cvWorker = new opencvWorker(QString(), board);
+    createWorkers();
+
+    if (edgeUtils::isVideoFile(mediaLocation)) {
+        /* Stop at the end of the file rather than restarting playback */
+        cvWorker->setVideoLoop(false);
+        cvWorker->setVideoRealTime(realTime);
+
+        return cvWorker->useVideoMode(mediaLocation);
+    }
+
+    cvWorker->useImageMode(mediaLocation);
+    singleFrame = true;
+
+    return true;
+}
+
+bool headlessRunner::openOutput(QString outputLocation)
+{
+    if (outputLocation.isEmpty())
+        return output.open(stdout, QIODevice::WriteOnly);
+
+    output.setFileName(outputLocation);
+
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Error: cannot open headless output file %s", qPrintable(outputLocation));
+        return false;
+    }
+
+    return true;
+}
+
+/* Workers are created when the input is opened, after setDelegate() */
+void headlessRunner::createWorkers()
+{
+    if (demoMode == FD) {
+        tfWorker = new tfliteWorker(MODEL_PATH_FD_FACE_DETECTION, delegateType, inferenceThreads);
+        tfWorkerFaceLandmark = new tfliteWorker(MODEL_PATH_FD_FACE_LANDMARK, delegateType, inferenceThreads);
+
+        tfWorker->setDemoMode(demoMode);
+        tfWorkerFaceLandmark->setDemoMode(demoMode);
+        tfWorker->setSharedArena(sharedFaceArena);
+        tfWorkerFaceLandmark->setSharedArena(sharedFaceArena);
+        tfWorker->startWarmup();
+        tfWorkerFaceLandmark->startWarmup();
+
+        connect(tfWorker, SIGNAL(sendOutputTensor(QVector<float>,int,int,cv::Mat)),
+                this, SLOT(receiveFace(QVector<float>,int,int,cv::Mat)));
+        connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
+                this, SLOT(receiveFaceLandmark(QVector<float>,int,int)));
+    } else {
+        tfWorker = new tfliteWorker(modelPath, delegateType, inferenceThreads);
+        tfWorker->setDemoMode(demoMode);
+        tfWorker->startWarmup();
+
+        /* Have the video pipeline scale frames for the model */
+        cvWorker->setModelInputSize(tfWorker->getInputSize());
+
+        if (demoMode == PE)
+            connect(tfWorker, SIGNAL(sendOutputTensor(QVector<float>,int,int,cv::Mat)),
+                    this, SLOT(receivePose(QVector<float>,int,int)));
+        else
+            connect(tfWorker, SIGNAL(sendOutputTensor(QVector<float>,int,int,cv::Mat)),
+                    this, SLOT(receiveDetection(QVector<float>,int,int)));
+    }
+}
+
+/* Pull frames until the input ends or SIGINT/SIGTERM is received. Returns
+ * the application exit code */
+int headlessRunner::run()
+{
+    unsigned long frameNumber = 0;
+
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    while (!stopRequested) {
+        const cv::Mat *image = cvWorker->getImage();
+
+        if (image == nullptr)
+            break;
+
+        frameResult = QJsonObject();
+        frameResult["frame"] = qint64(frameNumber);
+        frameResult["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+
+        if (realTime)
+            frameResult["dropped"] = qint64(cvWorker->getDroppedFrames());
+
+        const cv::Mat *modelImage = cvWorker->getModelImage();
+
+        if (demoMode != FD && resultCache::isEnabled())
+            tfWorker->setFrameKey(cvWorker->getFrameKey());
+
+        if (modelImage != nullptr)
+            tfWorker->receiveImage(*image, *modelImage);
+        else
+            tfWorker->receiveImage(*image);
+
+        if (demoMode == FD && frameResult.contains("face"))
+            tfWorkerFaceLandmark->receiveImage((*image)(faceCrop));
+
+        writeResult();
+        frameNumber++;
+
+        if (singleFrame)
+            break;
+    }
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    output.flush();
+
+    return 0;
+}
+
+/* Results are written a line at a time so a consumer can follow the
+ * output while the input is still being processed */
+void headlessRunner::writeResult()
+{
+    TRACE_SCOPE("writeResult");
+
+    output.write(QJsonDocument(frameResult).toJson(QJsonDocument::Compact));
+    output.write("\n");
+    output.flush();
+}
+
+/* JSON has no NaN, the keypoints that were not detected are written as null */
+QJsonValue headlessRunner::jsonNumber(float value)
+{
+    if (std::isnan(value))
+        return QJsonValue(QJsonValue::Null);
+
+    return QJsonValue(double(value));
+}
+
+/* Shopping basket and object detection: label, confidence and the
+ * normalised [ymin, xmin, ymax, xmax] box of each item over threshold */
+void headlessRunner::receiveDetection(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed)
+{
+    QVector<float> tensor = receivedTensor;
+    QVector<float> sortedTensor = postProcess::sortTensorSSD(tensor, receivedStride);
+    QJsonArray detections;
+
+    for (int i = 0; i + SSD_ITEM_SIZE <= sortedTensor.size(); i += SSD_ITEM_SIZE) {
+        QJsonObject detection;
+        QJsonArray box;
+        int itemId = int(sortedTensor.at(i + BOX_POINTS));
+
+        for (int j = 0; j < BOX_POINTS; j++)
+            box.append(double(sortedTensor.at(i + j)));
+
+        detection["label"] = (itemId >= 0 && itemId < labelList.size()) ? labelList.at(itemId) : QString::number(itemId);
+        detection["confidence"] = double(sortedTensor.at(i + BOX_POINTS + 1));
+        detection["box"] = box;
+        detections.append(detection);
+    }
+
+    frameResult["inference_ms"] = receivedTimeElapsed;
+    frameResult["detections"] = detections;
+}
+
+/* Pose estimation: the keypoints as returned by the post-processing of the
+ * model, [y, x, confidence] for MoveNet/BlazePose and [y, x] for HandPose */
+void headlessRunner::receivePose(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed)
+{
+    QVector<float> sortedTensor;
+    QJsonArray keypoints;
+    int pointSize = 3;
+
+    if (poseModel == MoveNet) {
+        sortedTensor = postProcess::sortTensorMoveNet(receivedTensor, receivedStride);
+    } else if (poseModel == BlazePose) {
+        sortedTensor = postProcess::sortTensorBlazePose(receivedTensor, receivedStride);
+    } else {
+        sortedTensor = postProcess::sortTensorHandPose(receivedTensor, receivedStride);
+        pointSize = 2;
+    }
+
+    for (int i = 0; i + pointSize <= sortedTensor.size(); i += pointSize) {
+        QJsonArray point;
+
+        for (int j = 0; j < pointSize; j++)
+            point.append(jsonNumber(sortedTensor.at(i + j)));
+
+        keypoints.append(point);
+    }
+
+    frameResult["inference_ms"] = receivedTimeElapsed;
+    frameResult["keypoints"] = keypoints;
+}
+
+/* Face detection: crop region of the most confident face in frame pixels.
+ * The face landmark model is run on the crop afterwards by run() */
+void headlessRunner::receiveFace(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed,
+                                 const cv::Mat& receivedMat)
+{
+    QVector<float> faceDims = postProcess::detectFace(receivedTensor, receivedStride, receivedMat.rows, receivedMat.cols);
+    QVector<float> cropDims = postProcess::getFaceCropDims(faceDims, receivedMat.rows, receivedMat.cols);
+    QJsonArray box;
+
+    faceCrop = cv::Rect(cropDims.at(0), cropDims.at(1), cropDims.at(2), cropDims.at(3));
+    faceCrop &= cv::Rect(0, 0, receivedMat.cols, receivedMat.rows);
+
+    frameResult["inference_ms"] = receivedTimeElapsed;
+
+    if (faceCrop.empty())
+        return;
+
+    box.append(faceCrop.x);
+    box.append(faceCrop.y);
+    box.append(faceCrop.width);
+    box.append(faceCrop.height);
+
+    frameResult["face"] = box;
+}
+
+/* Face landmarks as [x, y] mapped from the landmark model input back to
+ * frame pixels */
+void headlessRunner::receiveFaceLandmark(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed)
+{
+    QVector<float> sortedTensor = postProcess::sortTensorFaceLandmark(receivedTensor, receivedStride);
+    float scaleX = faceCrop.width / FACE_LANDMARK_INPUT_SIZE;
+    float scaleY = faceCrop.height / FACE_LANDMARK_INPUT_SIZE;
+    QJsonArray landmarks;
+
+    for (int i = 0; i + 1 < sortedTensor.size(); i += 2) {
+        QJsonArray point;
+
+        point.append(jsonNumber(faceCrop.x + sortedTensor.at(i) * scaleX));
+        point.append(jsonNumber(faceCrop.y + sortedTensor.at(i + 1) * scaleY));
+        landmarks.append(point);
+    }
+
+    frameResult["landmark_inference_ms"] = receivedTimeElapsed;
+    frameResult["landmarks"] = landmarks;
+}
@@ -0,0 +1,87 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+
+#include <opencv2/core.hpp>
+
+#include "edge-utils.h"
+#include "postprocess.h"
+#include "tfliteworker.h"
+
+class opencvWorker;
+
+/* Runs the selected demo mode without a display. Frames are pulled from the
+ * camera or a video/image file as fast as decode and inference allow, and the
+ * post-processed results of each frame are written out as one JSON line */
+class headlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    headlessRunner(Mode mode, QString modelLocation, QString labelLocation, QString boardName);
+    ~headlessRunner();
+    void setDelegate(Delegate delegate, int threads);
+    void setRealTime(bool enable);
+    void setSharedFaceArena(bool enable);
+    bool openCamera(QString cameraLocation, CameraFormat cameraFormat);
+    bool openFile(QString mediaLocation);
+    bool openOutput(QString outputLocation);
+    int run();
+
+    static bool isSupportedMode(Mode mode);
+    static Delegate getDefaultDelegate(Mode mode, QString modelLocation);
+
+private slots:
+    void receiveDetection(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed);
+    void receivePose(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed);
+    void receiveFace(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed,
+                     const cv::Mat& receivedMat);
+    void receiveFaceLandmark(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed);
+
+private:
+    void createWorkers();
+    void writeResult();
+
+    static QJsonValue jsonNumber(float value);
+
+    Mode demoMode;
+    PoseModel poseModel;
+    Board board;
+    Delegate delegateType;
+    int inferenceThreads;
+    bool singleFrame;
+    bool realTime;
+    bool sharedFaceArena;
+    QString modelPath;
+    QStringList labelList;
+    opencvWorker *cvWorker;
+    tfliteWorker *tfWorker;
+    tfliteWorker *tfWorkerFaceLandmark;
+    QFile output;
+    QJsonObject frameResult;
+    cv::Rect faceCrop;
+};
+
+#endif // HEADLESSRUNNER_H
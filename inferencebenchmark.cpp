@@ -0,0 +1,286 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include <QFileInfo>
+#include <QJsonArray>
+
+#include "inferencebenchmark.h"
+#include "memorymonitor.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#define BENCHMARK_DELEGATE_ARMNN "armnn"
+#define BENCHMARK_DELEGATE_XNNPACK "xnnpack"
+#define BENCHMARK_DELEGATE_NONE "none"
+#define BENCHMARK_INPUT_SYNTHETIC "synthetic"
+
+#define BENCHMARK_DEFAULT_WARMUP 10
+#define BENCHMARK_DEFAULT_ITERATIONS 100
+
+inferenceBenchmark::inferenceBenchmark(QString boardName, QStringList modelLocations, QString inputLocation)
+{
+    board = boardName;
+    models = modelLocations;
+    inputPath = inputLocation;
+    delegateList = { armNN, xnnpack, none };
+    threadList = { 2 };
+    armnnOptionList = { armnnOptionSet() };
+    warmup = BENCHMARK_DEFAULT_WARMUP;
+    iterations = BENCHMARK_DEFAULT_ITERATIONS;
+    profiling = false;
+
+    if (inputPath.isEmpty())
+        return;
+
+    /* Accept either an image or the first frame of a video */
+    inputImage = cv::imread(inputPath.toStdString());
+
+    if (inputImage.empty()) {
+        cv::VideoCapture video(inputPath.toStdString());
+
+        video.read(inputImage);
+    }
+
+    if (inputImage.empty()) {
+        qWarning("Warning: Could not read benchmark input %s, using synthetic input...", qPrintable(inputPath));
+        inputPath.clear();
+        return;
+    }
+
+    cv::cvtColor(inputImage, inputImage, cv::COLOR_BGR2RGB);
+}
+
+void inferenceBenchmark::setDelegates(QList<Delegate> delegates)
+{
+    delegateList = delegates;
+}
+
+void inferenceBenchmark::setThreadCounts(QList<int> threadCounts)
+{
+    threadList = threadCounts;
+}
+
+/* Option sets to run the ArmNN delegate with, the other delegates are run
+ * once for each thread count */
+void inferenceBenchmark::setArmnnOptionSets(QList<armnnOptionSet> optionSets)
+{
+    armnnOptionList = optionSets;
+}
+
+void inferenceBenchmark::setIterations(int warmupIterations, int timedIterations)
+{
+    warmup = warmupIterations;
+    iterations = timedIterations;
+}
+
+void inferenceBenchmark::setProfiling(bool enable)
+{
+    profiling = enable;
+}
+
+/* Run every model with each delegate and thread count combination, and
+ * each ArmNN option set for the ArmNN delegate */
+QJsonObject inferenceBenchmark::run()
+{
+    QJsonObject report;
+    QJsonArray results;
+    memorySample memory;
+
+    memoryMonitor::startSampling(MEMORY_MONITOR_INTERVAL_MS);
+
+    foreach (QString model, models) {
+        if (!QFileInfo(model).isFile()) {
+            qWarning("Warning: AI model %s does not exist, skipping...", qPrintable(model));
+            continue;
+        }
+
+        foreach (Delegate delegate, delegateList) {
+            foreach (int threads, threadList) {
+                if (delegate != armNN) {
+                    results.append(runConfiguration(model, delegate, threads, armnnOptionSet()));
+                    continue;
+                }
+
+                foreach (const armnnOptionSet &armnnSettings, armnnOptionList)
+                    results.append(runConfiguration(model, delegate, threads, armnnSettings));
+            }
+        }
+    }
+
+    report["board"] = board;
+    report["input"] = inputPath.isEmpty() ? QString(BENCHMARK_INPUT_SYNTHETIC) : inputPath;
+    report["warmup"] = warmup;
+    report["iterations"] = iterations;
+    report["results"] = results;
+
+    memoryMonitor::stopSampling();
+
+    if (memoryMonitor::readProcess(memory))
+        report["process_memory"] = memoryMonitor::sampleJson(memory);
+
+    report["memory_history"] = memoryMonitor::historyJson();
+
+    return report;
+}
+
+QJsonObject inferenceBenchmark::runConfiguration(QString modelLocation, Delegate delegate, int threads,
+                                                 const armnnOptionSet &armnnSettings)
+{
+    std::vector<qint64> times;
+    std::chrono::microseconds timeElapsed;
+    QJsonObject result;
+    QString input = BENCHMARK_INPUT_SYNTHETIC;
+    int failures = 0;
+
+    tfliteWorker worker(modelLocation, delegate, threads, armnnSettings);
+
+    if (inputImage.empty() || !worker.loadInputImage(inputImage))
+        worker.loadInputSynthetic();
+    else
+        input = inputPath;
+
+    for (int i = 0; i < warmup; i++)
+        worker.timedInvoke(timeElapsed);
+
+    times.reserve(iterations);
+
+    for (int i = 0; i < iterations; i++) {
+        if (worker.timedInvoke(timeElapsed))
+            times.push_back(timeElapsed.count());
+        else
+            failures++;
+    }
+
+    result["model"] = QFileInfo(modelLocation).fileName();
+    result["delegate"] = delegateName(delegate);
+    result["threads"] = threads;
+
+    if (delegate == armNN)
+        result["armnn_options"] = armnnOptions::describe(armnnSettings);
+
+    result["build_ms"] = qint64(worker.getBuildTime().count());
+    result["weights_cache"] = worker.getWeightsCacheState();
+    result["input"] = input;
+    result["failures"] = failures;
+    result["memory"] = worker.getMemoryReport();
+
+    /* Profile in a separate pass so the profiler overhead does not affect
+     * the reported latencies */
+    if (profiling) {
+        worker.setProfiling(true);
+
+        for (int i = 0; i < iterations; i++)
+            worker.timedInvoke(timeElapsed);
+
+        result["operators"] = worker.getProfiler()->jsonReport();
+        worker.setProfiling(false);
+    }
+
+    if (times.empty())
+        return result;
+
+    std::sort(times.begin(), times.end());
+
+    result["min_us"] = times.front();
+    result["p50_us"] = percentile(times, 50);
+    result["p95_us"] = percentile(times, 95);
+    result["p99_us"] = percentile(times, 99);
+    result["max_us"] = times.back();
+
+    return result;
+}
+
+/* Nearest-rank percentile of an already sorted list */
+qint64 inferenceBenchmark::percentile(const std::vector<qint64>& sortedTimes, int percent)
+{
+    size_t rank = (sortedTimes.size() * percent + 99) / 100;
+
+    if (rank == 0)
+        rank = 1;
+
+    return sortedTimes[rank - 1];
+}
+
+QString inferenceBenchmark::delegateName(Delegate delegate)
+{
+    if (delegate == armNN)
+        return BENCHMARK_DELEGATE_ARMNN;
+    else if (delegate == xnnpack)
+        return BENCHMARK_DELEGATE_XNNPACK;
+
+    return BENCHMARK_DELEGATE_NONE;
+}
+
+bool inferenceBenchmark::parseDelegates(QString delegateString, QList<Delegate>& delegates)
+{
+    delegates.clear();
+
+    foreach (QString name, delegateString.split(',', QString::SkipEmptyParts)) {
+        name = name.trimmed().toLower();
+
+        if (name == BENCHMARK_DELEGATE_ARMNN)
+            delegates.append(armNN);
+        else if (name == BENCHMARK_DELEGATE_XNNPACK)
+            delegates.append(xnnpack);
+        else if (name == BENCHMARK_DELEGATE_NONE)
+            delegates.append(none);
+        else
+            return false;
+    }
+
+    return !delegates.isEmpty();
+}
+
+bool inferenceBenchmark::parseThreadCounts(QString threadString, QList<int>& threadCounts)
+{
+    threadCounts.clear();
+
+    foreach (QString count, threadString.split(',', QString::SkipEmptyParts)) {
+        bool ok;
+        int threads = count.trimmed().toInt(&ok);
+
+        if (!ok || threads < 1)
+            return false;
+
+        threadCounts.append(threads);
+    }
+
+    return !threadCounts.isEmpty();
+}
+
+/* Option sets are separated by semicolons, see armnnOptions::parse */
+bool inferenceBenchmark::parseArmnnOptionSets(QString optionString, QList<armnnOptionSet>& optionSets)
+{
+    optionSets.clear();
+
+    foreach (QString optionSet, optionString.split(';', QString::SkipEmptyParts)) {
+        armnnOptionSet options;
+
+        if (!armnnOptions::parse(optionSet, options))
+            return false;
+
+        optionSets.append(options);
+    }
+
+    return !optionSets.isEmpty();
+}
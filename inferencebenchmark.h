@@ -0,0 +1,65 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef INFERENCEBENCHMARK_H
+#define INFERENCEBENCHMARK_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <opencv2/core.hpp>
+
+#include "armnnoptions.h"
+#include "tfliteworker.h"
+
+class inferenceBenchmark
+{
+public:
+    inferenceBenchmark(QString boardName, QStringList modelLocations, QString inputLocation);
+    void setDelegates(QList<Delegate> delegates);
+    void setThreadCounts(QList<int> threadCounts);
+    void setArmnnOptionSets(QList<armnnOptionSet> optionSets);
+    void setIterations(int warmupIterations, int timedIterations);
+    void setProfiling(bool enable);
+    QJsonObject run();
+
+    static bool parseDelegates(QString delegateString, QList<Delegate>& delegates);
+    static bool parseThreadCounts(QString threadString, QList<int>& threadCounts);
+    static bool parseArmnnOptionSets(QString optionString, QList<armnnOptionSet>& optionSets);
+    static QString delegateName(Delegate delegate);
+
+private:
+    QJsonObject runConfiguration(QString modelLocation, Delegate delegate, int threads,
+                                 const armnnOptionSet &armnnSettings);
+    static qint64 percentile(const std::vector<qint64>& sortedTimes, int percent);
+
+    QString board;
+    QStringList models;
+    QString inputPath;
+    cv::Mat inputImage;
+    QList<Delegate> delegateList;
+    QList<int> threadList;
+    QList<armnnOptionSet> armnnOptionList;
+    int warmup;
+    int iterations;
+    bool profiling;
+};
+
+#endif // INFERENCEBENCHMARK_H
@@ -18,17 +18,44 @@
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QFile>
 #include <QFileInfo>
+#include <QJsonDocument>
+#include <QScopedPointer>
 #include <QSysInfo>
 
+#include "armnnoptions.h"
+#include "autotuner.h"
+#include "facedetection.h"
+#include "headlessrunner.h"
+#include "inferencebenchmark.h"
 #include "mainwindow.h"
+#include "memorymonitor.h"
+#include "pipelinetrace.h"
+#include "resultcache.h"
+#include "threadplacement.h"
 
 #define OPTION_FD_DETECT_FACE "face"
 #define OPTION_FD_DETECT_IRIS "iris"
+#define OPTION_BENCHMARK "--benchmark"
+#define OPTION_HEADLESS "--headless"
+
+static bool displayNotRequired(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]) == OPTION_BENCHMARK || QString(argv[i]) == OPTION_HEADLESS)
+            return true;
+    }
+
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    /* The benchmark and headless modes must run without a display, so only
+     * create the GUI application when it is actually needed */
+    QScopedPointer<QCoreApplication> a(displayNotRequired(argc, argv) ?
+                                       new QCoreApplication(argc, argv) : new QApplication(argc, argv));
     QCommandLineParser parser;
     QCommandLineOption autoStartOption (QStringList() << "a" << "autostart", "Enable inference to automatically start when the application opens.");
     QCommandLineOption cameraOption(QStringList() << "c" << "camera", "Choose a camera.", "file");
@@ -40,7 +67,82 @@ int main(int argc, char *argv[])
     QCommandLineOption pricesOption (QStringList() << "p" << "prices-file",
                                    "Choose a text file listing the prices to use for the shopping basket mode", "file", PRICES_PATH_DEFAULT);
     QCommandLineOption faceDetectOption (QStringList() << "f" << "face-mode", "Choose a mode to start face detection with: [iris|face].", "mode");
+    QCommandLineOption cameraFormatOption (QStringList() << "camera-format",
+                                           "Choose the capture format of USB cameras: [uyvy|mjpeg|mjpeg-full]. MJPEG runs at 30 fps\n"
+                                           "and is decoded on several threads, mjpeg scales frames down to the display size while\n"
+                                           "decoding, mjpeg-full decodes them at full resolution. Frames of 1280x720 are already\n"
+                                           "close to the display size and are not scaled down, 1080p and larger frames are.", "format", "uyvy");
     QCommandLineOption videoOption (QStringList() << "v" << "video-image", "Choose a video/image to load during startup. Displays before -c option during startup.", "media");
+    QCommandLineOption autoTuneOption (QStringList() << "auto-tune",
+                                       "Time each delegate and thread count the first time a model is used on this board and\n"
+                                       "use the fastest. The choice is cached, so later runs start with it straight away.");
+    QCommandLineOption interpreterPoolOption (QStringList() << "interpreter-pool",
+                                              "Run count interpreters of the model on consecutive frames at once in object detection and\n"
+                                              "pose estimation, each pinned to its own share of the CPU cores. Results are still shown in\n"
+                                              "frame order, so throughput scales with the cores at the cost of count - 1 frames of latency.",
+                                              "count", "1");
+    QCommandLineOption sharedFaceArenaOption (QStringList() << "shared-face-arena",
+                                              "Let the face detection, face landmark and iris landmark models, which run one after\n"
+                                              "another, share their scratch memory instead of each keeping its own. Lowers the memory\n"
+                                              "use of face detection mode at a small cost per inference.");
+    QCommandLineOption maxFacesOption (QStringList() << "max-faces",
+                                       "Largest number of faces face detection mode finds and draws the landmarks of. The face\n"
+                                       "landmark model runs on all of them in one batch. Iris mode always follows one face.",
+                                       "count", QString::number(FACE_DETECTION_MAX_FACES));
+    QCommandLineOption warmupOption (QStringList() << "warmup",
+                                     "Number of warm-up inferences run on synthetic input in the background when a model is\n"
+                                     "loaded, so that the first frame does not pay for the slow first inferences. 0 disables it.",
+                                     "count", "3");
+    QCommandLineOption armnnOptionsOption (QStringList() << "armnn-options",
+                                           "Comma separated ArmNN delegate options for every model: fast-math, fp16 (reduce FP32 to\n"
+                                           "FP16, faster on the Cortex-A55) and threads=n, or default. Without it the options last\n"
+                                           "chosen from the Inference Engine menu are used for each model.", "list");
+    QCommandLineOption cpuAffinityOption (QStringList() << "cpu-affinity",
+                                          "Run the threads of a role on the given cores, as role=cores where role is gui, capture,\n"
+                                          "inference or audio and cores is a list such as 0,2-3. May be given once per role,\n"
+                                          "roles that are not given run on all cores.", "role=cores");
+    QCommandLineOption audioRealTimeOption (QStringList() << "audio-realtime",
+                                            "Run the audio capture thread with the SCHED_FIFO scheduling policy. Needs CAP_SYS_NICE\n"
+                                            "or a realtime priority limit of at least " + QString::number(AUDIO_FIFO_PRIORITY) + ".");
+    QCommandLineOption mlockallOption (QStringList() << "mlockall",
+                                       "Lock the application memory once used, so that it is never paged out and the main\n"
+                                       "loop does not take page faults. Needs CAP_IPC_LOCK or a large enough memlock limit.");
+    QCommandLineOption traceOption (QStringList() << "trace",
+                                    "Record the duration of each pipeline stage and write it as Chrome trace JSON to file on exit\n"
+                                    "or when the application receives SIGUSR1. Open it with chrome://tracing or ui.perfetto.dev.", "file");
+    QCommandLineOption resultCacheOption (QStringList() << "result-cache",
+                                          "Store the model results for each frame of image and video files in file and replay them\n"
+                                          "when the same frame is shown again with the same model and delegate. Useful for\n"
+                                          "demo units that loop the same clips.", "file");
+    QCommandLineOption benchmarkOption (QStringList() << "benchmark",
+                                        "Run an inference benchmark of the selected models without starting the GUI and print the latency as JSON.\n"
+                                        "-m may be given more than once, -v selects the input, otherwise synthetic input is used.");
+    QCommandLineOption benchmarkDelegatesOption (QStringList() << "benchmark-delegates",
+                                                 "Comma separated delegates to benchmark: [armnn,xnnpack,none].", "list", "armnn,xnnpack,none");
+    QCommandLineOption benchmarkThreadsOption (QStringList() << "benchmark-threads",
+                                               "Comma separated inference thread counts to benchmark.", "list", "1,2");
+    QCommandLineOption benchmarkArmnnOptionsOption (QStringList() << "benchmark-armnn-options",
+                                                    "Semicolon separated ArmNN option sets to benchmark the ArmNN delegate with,\n"
+                                                    "see --armnn-options.", "sets", "default");
+    QCommandLineOption benchmarkWarmupOption (QStringList() << "benchmark-warmup",
+                                              "Number of untimed warm-up inferences per configuration.", "count", "10");
+    QCommandLineOption benchmarkIterationsOption (QStringList() << "benchmark-iterations",
+                                                  "Number of timed inferences per configuration.", "count", "100");
+    QCommandLineOption benchmarkProfileOption (QStringList() << "benchmark-profile",
+                                               "Add a per-operator profile of each configuration to the benchmark results.");
+    QCommandLineOption benchmarkOutputOption (QStringList() << "benchmark-output",
+                                              "Write the benchmark results to a file instead of stdout.", "file");
+    QCommandLineOption headlessOption (QStringList() << "headless",
+                                       "Run the selected mode without the GUI on the -v video/image or the -c camera and write the\n"
+                                       "results of each frame as a line of JSON. Supports shopping-basket, object-detection,\n"
+                                       "pose-estimation and face-detection (face mode only).");
+    QCommandLineOption headlessOutputOption (QStringList() << "headless-output",
+                                             "Write the headless results to a file instead of stdout.", "file");
+    QCommandLineOption headlessRealTimeOption (QStringList() << "headless-realtime",
+                                               "Play video files at their own frame rate in headless mode and drop the frames\n"
+                                               "inference cannot keep up with, instead of processing every frame.");
+    QCommandLineOption headlessDelegateOption (QStringList() << "headless-delegate",
+                                               "Delegate to use in headless mode: [armnn|xnnpack|none].", "delegate");
     bool autoStart;
     QString cameraLocation;
     QString labelLocation;
@@ -51,6 +153,14 @@ int main(int argc, char *argv[])
     QString faceOption;
     QString boardName;
     bool irisOption = false;
+    CameraFormat cameraFormat = uyvyCapture;
+    int interpreterPool;
+    bool interpreterPoolValid;
+    int warmupInvokes;
+    bool warmupInvokesValid;
+    int maxFaces;
+    bool maxFacesValid;
+    int exitCode;
     QSysInfo systemInfo;
     Mode mode = PE;
     QString applicationDescription =
@@ -134,7 +244,10 @@ int main(int argc, char *argv[])
     "  Inference Engine->TensorFlow Lite + XNNPack delegate: Run inference using TensorFlow\n"
     "                                                        Lite with XNNPack delegate enabled.\n"
     "  Inference Engine->TensorFlow Lite: Run inference using TensorFlow Lite.\n"
-    "  About->Hardware: Display the platform information.\n"
+    "  Inference Engine->Profile Operators: Time every operator of the loaded models.\n"
+    "  Inference Engine->Show Operator Profile: Show the time spent per delegate partition\n"
+    "                                           and per operator type.\n"
+    "  About->Hardware: Display the platform information, thread placement and frame buffer use.\n"
     "  About->License: Read the license information.\n"
     "  About->Exit: Close the application.\n\n"
     "Default Options:\n"
@@ -155,7 +268,8 @@ int main(int argc, char *argv[])
     "Application Exit Codes:\n"
     "  0: Successful exit\n"
     "  1: Camera initialisation failed\n"
-    "  2: Camera stopped working";
+    "  2: Camera stopped working\n"
+    "  3: Invalid benchmark or headless options";
     QStringList supportedPoseModels = { MODEL_PATH_PE_MOVE_NET_L, MODEL_PATH_PE_MOVE_NET_T, MODEL_PATH_PE_BLAZE_POSE_FULL,
                                         MODEL_PATH_PE_BLAZE_POSE_HEAVY, MODEL_PATH_PE_BLAZE_POSE_LITE,
                                         MODEL_PATH_PE_HAND_POSE_FULL, MODEL_PATH_PE_HAND_POSE_LITE };
@@ -167,10 +281,34 @@ int main(int argc, char *argv[])
     parser.addOption(modeOption);
     parser.addOption(pricesOption);
     parser.addOption(faceDetectOption);
+    parser.addOption(cameraFormatOption);
     parser.addOption(videoOption);
+    parser.addOption(autoTuneOption);
+    parser.addOption(interpreterPoolOption);
+    parser.addOption(sharedFaceArenaOption);
+    parser.addOption(maxFacesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(armnnOptionsOption);
+    parser.addOption(cpuAffinityOption);
+    parser.addOption(audioRealTimeOption);
+    parser.addOption(mlockallOption);
+    parser.addOption(traceOption);
+    parser.addOption(resultCacheOption);
+    parser.addOption(benchmarkOption);
+    parser.addOption(benchmarkDelegatesOption);
+    parser.addOption(benchmarkThreadsOption);
+    parser.addOption(benchmarkArmnnOptionsOption);
+    parser.addOption(benchmarkWarmupOption);
+    parser.addOption(benchmarkIterationsOption);
+    parser.addOption(benchmarkProfileOption);
+    parser.addOption(benchmarkOutputOption);
+    parser.addOption(headlessOption);
+    parser.addOption(headlessOutputOption);
+    parser.addOption(headlessDelegateOption);
+    parser.addOption(headlessRealTimeOption);
     parser.addHelpOption();
     parser.setApplicationDescription(applicationDescription);
-    parser.process(a);
+    parser.process(*a);
     cameraLocation = parser.value(cameraOption);
     labelLocation = parser.value(labelOption);
     modelLocation = parser.value(modelOption);
@@ -182,6 +320,71 @@ int main(int argc, char *argv[])
 
     boardName = systemInfo.machineHostName();
 
+    /* Camera capture format (--camera-format) */
+    if (parser.value(cameraFormatOption) == "mjpeg")
+        cameraFormat = mjpegCapture;
+    else if (parser.value(cameraFormatOption) == "mjpeg-full")
+        cameraFormat = mjpegFullCapture;
+    else if (parser.value(cameraFormatOption) != "uyvy")
+        qWarning("Warning: unknown camera format requested, using uyvy...");
+
+    /* Thread placement (--cpu-affinity, --audio-realtime, --mlockall), before
+     * the worker threads are started so that they start from it */
+    if (parser.isSet(cpuAffinityOption))
+        threadPlacement::configure(parser.values(cpuAffinityOption));
+
+    threadPlacement::setAudioRealTime(parser.isSet(audioRealTimeOption));
+    threadPlacement::applyRole(guiRole);
+
+    if (parser.isSet(mlockallOption))
+        threadPlacement::lockMemory();
+
+    /* Interpreter pool (--interpreter-pool) */
+    interpreterPool = parser.value(interpreterPoolOption).toInt(&interpreterPoolValid);
+
+    if (!interpreterPoolValid || interpreterPool < 1) {
+        qWarning("Warning: invalid interpreter pool size requested, using 1...");
+        interpreterPool = 1;
+    }
+
+    /* Model warm-up (--warmup) */
+    warmupInvokes = parser.value(warmupOption).toInt(&warmupInvokesValid);
+
+    if (!warmupInvokesValid || warmupInvokes < 0) {
+        qWarning("Warning: invalid warm-up count requested, using 3...");
+        warmupInvokes = 3;
+    }
+
+    tfliteWorker::setWarmupInvokes(warmupInvokes);
+
+    /* Face count (--max-faces) */
+    maxFaces = parser.value(maxFacesOption).toInt(&maxFacesValid);
+
+    if (!maxFacesValid || maxFaces < 1) {
+        qWarning("Warning: invalid face count requested, using %d...", FACE_DETECTION_MAX_FACES);
+        maxFaces = FACE_DETECTION_MAX_FACES;
+    }
+
+    faceDetection::setMaxFaces(maxFaces);
+
+    /* ArmNN delegate options (--armnn-options) */
+    if (parser.isSet(armnnOptionsOption)) {
+        armnnOptionSet armnnSettings;
+
+        if (armnnOptions::parse(parser.value(armnnOptionsOption), armnnSettings))
+            armnnOptions::setCommandLine(armnnSettings);
+        else
+            qWarning("Warning: invalid ArmNN options requested, using the saved options...");
+    }
+
+    /* Pipeline tracing (--trace) */
+    if (parser.isSet(traceOption))
+        pipelineTrace::enable(parser.value(traceOption));
+
+    /* Result cache (--result-cache) */
+    if (parser.isSet(resultCacheOption))
+        resultCache::enable(parser.value(resultCacheOption));
+
     /* Mode selection (-s / --start-mode) */
     if (modeString == "shopping-basket") {
         mode = SB;
@@ -267,9 +470,115 @@ int main(int argc, char *argv[])
         modelLocation = MODEL_PATH_PE_BLAZE_POSE_LITE;
     }
 
+    /* Headless benchmark (--benchmark) */
+    if (parser.isSet(benchmarkOption)) {
+        QStringList benchmarkModels = parser.values(modelOption);
+        QList<Delegate> benchmarkDelegates;
+        QList<int> benchmarkThreads;
+        QList<armnnOptionSet> benchmarkArmnnOptions;
+        QJsonDocument benchmarkReport;
+        int warmup, iterations;
+        bool warmupValid, iterationsValid;
+
+        if (benchmarkModels.isEmpty())
+            benchmarkModels << modelLocation;
+
+        warmup = parser.value(benchmarkWarmupOption).toInt(&warmupValid);
+        iterations = parser.value(benchmarkIterationsOption).toInt(&iterationsValid);
+
+        if (!inferenceBenchmark::parseDelegates(parser.value(benchmarkDelegatesOption), benchmarkDelegates) ||
+            !inferenceBenchmark::parseThreadCounts(parser.value(benchmarkThreadsOption), benchmarkThreads) ||
+            !inferenceBenchmark::parseArmnnOptionSets(parser.value(benchmarkArmnnOptionsOption), benchmarkArmnnOptions) ||
+            !warmupValid || warmup < 0 || !iterationsValid || iterations < 1) {
+            qWarning("Error: invalid benchmark options");
+            return 3;
+        }
+
+        inferenceBenchmark benchmark(boardName, benchmarkModels, videoLocation);
+        benchmark.setDelegates(benchmarkDelegates);
+        benchmark.setThreadCounts(benchmarkThreads);
+        benchmark.setArmnnOptionSets(benchmarkArmnnOptions);
+        benchmark.setIterations(warmup, iterations);
+        benchmark.setProfiling(parser.isSet(benchmarkProfileOption));
+
+        benchmarkReport.setObject(benchmark.run());
+
+        QFile benchmarkOutput;
+
+        if (parser.isSet(benchmarkOutputOption)) {
+            benchmarkOutput.setFileName(parser.value(benchmarkOutputOption));
+
+            if (!benchmarkOutput.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                qWarning("Error: cannot open benchmark output file");
+                return 3;
+            }
+        } else {
+            benchmarkOutput.open(stdout, QIODevice::WriteOnly);
+        }
+
+        benchmarkOutput.write(benchmarkReport.toJson());
+
+        return 0;
+    }
+
+    /* Headless mode (--headless) */
+    if (parser.isSet(headlessOption)) {
+        Delegate headlessDelegate = headlessRunner::getDefaultDelegate(mode, modelLocation);
+        int headlessThreads = 2;
+
+        if (!headlessRunner::isSupportedMode(mode) || irisOption) {
+            qWarning("Error: demo mode is not supported in headless mode");
+            return 3;
+        }
+
+        if (parser.isSet(headlessDelegateOption)) {
+            QList<Delegate> delegates;
+
+            if (!inferenceBenchmark::parseDelegates(parser.value(headlessDelegateOption), delegates) ||
+                delegates.size() != 1) {
+                qWarning("Error: invalid headless delegate");
+                return 3;
+            }
+
+            headlessDelegate = delegates.first();
+        } else if (parser.isSet(autoTuneOption)) {
+            QList<Delegate> candidates = { none, xnnpack };
+
+            if (headlessDelegate == armNN)
+                candidates.append(armNN);
+
+            autoTuner(boardName).selectConfiguration(mode == FD ? MODEL_PATH_FD_FACE_DETECTION : modelLocation,
+                                                     candidates, headlessDelegate, headlessThreads);
+        }
+
+        headlessRunner runner(mode, modelLocation, labelLocation, boardName);
+        runner.setDelegate(headlessDelegate, headlessThreads);
+        runner.setRealTime(parser.isSet(headlessRealTimeOption));
+        runner.setSharedFaceArena(parser.isSet(sharedFaceArenaOption));
+
+        if (!runner.openOutput(parser.value(headlessOutputOption)))
+            return 3;
+
+        if (videoLocation.isEmpty()) {
+            if (!runner.openCamera(cameraLocation, cameraFormat))
+                return 1;
+        } else if (!runner.openFile(videoLocation)) {
+            return 3;
+        }
+
+        return runner.run();
+    }
+
     /* Application start */
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
-    MainWindow w(nullptr, boardName, cameraLocation, labelLocation, modelLocation, videoLocation, mode, pricesLocation, irisOption, autoStart);
+    memoryMonitor::startSampling(MEMORY_MONITOR_INTERVAL_MS);
+    MainWindow w(nullptr, boardName, cameraLocation, labelLocation, modelLocation, videoLocation, mode, pricesLocation, irisOption, autoStart,
+                 parser.isSet(autoTuneOption), cameraFormat, unsigned(interpreterPool),
+                 parser.isSet(sharedFaceArenaOption));
     w.show();
-    return a.exec();
+    exitCode = a->exec();
+
+    memoryMonitor::stopSampling();
+
+    return exitCode;
 }
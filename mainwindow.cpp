@@ -18,22 +18,34 @@
 
 #include <QEventLoop>
 #include <QCloseEvent>
+#include <QFutureWatcher>
+#include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QGraphicsTextItem>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QSplashScreen>
+#include <QtConcurrent>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "armnnoptions.h"
 #include "audiocommand.h"
+#include "autotuner.h"
 #include "facedetection.h"
+#include "framepool.h"
+#include "memorymonitor.h"
 #include "objectdetection.h"
 #include "opencvworker.h"
+#include "pipelinetrace.h"
 #include "poseestimation.h"
+#include "resultcache.h"
+#include "threadplacement.h"
 #include "videoworker.h"
 #include "shoppingbasket.h"
 
@@ -45,6 +57,7 @@
 #define TEXT_INFERENCE_ENGINE_TFLITE "TensorFlow Lite"
 #define TEXT_INFERENCE_ENGINE_ARMNN_DELEGATE "TensorFlow Lite + ArmNN Delegate"
 #define TEXT_INFERENCE_ENGINE_XNNPACK_DELEGATE "TensorFlow Lite + XNNPACK Delegate"
+#define TEXT_LOADING_MODEL "Loading %1..."
 
 #define IMAGE_FILE_FILTER "Images (*.bmp *.dib *.jpeg *.jpg *.jpe *.png *.pbm *.pgm *.ppm *.sr *.ras *.tiff *.tif)"
 #define VIDEO_FILE_FILTER "Videos (*.asf *.avi *.3gp *.mp4 *m4v *.mov *.flv *.mpeg *.mkv *.webm *.mxf *.ogg);;"
@@ -66,7 +79,6 @@
 #define DEFAULT_WAV_FILE "/opt/rz-edge-ai-demo/media/audio-command/right/right_1.wav"
 #define DEFAULT_SBD_IMG "/opt/rz-edge-ai-demo/media/shopping-basket/shopping_items_003.jpg"
 #define DEFAULT_FD_VIDEO "/opt/rz-edge-ai-demo/media/face-detection/face_shaking.mp4"
-#define MODEL_PATH_FD_FACE_LANDMARK "/opt/rz-edge-ai-demo/models/face_landmark.tflite"
 
 #define CONFIDENCE_OFFSET_SSD 5
 #define ITEM_OFFSET_SSD 4
@@ -80,7 +92,6 @@
 #define APP_WIDTH 1275
 #define APP_HEIGHT 635
 #define BOX_WIDTH 2
-#define MIPI_VIDEO_DELAY 50
 #define SPLASH_SCREEN_TEXT_SIZE 22
 
 #define MENUBAR_TEXT_SIZE 15
@@ -94,7 +105,8 @@
 #define POPUP_DIALOG_TEXT_SIZE 14
 
 MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocation, QString labelLocation,
-                       QString modelLocation, QString videoLocation, Mode mode, QString pricesFile, bool irisOption, bool autoStart)
+                       QString modelLocation, QString videoLocation, Mode mode, QString pricesFile, bool irisOption, bool autoStart,
+                       bool autoTune, CameraFormat cameraFormat, unsigned int interpreterPool, bool sharedArena)
     : QMainWindow(parent),
       ui(new Ui::MainWindow)
 {
@@ -104,6 +116,12 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     pricesPath = pricesFile;
     mediaPath = videoLocation;
     faceDetectIrisMode = irisOption;
+    operatorProfiling = false;
+    interpreterPoolSize = interpreterPool;
+    sharedFaceArena = sharedArena;
+    loadProgress = nullptr;
+    loadedDelegate = none;
+    loadedThreads = 0;
     modelPE = MODEL_PATH_PE_BLAZE_POSE_LITE;
     labelOD = LABEL_PATH_OD;
     modelOD = MODEL_PATH_OD;
@@ -112,6 +130,9 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     modelSB = MODEL_PATH_SB;
     scene = new QGraphicsScene(this);
     sceneAC = new QGraphicsScene(this);
+    tfWorkerLoader = new QFutureWatcher<QList<tfliteWorker*>>(this);
+
+    connect(tfWorkerLoader, SIGNAL(finished()), this, SLOT(tfWorkersLoaded()));
     bool mediaExists = QFile::exists(mediaPath);
     audioCommandMode = nullptr;
 
@@ -129,7 +150,7 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     if (labelPath.isEmpty())
         qWarning("Warning: Label file path not provided");
 
-    labelFileList = readLabelFile(labelPath);
+    labelFileList = edgeUtils::readLabelFile(labelPath);
 
     modelPath = modelLocation;
     if (modelPath.isEmpty())
@@ -137,7 +158,10 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
 
     delegateType = armNN;
 
-    iterations = 1;
+    /* ArmNN Delegate sets the inference threads to amount of CPU cores
+     * of the same type logically group first, which for the RZ/G2L and
+     * RZ/G2M is 2 */
+    inferenceThreads = 2;
 
     ui->setupUi(this);
     this->resize(APP_WIDTH, APP_HEIGHT);
@@ -209,10 +233,13 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     else if (demoMode == FD || demoMode == AC)
         disableArmNNDelegate();
 
+    if (autoTune)
+        tuner.reset(new autoTuner(boardName));
+
     qRegisterMetaType<size_t>("size_t");
     qRegisterMetaType<cv::Mat>();
 
-    cvWorker = new opencvWorker(cameraLocation, board);
+    cvWorker = new opencvWorker(cameraLocation, board, cameraFormat);
     connect(cvWorker, SIGNAL(resolutionError(QString)), SLOT(errorPopup(QString)), Qt::DirectConnection);
 
     setGuiPixelSizes();
@@ -245,20 +272,10 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
         setupAudioCommandMode();
 
     if (mediaExists) {
-        bool video = false;
-
         if (cameraConnect)
             ui->actionLoad_Periph->setEnabled(true);
 
-        QList<QString> supportedFormats = {".asf", ".avi", ".3gp", ".mp4", ".m4v", ".mov",
-                                           ".flv", ".mpeg", ".mkv", ".webm", ".mxf", ".ogg"};
-
-        foreach(QString format, supportedFormats) {
-            if (mediaPath.endsWith(format, Qt::CaseInsensitive))
-                video = true;
-        }
-
-        if (video) {
+        if (edgeUtils::isVideoFile(mediaPath)) {
             inputMode = videoMode;
             mediaExists = cvWorker->useVideoMode(mediaPath);
         } else {
@@ -268,10 +285,8 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     }
 
     if (cameraConnect && demoMode != AC) {
-        /* Limit camera loop speed if using mipi camera to save on CPU
-         * USB camera is alreay limited to 10 FPS */
-        if (cvWorker->getUsingMipi())
-            vidWorker->setDelayMS(MIPI_VIDEO_DELAY);
+        /* Show the preview at the rate the camera delivers frames */
+        vidWorker->setFrameRate(cvWorker->getCameraFrameRate());
 
         if (!mediaExists)
             vidWorker->StartVideo();
@@ -304,6 +319,13 @@ MainWindow::MainWindow(QWidget *parent, QString boardName, QString cameraLocatio
     }
 }
 
+/* Declared here, as the tuner is only a complete type in this file. The
+ * background load may still be using it */
+MainWindow::~MainWindow()
+{
+    tfWorkerLoader->waitForFinished();
+}
+
 void MainWindow::setGuiPixelSizes()
 {
     /* Menu bar */
@@ -313,6 +335,7 @@ void MainWindow::setGuiPixelSizes()
     QList<QAction *> allMenuItems = ui->menuDemoMode->actions();
     allMenuItems.append(ui->menuInput->actions());
     allMenuItems.append(ui->menuInferenceEngine->actions());
+    allMenuItems.append(ui->menuArmNN_Options->actions());
     allMenuItems.append(ui->menuAbout->actions());
 
     foreach (QAction *item, allMenuItems)
@@ -440,6 +463,7 @@ void MainWindow::setupObjectDetectMode()
     connect(objectDetectMode, SIGNAL(getFrame()), this, SLOT(processFrame()), Qt::QueuedConnection);
     connect(objectDetectMode, SIGNAL(getBoxes(QVector<float>,QStringList)), this, SLOT(drawBoxes(QVector<float>,QStringList)));
     connect(objectDetectMode, SIGNAL(sendMatToView(cv::Mat)), this, SLOT(drawMatToView(cv::Mat)));
+    connect(objectDetectMode, SIGNAL(continuousModeStopped()), tfWorker, SLOT(discardPendingResults()), Qt::DirectConnection);
     connect(tfWorker, SIGNAL(sendOutputTensor(const QVector<float>, int, int, const cv::Mat&)),
             objectDetectMode, SLOT(runInference(QVector<float>, int, int, cv::Mat)));
 
@@ -489,6 +513,7 @@ void MainWindow::setupPoseEstimateMode()
     connect(ui->pushButtonStartStopPose, SIGNAL(pressed()), poseEstimateMode, SLOT(triggerInference()));
     connect(poseEstimateMode, SIGNAL(getFrame()), this, SLOT(processFrame()), Qt::QueuedConnection);
     connect(poseEstimateMode, SIGNAL(sendMatToView(cv::Mat)), this, SLOT(drawMatToView(cv::Mat)));
+    connect(poseEstimateMode, SIGNAL(continuousModeStopped()), tfWorker, SLOT(discardPendingResults()), Qt::DirectConnection);
     connect(tfWorker, SIGNAL(sendOutputTensor(const QVector<float>, int, int, const cv::Mat&)),
             poseEstimateMode, SLOT(runInference(QVector<float>, int, int, cv::Mat)));
 
@@ -526,6 +551,8 @@ void MainWindow::setupFaceDetectMode()
     connect(faceDetectMode, SIGNAL(sendMatToView(cv::Mat)), this, SLOT(drawMatToView(cv::Mat)));
     connect(faceDetectMode, SIGNAL(sendMatForInference(cv::Mat,FaceModel,bool)),
             this, SLOT(runFaceInference(cv::Mat,FaceModel,bool)));
+    connect(faceDetectMode, SIGNAL(sendFacesForInference(QVector<cv::Mat>)),
+            this, SLOT(runFaceLandmarkBatch(QVector<cv::Mat>)));
     connect(faceDetectMode, SIGNAL(displayFrame()), this, SLOT(getImageFrame()));
     connect(tfWorkerFaceDetection, SIGNAL(sendOutputTensor(QVector<float>,int,int,cv::Mat)),
             faceDetectMode, SLOT(cropImageFace(QVector<float>,int,int,cv::Mat)));
@@ -534,18 +561,17 @@ void MainWindow::setupFaceDetectMode()
     connect(tfWorkerIrisLandmarkR, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
             faceDetectMode, SLOT(runInference(QVector<float>,int,int)));
 
+    /* Face mode runs the Face Landmark model on every face at once, iris
+     * mode on the one face the iris crops are taken from */
+    connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorBatch(QList<QVector<float>>,int,int)),
+            faceDetectMode, SLOT(runFaceLandmarks(QList<QVector<float>>,int,int)));
+    connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
+            faceDetectMode, SLOT(setIrisCropDims(QVector<float>,int,int)));
+
     if (cameraConnect) {
         connect(faceDetectMode, SIGNAL(startVideo()), vidWorker, SLOT(StartVideo()));
         connect(faceDetectMode, SIGNAL(stopVideo()), vidWorker, SLOT(StopVideo()));
     }
-
-    if (detectModeToUse == irisMode) {
-        connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                faceDetectMode, SLOT(setIrisCropDims(QVector<float>,int,int)));
-    } else {
-        connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                faceDetectMode, SLOT(runInference(QVector<float>, int, int)));
-    }
 }
 
 void MainWindow::checkAudioCommandMode()
@@ -563,7 +589,7 @@ void MainWindow::setupAudioCommandMode()
     ui->graphicsView->setScene(sceneAC);
     sceneAC->clear();
     labelPath = labelAC;
-    labelFileList = readLabelFile(labelAC);
+    labelFileList = edgeUtils::readLabelFile(labelAC);
 
     disableXnnPackDelegate();
     disableArmNNDelegate();
@@ -581,33 +607,89 @@ void MainWindow::createVideoWorker()
     vidWorker = new videoWorker();
 
     connect(vidWorker, SIGNAL(showVideo()), this, SLOT(ShowVideo()));
+    connect(cvWorker, SIGNAL(frameReady()), vidWorker, SLOT(frameArrived()), Qt::QueuedConnection);
 }
 
 void MainWindow::createTfWorker()
 {
-    /* ArmNN Delegate sets the inference threads to amount of CPU cores
-     * of the same type logically group first, which for the RZ/G2L and
-     * RZ/G2M is 2 */
-    int inferenceThreads = 2;
+    installTfWorkers(buildTfWorkers(demoMode, modelPath, delegateType, inferenceThreads, interpreterPoolSize,
+                                    sharedFaceArena));
 
+    /* Tuning times invokes of every candidate, so it is left to a background
+     * load, which swaps the tuned workers in if the choice differs */
+    if (tuner && getTuneModelPath() != tunedModelPath)
+        remakeTfWorker(true);
+}
+
+QString MainWindow::getTuneModelPath()
+{
+    return (demoMode == FD) ? MODEL_PATH_FD_FACE_DETECTION : modelPath;
+}
+
+/* Create the workers of a mode, in the order installTfWorkers() expects.
+ * Nothing here touches the window, so it may run on any thread */
+QList<tfliteWorker*> MainWindow::buildTfWorkers(Mode mode, QString modelLocation, Delegate delegate, int threads,
+                                                unsigned int poolSize, bool sharedFaceArena)
+{
+    QList<tfliteWorker*> workers;
+
+    if (mode == FD) {
+        /* Face Detection mode creates tfliteWorker objects to run the face
+         * detection, face landmark and iris landmark models */
+        workers << new tfliteWorker(MODEL_PATH_FD_FACE_DETECTION, delegate, threads);
+        workers << new tfliteWorker(MODEL_PATH_FD_FACE_LANDMARK, delegate, threads);
+        workers << new tfliteWorker(MODEL_PATH_FD_IRIS_LANDMARK, delegate, threads);
+        workers << new tfliteWorker(MODEL_PATH_FD_IRIS_LANDMARK, delegate, threads);
+
+        /* The models run one after another on each frame */
+        foreach (tfliteWorker *worker, workers)
+            worker->setSharedArena(sharedFaceArena);
+    } else {
+        workers << new tfliteWorker(modelLocation, delegate, threads);
+
+        /* Only the continuous modes have consecutive frames to run at once */
+        if (mode == OD || mode == PE)
+            workers.first()->setInterpreterPool(poolSize);
+    }
+
+    return workers;
+}
+
+void MainWindow::installTfWorkers(QList<tfliteWorker*> workers)
+{
     if (demoMode == FD) {
-        /* Face Detection mode creates two tfliteWorker objects to run the
-         * face detection and face landmark models */
-        tfWorkerFaceDetection = new tfliteWorker(MODEL_PATH_FD_FACE_DETECTION, delegateType, inferenceThreads);
-        tfWorkerFaceLandmark = new tfliteWorker(MODEL_PATH_FD_FACE_LANDMARK, delegateType, inferenceThreads);
-        tfWorkerIrisLandmarkL = new tfliteWorker(MODEL_PATH_FD_IRIS_LANDMARK, delegateType, inferenceThreads);
-        tfWorkerIrisLandmarkR = new tfliteWorker(MODEL_PATH_FD_IRIS_LANDMARK, delegateType, inferenceThreads);
+        tfWorkerFaceDetection = workers.at(0);
+        tfWorkerFaceLandmark = workers.at(1);
+        tfWorkerIrisLandmarkL = workers.at(2);
+        tfWorkerIrisLandmarkR = workers.at(3);
 
         connect(tfWorkerFaceDetection, SIGNAL(sendInferenceWarning(QString)), this, SLOT(inferenceWarning(QString)));
         connect(tfWorkerFaceLandmark, SIGNAL(sendInferenceWarning(QString)), this, SLOT(inferenceWarning(QString)));
         connect(tfWorkerIrisLandmarkL, SIGNAL(sendInferenceWarning(QString)), this, SLOT(inferenceWarning(QString)));
         connect(tfWorkerIrisLandmarkR, SIGNAL(sendInferenceWarning(QString)), this, SLOT(inferenceWarning(QString)));
+
+        /* Face detection crops from the display frame itself */
+        cvWorker->setModelInputSize(cv::Size());
     } else {
-        tfWorker = new tfliteWorker(modelPath, delegateType, inferenceThreads);
+        tfWorker = workers.first();
 
         connect(tfWorker, SIGNAL(sendInferenceWarning(QString)), this, SLOT(inferenceWarning(QString)));
+
+        if (demoMode == OD || demoMode == PE)
+            connect(this, SIGNAL(stopProcessing()), tfWorker, SLOT(discardPendingResults()), Qt::DirectConnection);
+
+        /* Let the video pipeline scale frames for the model as well */
+        cvWorker->setModelInputSize(tfWorker->getInputSize());
+    }
+
+    /* Warm up after the profiler is set, as setting it waits for warm-up */
+    foreach (tfliteWorker *worker, getTfWorkers()) {
+        worker->setProfiling(operatorProfiling);
+        worker->startWarmup();
     }
 
+    updateArmnnActions();
+
     if (delegateType == armNN)
         inferenceEngine = TEXT_INFERENCE_ENGINE_ARMNN_DELEGATE;
     else if (delegateType == none)
@@ -636,6 +718,41 @@ void MainWindow::setPoseEstimateDelegateType()
     }
 }
 
+/* Delegates the current mode and model can run with, following the same
+ * restrictions as setPoseEstimateDelegateType, disableArmNNDelegate and
+ * disableXnnPackDelegate */
+QList<Delegate> MainWindow::getSupportedDelegates()
+{
+    QList<Delegate> delegates = { none };
+
+    if (demoMode != FD && demoMode != AC && (demoMode != PE || modelPath.contains(IDENTIFIER_MOVE_NET)))
+        delegates.append(armNN);
+
+    if (demoMode != AC)
+        delegates.append(xnnpack);
+
+    return delegates;
+}
+
+void MainWindow::updateDelegateActions()
+{
+    QList<Delegate> delegates = getSupportedDelegates();
+
+    ui->actionEnable_ArmNN_Delegate->setEnabled(delegateType != armNN && delegates.contains(armNN));
+    ui->actionTensorflow_Lite_XNNPack_delegate->setEnabled(delegateType != xnnpack && delegates.contains(xnnpack));
+    ui->actionTensorFlow_Lite->setEnabled(delegateType != none);
+}
+
+/* The ArmNN options are kept per model, so show those of the current one */
+void MainWindow::updateArmnnActions()
+{
+    armnnOptionSet options = armnnOptions::get(modelPath);
+
+    ui->menuArmNN_Options->setEnabled(delegateType == armNN);
+    ui->actionArmNN_Fast_Math->setChecked(options.fastMath);
+    ui->actionArmNN_FP16->setChecked(options.reduceFp16);
+}
+
 void MainWindow::disableArmNNDelegate()
 {
     /* Do not enable ArmNN delegate when using modes that require
@@ -662,9 +779,14 @@ void MainWindow::disableXnnPackDelegate()
 
 void MainWindow::ShowVideo()
 {
+    TRACE_SCOPE("showVideo");
     const cv::Mat* image;
 
-    image = cvWorker->getImage(1);
+    /* The frame may already have been taken for inference */
+    if (!cvWorker->newFrameAvailable())
+        return;
+
+    image = cvWorker->getImage();
 
     if (image == nullptr) {
         qWarning("Camera no longer working.");
@@ -676,6 +798,8 @@ void MainWindow::ShowVideo()
 
 void MainWindow::drawBoxes(const QVector<float>& outputTensor, QStringList labelList)
 {
+    TRACE_SCOPE("drawBoxes");
+
     for (int i = 0; (i + 5) < outputTensor.size(); i += 6) {
         QPen pen;
         QBrush brush;
@@ -725,9 +849,67 @@ void MainWindow::on_actionLicense_triggered()
     msgBox->show();
 }
 
+/* Bytes held by the pixmaps shown in a scene */
+static int64_t scenePixmapBytes(QGraphicsScene *graphicsScene)
+{
+    int64_t pixmapBytes = 0;
+
+    foreach (QGraphicsItem *item, graphicsScene->items()) {
+        QGraphicsPixmapItem *pixmapItem = qgraphicsitem_cast<QGraphicsPixmapItem*>(item);
+
+        if (pixmapItem != nullptr) {
+            const QPixmap &pixmap = pixmapItem->pixmap();
+            pixmapBytes += int64_t(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        }
+    }
+
+    return pixmapBytes;
+}
+
 void MainWindow::on_actionHardware_triggered()
 {
-    QMessageBox *msgBox = new QMessageBox(QMessageBox::Information, "Information", boardInfo,
+    memorySample memory;
+    int64_t peakRss = 0;
+    QString hardwareInfo = boardInfo;
+
+    if (threadPlacement::isConfigured())
+        hardwareInfo += "\n\n" + threadPlacement::describe();
+
+    hardwareInfo += QString("\n\nFrame Buffers: %1 pooled, %2 reused, %3 allocated")
+            .arg(framePool::getBufferCount()).arg(framePool::getHits()).arg(framePool::getMisses());
+
+    if (memoryMonitor::readProcess(memory)) {
+        foreach (const memorySample &sample, memoryMonitor::getHistory())
+            peakRss = std::max(peakRss, sample.rssBytes);
+
+        hardwareInfo += QString("\n\nMemory: %1 RSS, %2 PSS, %3 peak RSS")
+                .arg(memoryMonitor::formatBytes(memory.rssBytes)).arg(memoryMonitor::formatBytes(memory.pssBytes))
+                .arg(memoryMonitor::formatBytes(std::max(peakRss, memory.rssBytes)));
+    }
+
+    hardwareInfo += QString("\nFrame Buffer Memory: %1, Scenes: %2 items, %3 pixmaps")
+            .arg(memoryMonitor::formatBytes(int64_t(framePool::getBufferBytes())))
+            .arg(scene->items().size() + sceneAC->items().size())
+            .arg(memoryMonitor::formatBytes(scenePixmapBytes(scene) + scenePixmapBytes(sceneAC)));
+
+    foreach (tfliteWorker *worker, getTfWorkers()) {
+        QJsonObject report = worker->getMemoryReport();
+
+        if (report["warming_up"].toBool()) {
+            hardwareInfo += QString("\n%1: warming up").arg(report["model"].toString());
+            continue;
+        }
+
+        hardwareInfo += QString("\n%1: %2 model (%3 resident), %4 arena, %5 built")
+                .arg(report["model"].toString())
+                .arg(memoryMonitor::formatBytes(report["model_bytes"].toVariant().toLongLong()))
+                .arg(memoryMonitor::formatBytes(report["model_resident_bytes"].toVariant().toLongLong()))
+                .arg(memoryMonitor::formatBytes(report["arena_bytes"].toVariant().toLongLong()
+                                                + report["persistent_arena_bytes"].toVariant().toLongLong()))
+                .arg(memoryMonitor::formatBytes(report["build_rss_bytes"].toVariant().toLongLong()));
+    }
+
+    QMessageBox *msgBox = new QMessageBox(QMessageBox::Information, "Information", hardwareInfo,
                                  QMessageBox::NoButton, this, Qt::Dialog | Qt::FramelessWindowHint);
     msgBox->setFont(font);
     font.setPixelSize(POPUP_DIALOG_TEXT_SIZE);
@@ -736,6 +918,7 @@ void MainWindow::on_actionHardware_triggered()
 
 void MainWindow::drawMatToView(const cv::Mat& matInput)
 {
+    TRACE_SCOPE("drawMatToView");
     QImage imageToDraw;
 
     imageToDraw = matToQImage(matInput);
@@ -762,18 +945,20 @@ QImage MainWindow::matToQImage(const cv::Mat& matToConvert)
     if (matToConvert.empty())
         return QImage(nullptr);
 
+    /* The image only wraps the frame, QPixmap::fromImage() makes the copy */
     convertedImage = QImage(matToConvert.data, matToConvert.cols,
                      matToConvert.rows, int(matToConvert.step),
-                        QImage::Format_RGB888).copy();
+                        QImage::Format_RGB888);
 
     return convertedImage;
 }
 
 void MainWindow::processFrame()
 {
+    TRACE_SCOPE("processFrame");
     const cv::Mat* image;
 
-    image = cvWorker->getImage(iterations);
+    image = cvWorker->getImage();
 
     if (image == nullptr) {
         /* Check if video file frame is empty */
@@ -790,31 +975,31 @@ void MainWindow::processFrame()
             errorPopup(TEXT_CAMERA_FAILURE_ERROR);
         }
     } else {
+        const cv::Mat* modelImage = cvWorker->getModelImage();
+
+        /* Face detection chains several models on crops of the frame, so only
+         * the single model modes reuse results. A still image always has a
+         * key so that it is not inferred again while it is being shown */
+        if (demoMode != FD && (resultCache::isEnabled() || inputMode == imageMode))
+            tfWorker->setFrameKey(cvWorker->getFrameKey());
+
         if (demoMode == FD)
             faceDetectMode->processFace(*image);
+        else if (modelImage != nullptr)
+            tfWorker->receiveImage(*image, *modelImage);
         else
             tfWorker->receiveImage(*image);
+
+        /* Fill every interpreter of the pool with consecutive frames, after
+         * that the mode asks for one frame per result */
+        if (demoMode != FD && inputMode != imageMode && tfWorker->canAcceptFrame())
+            QMetaObject::invokeMethod(this, "processFrame", Qt::QueuedConnection);
     }
 }
 
 void MainWindow::runFaceInference(const cv::Mat &receivedMat, FaceModel faceModelToUse, bool useIrisModel)
 {
-    if (faceDetectIrisMode != useIrisModel) {
-        faceDetectIrisMode = useIrisModel;
-
-        /* Connect correct signals for Face Detection model modes */
-        if (faceDetectIrisMode) {
-            disconnect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                       faceDetectMode, SLOT(runInference(QVector<float>, int, int)));
-            connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                    faceDetectMode, SLOT(setIrisCropDims(QVector<float>,int,int)));
-        } else {
-            disconnect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                       faceDetectMode, SLOT(setIrisCropDims(QVector<float>,int,int)));
-            connect(tfWorkerFaceLandmark, SIGNAL(sendOutputTensorImageless(QVector<float>,int,int)),
-                    faceDetectMode, SLOT(runInference(QVector<float>, int, int)));
-        }
-    }
+    faceDetectIrisMode = useIrisModel;
 
     if (faceModelToUse == faceDetect)
         tfWorkerFaceDetection->receiveImage(receivedMat);
@@ -826,6 +1011,34 @@ void MainWindow::runFaceInference(const cv::Mat &receivedMat, FaceModel faceMode
         tfWorkerIrisLandmarkR->receiveImage(receivedMat);
 }
 
+void MainWindow::runFaceLandmarkBatch(const QVector<cv::Mat> &faceMats)
+{
+    tfWorkerFaceLandmark->receiveImageBatch(faceMats);
+}
+
+QList<tfliteWorker*> MainWindow::getTfWorkers()
+{
+    if (demoMode == FD)
+        return { tfWorkerFaceDetection, tfWorkerFaceLandmark, tfWorkerIrisLandmarkL, tfWorkerIrisLandmarkR };
+
+    return { tfWorker };
+}
+
+/* The controller of the current mode, audio command mode has none */
+modeController *MainWindow::getModeController()
+{
+    if (demoMode == SB)
+        return shoppingBasketMode;
+    else if (demoMode == OD)
+        return objectDetectMode;
+    else if (demoMode == PE)
+        return poseEstimateMode;
+    else if (demoMode == FD)
+        return faceDetectMode;
+
+    return nullptr;
+}
+
 void MainWindow::deleteTfWorker()
 {
     if (demoMode == FD) {
@@ -838,14 +1051,86 @@ void MainWindow::deleteTfWorker()
     }
 }
 
-void MainWindow::remakeTfWorker()
+/* Build new workers for the current mode, model and delegate on a
+ * background thread and warm them up, while the current workers keep
+ * serving frames. tfWorkersLoaded() swaps them in once they are ready, so
+ * the display does not freeze while a large model is loaded. The model is
+ * tuned there first when it changed, so a delegate chosen from the Inference
+ * Engine menu is kept. With tuneOnly, no workers are built when tuning keeps
+ * the current choice */
+void MainWindow::remakeTfWorker(bool tuneOnly)
 {
-    deleteTfWorker();
-    createTfWorker();
-    disconnectSignals();
+    QThread *guiThread = thread();
+    Mode mode = demoMode;
+    QString modelLocation = modelPath;
+    QString tuneModelPath = getTuneModelPath();
+    QList<Delegate> delegates = getSupportedDelegates();
+    unsigned int poolSize = interpreterPoolSize;
+    bool sharedArena = sharedFaceArena;
+    bool tune = tuner && tuneModelPath != tunedModelPath;
+    autoTuner *modelTuner = tuner.get();
+    Delegate delegate = delegateType;
+    int threads = inferenceThreads;
+
+    tunedModelPath = tuneModelPath;
+
+    setModelLoading(true);
+
+    tfWorkerLoader->setFuture(QtConcurrent::run([=] {
+        QList<tfliteWorker*> workers;
+        Delegate tunedDelegate = delegate;
+        int tunedThreads = threads;
+
+        if (tune)
+            modelTuner->selectConfiguration(tuneModelPath, delegates, tunedDelegate, tunedThreads);
+
+        /* Read by tfWorkersLoaded() once the load has finished */
+        loadedDelegate = tunedDelegate;
+        loadedThreads = tunedThreads;
+
+        if (tuneOnly && tunedDelegate == delegate && tunedThreads == threads)
+            return workers;
+
+        workers = buildTfWorkers(mode, modelLocation, tunedDelegate, tunedThreads, poolSize, sharedArena);
+
+        foreach (tfliteWorker *worker, workers) {
+            worker->startWarmup();
+            worker->waitForWarmup();
+
+            /* The workers belong to the thread that created them, hand them
+             * to the GUI thread so their queued slots run there */
+            worker->moveToThread(guiThread);
+        }
+
+        return workers;
+    }));
+}
+
+/* Swap the loaded workers in, carrying on with continuous inference if it
+ * was running on the previous ones */
+void MainWindow::tfWorkersLoaded()
+{
+    QList<tfliteWorker*> workers = tfWorkerLoader->result();
+    bool resume = (demoMode == OD && objectDetectMode->getContinuousMode()) ||
+                  (demoMode == PE && poseEstimateMode->getContinuousMode());
+
+    delegateType = loadedDelegate;
+    inferenceThreads = loadedThreads;
+    updateDelegateActions();
+
+    /* Tuning kept the workers already running */
+    if (workers.isEmpty()) {
+        setModelLoading(false);
+        return;
+    }
 
     emit stopProcessing();
 
+    deleteTfWorker();
+    disconnectSignals();
+    setModelLoading(false);
+    installTfWorkers(workers);
+
     if (demoMode == SB)
         setupShoppingMode();
     else if (demoMode == OD)
@@ -858,6 +1143,36 @@ void MainWindow::remakeTfWorker()
         setupAudioCommandMode();
 
     checkInputMode();
+
+    if (resume && demoMode == OD)
+        QMetaObject::invokeMethod(objectDetectMode, "triggerInference", Qt::QueuedConnection);
+    else if (resume && demoMode == PE)
+        QMetaObject::invokeMethod(poseEstimateMode, "triggerInference", Qt::QueuedConnection);
+}
+
+/* Show that a model is loading and keep the menus and load buttons from
+ * starting another change until it is done */
+void MainWindow::setModelLoading(bool loading)
+{
+    ui->menuBar->setEnabled(!loading);
+    ui->pushButtonLoadAIModelOD->setEnabled(!loading);
+    ui->pushButtonLoadAIModelSB->setEnabled(!loading);
+    ui->pushButtonLoadPoseModel->setEnabled(!loading);
+
+    if (loading) {
+        QString modelName = (demoMode == FD) ? "face detection models" : QFileInfo(modelPath).fileName();
+
+        loadProgress = new QProgressDialog(QString(TEXT_LOADING_MODEL).arg(modelName), QString(), 0, 0, this,
+                                           Qt::Dialog | Qt::FramelessWindowHint);
+        font.setPixelSize(POPUP_DIALOG_TEXT_SIZE);
+        loadProgress->setFont(font);
+        loadProgress->setWindowModality(Qt::NonModal);
+        loadProgress->setMinimumDuration(0);
+        loadProgress->show();
+    } else if (loadProgress) {
+        delete loadProgress;
+        loadProgress = nullptr;
+    }
 }
 
 void MainWindow::on_actionEnable_ArmNN_Delegate_triggered()
@@ -914,6 +1229,61 @@ void MainWindow::on_actionTensorFlow_Lite_triggered()
     remakeTfWorker();
 }
 
+void MainWindow::on_actionArmNN_Fast_Math_triggered(bool enable)
+{
+    armnnOptionSet options = armnnOptions::get(modelPath);
+
+    options.fastMath = enable;
+    armnnOptions::set(modelPath, options);
+
+    remakeTfWorker();
+}
+
+void MainWindow::on_actionArmNN_FP16_triggered(bool enable)
+{
+    armnnOptionSet options = armnnOptions::get(modelPath);
+
+    options.reduceFp16 = enable;
+    armnnOptions::set(modelPath, options);
+
+    remakeTfWorker();
+}
+
+void MainWindow::on_actionProfile_Operators_toggled(bool enable)
+{
+    operatorProfiling = enable;
+    ui->actionShow_Operator_Profile->setEnabled(enable);
+
+    foreach (tfliteWorker *worker, getTfWorkers())
+        worker->setProfiling(enable);
+}
+
+void MainWindow::on_actionShow_Operator_Profile_triggered()
+{
+    QString summary;
+    QString details;
+
+    foreach (tfliteWorker *worker, getTfWorkers()) {
+        tfliteProfiler *profiler = worker->getProfiler();
+
+        if (profiler == nullptr)
+            continue;
+
+        summary += QFileInfo(worker->getModelName()).fileName() + " (" + inferenceEngine + ")\n";
+        summary += profiler->textReport() + "\n";
+        details += QFileInfo(worker->getModelName()).fileName() + "\n";
+        details += profiler->textNodeReport() + "\n";
+    }
+
+    QMessageBox *msgBox = new QMessageBox(QMessageBox::Information, "Operator Profile", summary,
+                                 QMessageBox::Close, this, Qt::Dialog | Qt::FramelessWindowHint);
+    msgBox->setDetailedText(details);
+    msgBox->setAttribute(Qt::WA_DeleteOnClose, true);
+    font.setPixelSize(POPUP_DIALOG_TEXT_SIZE);
+    msgBox->setFont(font);
+    msgBox->show();
+}
+
 void MainWindow::inferenceWarning(QString warningMessage)
 {
     QMessageBox *msgBox = new QMessageBox(QMessageBox::Critical, "Warning", warningMessage,
@@ -944,6 +1314,12 @@ void MainWindow::on_actionExit_triggered()
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    /* Do not leave a model load running on exit */
+    if (tfWorkerLoader->isRunning()) {
+        tfWorkerLoader->waitForFinished();
+        qDeleteAll(tfWorkerLoader->result());
+    }
+
     if (demoMode == OD || demoMode == PE)
         cvWorker->useCameraMode();
 
@@ -988,18 +1364,13 @@ void MainWindow::on_actionShopping_Basket_triggered()
     demoMode = SB;
     modelPath = modelSB;
     labelPath = labelSB;
-    labelFileList = readLabelFile(labelSB);
+    labelFileList = edgeUtils::readLabelFile(labelSB);
 
     if (cameraConnect)
         inputMode = cameraMode;
     else
         inputMode = imageMode;
 
-    if (cvWorker->getUsingMipi())
-        iterations = 6;
-    else
-        iterations = 2;
-
     createTfWorker();
     setupShoppingMode();
 
@@ -1064,9 +1435,7 @@ void MainWindow::on_actionObject_Detection_triggered()
     modelPath = modelOD;
     labelPath = labelOD;
     mediaPath = DEFAULT_VIDEO;
-    labelFileList = readLabelFile(labelPath);
-
-    iterations = 1;
+    labelFileList = edgeUtils::readLabelFile(labelPath);
 
     if (cameraConnect)
         inputMode = cameraMode;
@@ -1111,7 +1480,6 @@ void MainWindow::on_actionPose_Estimation_triggered()
     demoMode = PE;
     modelPath = modelPE;
     mediaPath = DEFAULT_VIDEO;
-    iterations = 1;
 
     if (cameraConnect)
         inputMode = cameraMode;
@@ -1155,7 +1523,6 @@ void MainWindow::on_actionFace_Detection_triggered()
     demoMode = FD;
     modelPath = MODEL_PATH_FD_FACE_LANDMARK;
     mediaPath = DEFAULT_FD_VIDEO;
-    iterations = 1;
 
     if (cameraConnect)
         inputMode = cameraMode;
@@ -1213,14 +1580,8 @@ void MainWindow::on_actionAudio_Command_triggered()
 
 void MainWindow::loadAIModel()
 {
-    qeventLoop = new QEventLoop;
     QFileDialog dialog(this);
 
-    connect(this, SIGNAL(modelLoaded()), qeventLoop, SLOT(quit()));
-
-    if (demoMode == OD)
-        emit stopProcessing();
-
     dialog.setFileMode(QFileDialog::AnyFile);
     dialog.setDirectory(MODEL_DIRECTORY);
     dialog.setNameFilter("TFLite Files (*tflite)");
@@ -1257,15 +1618,9 @@ void MainWindow::loadAIModel()
             labelPath = LABEL_PATH_SB;
     }
 
-    labelFileList = readLabelFile(labelPath);
-
-    delete tfWorker;
-    createTfWorker();
-    disconnectSignals();
+    labelFileList = edgeUtils::readLabelFile(labelPath);
 
-    if (demoMode == OD) {
-        setupObjectDetectMode();
-    } else if (demoMode == SB) {
+    if (demoMode == SB) {
         /* Prices file selection */
         dialog.setDirectory(PRICES_DIRECTORY);
         dialog.setNameFilter("Text Files (*txt)");
@@ -1277,14 +1632,12 @@ void MainWindow::loadAIModel()
 
         if (pricesPath.isEmpty())
             pricesPath = PRICES_PATH_DEFAULT;
-
-        setupShoppingMode();
     }
 
     dialog.close();
-    checkInputMode();
-    modelLoaded();
-    qeventLoop->exec();
+
+    /* The current model keeps running until the new one is ready */
+    remakeTfWorker();
 }
 
 void MainWindow::on_pushButtonLoadPoseModel_clicked()
@@ -1293,13 +1646,8 @@ void MainWindow::on_pushButtonLoadPoseModel_clicked()
                                     MODEL_PATH_PE_BLAZE_POSE_HEAVY, MODEL_PATH_PE_BLAZE_POSE_LITE,
                                     MODEL_PATH_PE_HAND_POSE_FULL, MODEL_PATH_PE_HAND_POSE_LITE };
 
-    qeventLoop = new QEventLoop;
     QFileDialog dialog(this);
 
-    connect(this, SIGNAL(modelLoaded()), qeventLoop, SLOT(quit()));
-
-    emit stopProcessing();
-
     dialog.setFileMode(QFileDialog::AnyFile);
     dialog.setDirectory(MODEL_DIRECTORY);
     dialog.setNameFilter("TFLite Files (*tflite)");
@@ -1324,15 +1672,10 @@ void MainWindow::on_pushButtonLoadPoseModel_clicked()
 
     setPoseEstimateDelegateType();
 
-    delete tfWorker;
-    createTfWorker();
-    disconnectSignals();
-    setupPoseEstimateMode();
-
     dialog.close();
-    checkInputMode();
-    modelLoaded();
-    qeventLoop->exec();
+
+    /* The current model keeps running until the new one is ready */
+    remakeTfWorker();
 }
 
 void MainWindow::on_actionLoad_File_triggered()
@@ -1438,29 +1781,7 @@ void MainWindow::on_actionLoad_File_triggered()
 
 void MainWindow::getImageFrame()
 {
-    emit sendMatToDraw(*cvWorker->getImage(1));
-}
-
-QStringList MainWindow::readLabelFile(QString labelPath)
-{
-    QFile labelFile;
-    QString fileLine;
-    QStringList labelList;
-
-    labelFile.setFileName(labelPath);
-    if (!labelFile.open(QIODevice::ReadOnly | QIODevice::Text))
-        qFatal("%s could not be opened.", labelPath.toStdString().c_str());
-
-    while (!labelFile.atEnd()) {
-        fileLine = labelFile.readLine();
-        fileLine.remove(QRegularExpression("^\\s*\\d*\\s*"));
-        fileLine.remove(QRegularExpression("\n"));
-        labelList.append(fileLine);
-    }
-
-    labelFile.close();
-
-    return labelList;
+    emit sendMatToDraw(*cvWorker->getImage());
 }
 
 void MainWindow::on_actionLoad_Periph_triggered()
@@ -1487,30 +1808,15 @@ void MainWindow::checkInputMode()
     if (inputMode == videoMode) {
         vidWorker->StopVideo();
 
-        if (demoMode == OD)
-            objectDetectMode->setVideoMode();
-        else if (demoMode == PE)
-            poseEstimateMode->setVideoMode();
-        else if (demoMode == FD)
-            faceDetectMode->setVideoMode();
+        /* Shopping basket does not take videos */
+        if (demoMode != SB && getModeController() != nullptr)
+            getModeController()->setVideoMode();
     } else if (inputMode == imageMode) {
-        if (demoMode == OD)
-            objectDetectMode->setImageMode();
-        else if (demoMode == SB)
-            shoppingBasketMode->setImageMode(true);
-        else if (demoMode == PE)
-            poseEstimateMode->setImageMode();
-        else if (demoMode == FD)
-            faceDetectMode->setImageMode();
+        if (getModeController() != nullptr)
+            getModeController()->setImageMode();
     } else if (inputMode == cameraMode) {
-        if (demoMode == OD)
-            objectDetectMode->setCameraMode();
-        else if (demoMode == SB)
-            shoppingBasketMode->setImageMode(false);
-        else if (demoMode == PE)
-            poseEstimateMode->setCameraMode();
-        else if (demoMode == FD)
-            faceDetectMode->setCameraMode();
+        if (getModeController() != nullptr)
+            getModeController()->setCameraMode();
     } else if (inputMode == micMode) {
         audioCommandMode->setMicMode();
     }
@@ -18,9 +18,13 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QFutureWatcher>
+#include <QList>
 #include <QMainWindow>
 #include <opencv2/videoio.hpp>
 
+#include <memory>
+
 #include "tfliteworker.h"
 #include "edge-utils.h"
 
@@ -43,14 +47,17 @@
 class QGraphicsScene;
 class QGraphicsView;
 class faceDetection;
+class modeController;
 class objectDetection;
 class audioCommand;
+class autoTuner;
 class opencvWorker;
 class poseEstimation;
 class shoppingBasket;
 class tfliteWorker;
 class QElapsedTimer;
 class QEventLoop;
+class QProgressDialog;
 class videoWorker;
 
 namespace Ui { class MainWindow; } //Needed for mainwindow.ui
@@ -61,7 +68,9 @@ class MainWindow : public QMainWindow
 
 public:
     MainWindow(QWidget *parent, QString boardName, QString cameraLocation, QString labelLocation,
-               QString modelLocation, QString videoLocation, Mode mode, QString pricesFile, bool irisOption, bool autoStart);
+               QString modelLocation, QString videoLocation, Mode mode, QString pricesFile, bool irisOption, bool autoStart,
+               bool autoTune, CameraFormat cameraFormat, unsigned int interpreterPool, bool sharedArena);
+    ~MainWindow();
 
 public slots:
     void ShowVideo();
@@ -69,7 +78,6 @@ public slots:
 
 signals:
     void fileLoaded();
-    void modelLoaded();
     void stopProcessing();
     void sendMatToDraw(const cv::Mat& matToSend);
 
@@ -80,11 +88,17 @@ private slots:
     void getImageFrame();
     void loadAIModel();
     void runFaceInference(const cv::Mat& receivedMat, FaceModel faceModelToUse, bool useIrisModel);
+    void runFaceLandmarkBatch(const QVector<cv::Mat>& faceMats);
+    void runFaceLandmarkBatch(const QVector<cv::Mat>& faceMats);
     void inferenceWarning(QString warningMessage);
     void on_actionLicense_triggered();
     void on_actionEnable_ArmNN_Delegate_triggered();
     void on_actionTensorFlow_Lite_triggered();
     void on_actionTensorflow_Lite_XNNPack_delegate_triggered();
+    void on_actionProfile_Operators_toggled(bool enable);
+    void on_actionArmNN_Fast_Math_triggered(bool enable);
+    void on_actionArmNN_FP16_triggered(bool enable);
+    void on_actionShow_Operator_Profile_triggered();
     void on_actionShopping_Basket_triggered();
     void on_actionObject_Detection_triggered();
     void on_actionPose_Estimation_triggered();
@@ -96,13 +110,19 @@ private slots:
     void on_actionLoad_File_triggered();
     void on_pushButtonLoadPoseModel_clicked();
     void errorPopup(QString errorMessage);
+    void tfWorkersLoaded();
 
 private:
     void createTfWorker();
+    QString getTuneModelPath();
+    static QList<tfliteWorker*> buildTfWorkers(Mode mode, QString modelLocation, Delegate delegate, int threads,
+                                               unsigned int poolSize, bool sharedFaceArena);
+    void installTfWorkers(QList<tfliteWorker*> workers);
+    void setModelLoading(bool loading);
     QImage matToQImage(const cv::Mat& matToConvert);
     void createVideoWorker();
     void deleteTfWorker();
-    void remakeTfWorker();
+    void remakeTfWorker(bool tuneOnly = false);
     void setupFaceDetectMode();
     void setupObjectDetectMode();
     void setupPoseEstimateMode();
@@ -116,10 +136,13 @@ private:
     void disableXnnPackDelegate();
     void startDefaultMode();
     void setGuiPixelSizes();
-    QStringList readLabelFile(QString labelPath);
+    QList<tfliteWorker*> getTfWorkers();
+    modeController *getModeController();
+    QList<Delegate> getSupportedDelegates();
+    void updateDelegateActions();
+    void updateArmnnActions();
 
     Ui::MainWindow *ui;
-    unsigned int iterations;
     Delegate delegateType;
     QFont font;
     QPixmap image;
@@ -138,6 +161,8 @@ private:
     tfliteWorker *tfWorkerIrisLandmarkL;
     tfliteWorker *tfWorkerIrisLandmarkR;
     QEventLoop *qeventLoop;
+    QFutureWatcher<QList<tfliteWorker*>> *tfWorkerLoader;
+    QProgressDialog *loadProgress;
     QString boardInfo;
     QString modelPath;
     QString pricesPath;
@@ -152,6 +177,14 @@ private:
     QString inferenceEngine;
     QStringList labelFileList;
     bool faceDetectIrisMode;
+    bool operatorProfiling;
+    std::unique_ptr<autoTuner> tuner;
+    QString tunedModelPath;
+    Delegate loadedDelegate;
+    int loadedThreads;
+    int inferenceThreads;
+    unsigned int interpreterPoolSize;
+    bool sharedFaceArena;
     bool cameraConnect;
     videoWorker *vidWorker;
     Board board;
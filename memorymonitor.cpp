@@ -0,0 +1,226 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <QtGlobal>
+
+#include "memorymonitor.h"
+#include "pipelinetrace.h"
+
+static std::mutex memoryMonitorMutex;
+static std::condition_variable memoryMonitorStop;
+static std::thread memoryMonitorThread;
+static std::deque<memorySample> memoryMonitorHistory;
+static bool memoryMonitorStopping = false;
+
+/* Values in smaps_rollup are in kB */
+static bool memoryMonitorReadField(const char *line, const char *field, int64_t &bytes)
+{
+    size_t fieldLength = strlen(field);
+    long long kiloBytes;
+
+    if (strncmp(line, field, fieldLength) != 0 || sscanf(line + fieldLength, " %lld", &kiloBytes) != 1)
+        return false;
+
+    bytes = int64_t(kiloBytes) * 1024;
+
+    return true;
+}
+
+bool memoryMonitor::readProcess(memorySample &sample)
+{
+    FILE *rollupFile = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+
+    sample.timestamp = pipelineTrace::timestamp();
+    sample.rssBytes = -1;
+    sample.pssBytes = -1;
+    sample.swapBytes = -1;
+
+    /* Kernels before 4.14 have no smaps_rollup, RSS is still available */
+    if (rollupFile == NULL) {
+        sample.rssBytes = readRss();
+        return sample.rssBytes >= 0;
+    }
+
+    while (fgets(line, sizeof(line), rollupFile) != NULL) {
+        if (memoryMonitorReadField(line, "Rss:", sample.rssBytes) ||
+            memoryMonitorReadField(line, "Pss:", sample.pssBytes))
+            continue;
+
+        memoryMonitorReadField(line, "Swap:", sample.swapBytes);
+    }
+
+    fclose(rollupFile);
+
+    return sample.rssBytes >= 0;
+}
+
+/* RSS alone from /proc/self/statm, which is cheap enough to read around
+ * individual allocations */
+int64_t memoryMonitor::readRss()
+{
+    FILE *statmFile = fopen("/proc/self/statm", "r");
+    long long totalPages, residentPages;
+    int fields;
+
+    if (statmFile == NULL)
+        return -1;
+
+    fields = fscanf(statmFile, "%lld %lld", &totalPages, &residentPages);
+    fclose(statmFile);
+
+    if (fields != 2)
+        return -1;
+
+    return int64_t(residentPages) * sysconf(_SC_PAGESIZE);
+}
+
+/* The number of bytes of a mapping that are in memory, for the model files
+ * which are mapped rather than read and so are only paged in as used */
+size_t memoryMonitor::residentBytes(const void *address, size_t length)
+{
+    size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    uintptr_t start = uintptr_t(address) & ~(pageSize - 1);
+    size_t pageCount = (uintptr_t(address) + length - start + pageSize - 1) / pageSize;
+    std::vector<unsigned char> pageStates;
+    size_t residentPages = 0;
+
+    if (address == nullptr || length == 0)
+        return 0;
+
+    pageStates.resize(pageCount);
+
+    if (mincore(reinterpret_cast<void *>(start), pageCount * pageSize, pageStates.data()) != 0)
+        return 0;
+
+    for (unsigned char pageState : pageStates)
+        residentPages += pageState & 1;
+
+    return std::min(residentPages * pageSize, length);
+}
+
+/* Sample the process memory every intervalMs on a thread of its own, so
+ * that the history covers the time the GUI thread is busy as well */
+void memoryMonitor::startSampling(int intervalMs)
+{
+    std::lock_guard<std::mutex> lock(memoryMonitorMutex);
+
+    if (memoryMonitorThread.joinable())
+        return;
+
+    memoryMonitorStopping = false;
+    memoryMonitorThread = std::thread(&memoryMonitor::samplingLoop, intervalMs);
+}
+
+void memoryMonitor::stopSampling()
+{
+    {
+        std::lock_guard<std::mutex> lock(memoryMonitorMutex);
+        memoryMonitorStopping = true;
+    }
+    memoryMonitorStop.notify_one();
+
+    if (memoryMonitorThread.joinable())
+        memoryMonitorThread.join();
+}
+
+void memoryMonitor::samplingLoop(int intervalMs)
+{
+    std::unique_lock<std::mutex> lock(memoryMonitorMutex);
+
+    pipelineTrace::setThreadName("memory");
+
+    while (!memoryMonitorStopping) {
+        memorySample sample;
+
+        /* smaps_rollup walks the page tables, so do not hold the lock */
+        lock.unlock();
+        bool valid = readProcess(sample);
+        lock.lock();
+
+        if (valid) {
+            if (memoryMonitorHistory.size() >= MEMORY_MONITOR_HISTORY)
+                memoryMonitorHistory.pop_front();
+
+            memoryMonitorHistory.push_back(sample);
+        }
+
+        memoryMonitorStop.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                                   [] { return memoryMonitorStopping; });
+    }
+}
+
+QVector<memorySample> memoryMonitor::getHistory()
+{
+    std::lock_guard<std::mutex> lock(memoryMonitorMutex);
+
+    return QVector<memorySample>(memoryMonitorHistory.begin(), memoryMonitorHistory.end());
+}
+
+/* Sizes that could not be read are left out */
+QJsonObject memoryMonitor::sampleJson(const memorySample &sample)
+{
+    QJsonObject sampleObject;
+
+    sampleObject["timestamp_us"] = qint64(sample.timestamp);
+
+    if (sample.rssBytes >= 0)
+        sampleObject["rss_bytes"] = qint64(sample.rssBytes);
+
+    if (sample.pssBytes >= 0)
+        sampleObject["pss_bytes"] = qint64(sample.pssBytes);
+
+    if (sample.swapBytes >= 0)
+        sampleObject["swap_bytes"] = qint64(sample.swapBytes);
+
+    return sampleObject;
+}
+
+QJsonArray memoryMonitor::historyJson()
+{
+    QJsonArray history;
+
+    foreach (const memorySample &sample, getHistory())
+        history.append(sampleJson(sample));
+
+    return history;
+}
+
+QString memoryMonitor::formatBytes(int64_t bytes)
+{
+    if (bytes < 0)
+        return "n/a";
+
+    if (bytes < 1024 * 1024)
+        return QString("%1 kB").arg(double(bytes) / 1024, 0, 'f', 1);
+
+    return QString("%1 MB").arg(double(bytes) / (1024 * 1024), 0, 'f', 1);
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+/* Number of samples kept, at one a second this is the last five minutes */
+#define MEMORY_MONITOR_HISTORY 300
+#define MEMORY_MONITOR_INTERVAL_MS 1000
+
+struct memorySample {
+    int64_t timestamp;
+    int64_t rssBytes;
+    int64_t pssBytes;
+    int64_t swapBytes;
+};
+
+/* Reads the memory use of the process from /proc/self/smaps_rollup, and
+ * keeps a history of it when sampling is started. PSS splits shared pages
+ * such as the mapped model files between the processes that map them, so it
+ * is the better figure on boards that also run other applications */
+class memoryMonitor
+{
+public:
+    static bool readProcess(memorySample &sample);
+    static int64_t readRss();
+    static size_t residentBytes(const void *address, size_t length);
+    static void startSampling(int intervalMs);
+    static void stopSampling();
+    static QVector<memorySample> getHistory();
+    static QJsonObject sampleJson(const memorySample &sample);
+    static QJsonArray historyJson();
+    static QString formatBytes(int64_t bytes);
+
+private:
+    static void samplingLoop(int intervalMs);
+};
+
+#endif // MEMORYMONITOR_H
@@ -0,0 +1,268 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+#include <QtGlobal>
+
+#include "framepool.h"
+#include "mjpegdecoder.h"
+#include "pipelinetrace.h"
+#include "threadplacement.h"
+
+/* libjpeg exits the process on errors by default, return to decode() instead */
+struct jpegErrorManager {
+    struct jpeg_error_mgr manager;
+    jmp_buf returnPoint;
+};
+
+static void jpegErrorExit(j_common_ptr info)
+{
+    jpegErrorManager *errorManager = reinterpret_cast<jpegErrorManager*>(info->err);
+
+    longjmp(errorManager->returnPoint, 1);
+}
+
+/* Corrupt frames are common on USB cameras, they are counted not logged */
+static void jpegOutputMessage(j_common_ptr)
+{
+}
+
+mjpegDecoder::mjpegDecoder(unsigned int workerCount)
+{
+    submittedSequence = 0;
+    latestSequence = 0;
+    returnedSequence = 0;
+    decodeErrors = 0;
+    stopping = false;
+
+    if (workerCount == 0)
+        workerCount = 1;
+
+    /* One frame waiting per worker is enough to keep them all busy */
+    jobLimit = workerCount;
+
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.push_back(std::thread(&mjpegDecoder::workerLoop, this));
+}
+
+mjpegDecoder::~mjpegDecoder()
+{
+    stop();
+}
+
+void mjpegDecoder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(decoderMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    frameReady.notify_all();
+
+    for (std::thread &worker : workers) {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+/* The size the frames are fitted inside, an empty size decodes them at full
+ * resolution */
+void mjpegDecoder::setTargetSize(cv::Size size)
+{
+    std::lock_guard<std::mutex> lock(decoderMutex);
+
+    targetSize = size;
+}
+
+/* Queue a frame for decoding, the data is copied. When the workers are
+ * behind the oldest waiting frame is dropped */
+void mjpegDecoder::submit(const uint8_t *jpegData, size_t jpegSize)
+{
+    decodeJob job;
+
+    job.jpegData.assign(jpegData, jpegData + jpegSize);
+
+    {
+        std::lock_guard<std::mutex> lock(decoderMutex);
+
+        if (stopping)
+            return;
+
+        job.sequence = ++submittedSequence;
+
+        if (jobs.size() >= jobLimit)
+            jobs.pop_front();
+
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+/* Waits for a frame newer than the one returned last time. The frame is not
+ * shared with the decoder. Returns false once the decoder is stopped */
+bool mjpegDecoder::getFrame(cv::Mat &frame)
+{
+    std::unique_lock<std::mutex> lock(decoderMutex);
+
+    frameReady.wait(lock, [this] { return stopping || latestSequence > returnedSequence; });
+
+    if (latestSequence <= returnedSequence)
+        return false;
+
+    frame = latestFrame;
+    returnedSequence = latestSequence;
+
+    /* The next decoded frame goes into a new buffer */
+    latestFrame = cv::Mat();
+
+    return true;
+}
+
+/* True when getFrame() would not wait, because there is a newer frame or
+ * the decoder has stopped */
+bool mjpegDecoder::frameAvailable()
+{
+    std::lock_guard<std::mutex> lock(decoderMutex);
+
+    return stopping || latestSequence > returnedSequence;
+}
+
+/* Called on a worker thread each time a newer frame is ready. Must be set
+ * before the first frame is submitted */
+void mjpegDecoder::setFrameCallback(std::function<void()> callback)
+{
+    frameCallback = callback;
+}
+
+unsigned long mjpegDecoder::getDecodeErrors()
+{
+    std::lock_guard<std::mutex> lock(decoderMutex);
+
+    return decodeErrors;
+}
+
+void mjpegDecoder::workerLoop()
+{
+    pipelineTrace::setThreadName("mjpeg");
+    threadPlacement::applyRole(captureRole);
+
+    while (true) {
+        decodeJob job;
+        cv::Size size;
+        cv::Mat frame;
+        bool decoded;
+
+        {
+            std::unique_lock<std::mutex> lock(decoderMutex);
+
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping)
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            size = targetSize;
+        }
+
+        decoded = decode(job.jpegData.data(), job.jpegData.size(), size, frame);
+
+        {
+            std::lock_guard<std::mutex> lock(decoderMutex);
+
+            if (!decoded) {
+                decodeErrors++;
+                continue;
+            }
+
+            /* Workers can finish out of order, never go back to an older frame */
+            if (job.sequence <= latestSequence)
+                continue;
+
+            latestFrame = frame;
+            latestSequence = job.sequence;
+        }
+        frameReady.notify_all();
+
+        if (frameCallback)
+            frameCallback();
+    }
+}
+
+bool mjpegDecoder::decode(const uint8_t *jpegData, size_t jpegSize, cv::Size targetSize, cv::Mat &frame)
+{
+    TRACE_SCOPE("jpegDecode");
+    struct jpeg_decompress_struct decompress;
+    jpegErrorManager errorManager;
+
+    decompress.err = jpeg_std_error(&errorManager.manager);
+    errorManager.manager.error_exit = jpegErrorExit;
+    errorManager.manager.output_message = jpegOutputMessage;
+
+    if (setjmp(errorManager.returnPoint)) {
+        jpeg_destroy_decompress(&decompress);
+        return false;
+    }
+
+    jpeg_create_decompress(&decompress);
+    jpeg_mem_src(&decompress, const_cast<uint8_t*>(jpegData), jpegSize);
+
+    if (jpeg_read_header(&decompress, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&decompress);
+        return false;
+    }
+
+    decompress.out_color_space = JCS_RGB;
+    decompress.dct_method = JDCT_IFAST;
+    decompress.scale_num = 1;
+    decompress.scale_denom = 1;
+
+    /* The frame is fitted inside the target with the aspect ratio kept, so
+     * only the dimension with the largest reduction needs to be filled, as
+     * when reading image files */
+    if (!targetSize.empty()) {
+        for (unsigned int denom = 8; denom > 1; denom /= 2) {
+            unsigned int scaledWidth = (decompress.image_width + denom - 1) / denom;
+            unsigned int scaledHeight = (decompress.image_height + denom - 1) / denom;
+
+            if (scaledWidth >= unsigned(targetSize.width) || scaledHeight >= unsigned(targetSize.height)) {
+                decompress.scale_denom = denom;
+                break;
+            }
+        }
+    }
+
+    jpeg_start_decompress(&decompress);
+
+    frame = framePool::acquire(cv::Size(decompress.output_width, decompress.output_height), CV_8UC3);
+
+    while (decompress.output_scanline < decompress.output_height) {
+        JSAMPROW row = frame.ptr<uint8_t>(decompress.output_scanline);
+
+        jpeg_read_scanlines(&decompress, &row, 1);
+    }
+
+    jpeg_finish_decompress(&decompress);
+    jpeg_destroy_decompress(&decompress);
+
+    return true;
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef MJPEGDECODER_H
+#define MJPEGDECODER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/* Decodes a stream of JPEG frames, such as MJPEG camera capture, on a pool
+ * of worker threads with libjpeg-turbo. Frames are decoded straight to RGB
+ * and, when a target size is set, scaled down in the DCT by the largest of
+ * 1/2, 1/4 or 1/8 that still fills it when fitted inside with the aspect
+ * ratio kept. Only the newest frame is kept, as with a live camera, so a
+ * slow consumer just sees fewer frames */
+class mjpegDecoder
+{
+public:
+    explicit mjpegDecoder(unsigned int workerCount);
+    ~mjpegDecoder();
+    void setTargetSize(cv::Size size);
+    void submit(const uint8_t *jpegData, size_t jpegSize);
+    bool getFrame(cv::Mat &frame);
+    bool frameAvailable();
+    void setFrameCallback(std::function<void()> callback);
+    void stop();
+    unsigned long getDecodeErrors();
+
+    static bool decode(const uint8_t *jpegData, size_t jpegSize, cv::Size targetSize, cv::Mat &frame);
+
+private:
+    struct decodeJob {
+        uint64_t sequence;
+        std::vector<uint8_t> jpegData;
+    };
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<decodeJob> jobs;
+    std::mutex decoderMutex;
+    std::condition_variable jobReady;
+    std::condition_variable frameReady;
+    std::function<void()> frameCallback;
+    cv::Size targetSize;
+    cv::Mat latestFrame;
+    uint64_t submittedSequence;
+    uint64_t latestSequence;
+    uint64_t returnedSequence;
+    unsigned int jobLimit;
+    unsigned long decodeErrors;
+    bool stopping;
+};
+
+#endif // MJPEGDECODER_H
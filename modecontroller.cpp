@@ -0,0 +1,166 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QLabel>
+#include <QPushButton>
+
+#include "modecontroller.h"
+#include "ui_mainwindow.h"
+
+modeController::modeController(Ui::MainWindow *ui, bool cameraConnect)
+{
+    uiMode = ui;
+    inputMode = cameraMode;
+    continuousMode = false;
+    camConnect = cameraConnect;
+    startStopButton = nullptr;
+    totalFpsLabel = nullptr;
+    buttonState = true;
+}
+
+/* The modes without a start/stop button leave it unset */
+void modeController::setStartStopButton(QPushButton *button, QLabel *fpsLabel)
+{
+    startStopButton = button;
+    totalFpsLabel = fpsLabel;
+
+    setButtonState(buttonState);
+}
+
+/* Repaint the button straight away rather than running the event loop, the
+ * next frame may block the GUI thread before the queued paint happens */
+void modeController::setButtonState(bool enable)
+{
+    buttonState = enable;
+
+    if (startStopButton == nullptr)
+        return;
+
+    if (buttonState) {
+        startStopButton->setText("Start\nInference");
+        startStopButton->setStyleSheet(BUTTON_BLUE);
+    } else {
+        startStopButton->setText("Stop\nInference");
+        startStopButton->setStyleSheet(BUTTON_RED);
+    }
+
+    startStopButton->repaint();
+}
+
+void modeController::triggerInference()
+{
+    if (inputMode == imageMode) {
+        continuousMode = false;
+
+        emit stopVideo();
+        setButtonState(false);
+
+        emit getFrame();
+    } else if (buttonState) {
+        continuousMode = true;
+
+        fpsTimer.timeTotalFps(true);
+        setButtonState(false);
+        emit stopVideo();
+
+        emit getFrame();
+    } else {
+        continuousMode = false;
+
+        emit continuousModeStopped();
+        setButtonState(true);
+
+        if (inputMode == videoMode) {
+            emit stopVideo();
+        } else {
+            emit startVideo();
+            clearResults();
+        }
+    }
+}
+
+void modeController::stopContinuousMode()
+{
+    continuousMode = false;
+
+    emit continuousModeStopped();
+    emit stopVideo();
+    setButtonState(true);
+    clearResults();
+
+    if (inputMode != videoMode)
+        emit startVideo();
+}
+
+/* Called by the modes once the results of a frame are shown. In continuous
+ * mode the total FPS is updated and the next frame requested, otherwise
+ * inference is finished */
+void modeController::finishFrame()
+{
+    if (!continuousMode) {
+        setButtonState(true);
+        return;
+    }
+
+    /* Stop Total FPS timer and display it to GUI, then restart timer before getting the next frame */
+    fpsTimer.timeTotalFps(false);
+
+    if (totalFpsLabel != nullptr)
+        totalFpsLabel->setText(TEXT_TOTAL_FPS + QString::number(double(fpsTimer.calculateTotalFps()), 'f', 1));
+
+    fpsTimer.timeTotalFps(true);
+
+    emit getFrame();
+}
+
+/* Reset the results shown when inference stops */
+void modeController::clearResults()
+{
+    if (totalFpsLabel != nullptr)
+        totalFpsLabel->setText(TEXT_TOTAL_FPS);
+}
+
+/* True while inference runs on frame after frame */
+bool modeController::getContinuousMode()
+{
+    return continuousMode;
+}
+
+void modeController::setCameraMode()
+{
+    inputMode = cameraMode;
+
+    uiMode->actionLoad_Periph->setEnabled(false);
+    uiMode->actionLoad_File->setText(TEXT_LOAD_FILE);
+}
+
+void modeController::setImageMode()
+{
+    inputMode = imageMode;
+
+    uiMode->actionLoad_Periph->setEnabled(camConnect);
+    uiMode->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
+}
+
+void modeController::setVideoMode()
+{
+    inputMode = videoMode;
+
+    uiMode->actionLoad_Periph->setEnabled(camConnect);
+    uiMode->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef MODECONTROLLER_H
+#define MODECONTROLLER_H
+
+#include <QObject>
+
+#include <opencv2/videoio.hpp>
+
+#include "edge-utils.h"
+
+class QLabel;
+class QPushButton;
+
+namespace Ui { class MainWindow; }
+
+/* State shared by the demo modes: the input in use, the start/stop button
+ * and running inference on frame after frame with the total FPS shown. The
+ * modes convert the results of their models and draw them, and call
+ * finishFrame() once a frame is done.
+ *
+ * Nothing here runs the event loop. The next frame is requested with
+ * getFrame(), which the window queues, so the button and the results are
+ * drawn between frames. continuousModeStopped() lets the window drop the
+ * results of frames that are still being run when inference is stopped */
+class modeController : public QObject
+{
+    Q_OBJECT
+
+public:
+    modeController(Ui::MainWindow *ui, bool cameraConnect);
+    virtual void setCameraMode();
+    virtual void setImageMode();
+    virtual void setVideoMode();
+    bool getContinuousMode();
+
+public slots:
+    void triggerInference();
+    void stopContinuousMode();
+
+signals:
+    void getFrame();
+    void sendMatToView(const cv::Mat&receivedMat);
+    void startVideo();
+    void stopVideo();
+    void continuousModeStopped();
+
+protected:
+    void setStartStopButton(QPushButton *button, QLabel *fpsLabel);
+    void setButtonState(bool enable);
+    void finishFrame();
+    virtual void clearResults();
+
+    Input inputMode;
+    bool continuousMode;
+    bool camConnect;
+
+private:
+    Ui::MainWindow *uiMode;
+    QPushButton *startStopButton;
+    QLabel *totalFpsLabel;
+    edgeUtils fpsTimer;
+    bool buttonState;
+};
+
+#endif // MODECONTROLLER_H
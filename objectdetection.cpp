@@ -16,25 +16,22 @@
  * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
-#include <QEventLoop>
-
 #include "objectdetection.h"
+#include "pipelinetrace.h"
+#include "postprocess.h"
 #include "ui_mainwindow.h"
 
 #define ITEM_OFFSET 4
 
 objectDetection::objectDetection(Ui::MainWindow *ui, QStringList labelFileList, QString modelPath,
                                  QString inferenceEngine, bool cameraConnect)
+    : modeController(ui, cameraConnect)
 {
     QFont font;
     QString modelName;
 
     uiOD = ui;
-    inputModeOD = cameraMode;
     labelList = labelFileList;
-    camConnect = cameraConnect;
-
-    utilOD = new edgeUtils();
 
     modelName = modelPath.section('/', -1);
 
@@ -65,91 +62,12 @@ objectDetection::objectDetection(Ui::MainWindow *ui, QStringList labelFileList,
     uiOD->stackedWidgetLeft->setCurrentIndex(STACK_WIDGET_INDEX_OD);
     uiOD->stackedWidgetRight->setCurrentIndex(STACK_WIDGET_INDEX_OD);
 
-    setButtonState(true);
-}
-
-void objectDetection::setButtonState(bool enable)
-{
-    buttonState = enable;
-
-    if (buttonState) {
-        uiOD->pushButtonStartStop->setText("Start\nInference");
-        uiOD->pushButtonStartStop->setStyleSheet(BUTTON_BLUE);
-    } else {
-        uiOD->pushButtonStartStop->setText("Stop\nInference");
-        uiOD->pushButtonStartStop->setStyleSheet(BUTTON_RED);
-    }
-
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
-}
-
-void objectDetection::triggerInference()
-{
-    if (inputModeOD == imageMode) {
-        continuousMode = false;
-
-        stopVideo();
-        setButtonState(false);
-
-        emit getFrame();
-    } else {
-        if (buttonState) {
-            continuousMode = true;
-
-            utilOD->timeTotalFps(true);
-            setButtonState(false);
-            stopVideo();
-
-            emit getFrame();
-        } else {
-            continuousMode = false;
-
-            setButtonState(true);
-
-            if (inputModeOD == videoMode) {
-                stopVideo();
-            } else {
-                startVideo();
-                uiOD->labelInferenceTimeOD->setText(TEXT_INFERENCE);
-                uiOD->labelTotalFps->setText(TEXT_TOTAL_FPS);
-                uiOD->tableWidgetOD->setRowCount(0);
-            }
-        }
-    }
-}
-
-QVector<float> objectDetection::sortTensor(QVector<float> &receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-
-    /* The final output tensor of the model is unused in this demo mode */
-    receivedTensor.removeLast();
-
-    for(int i = receivedStride; i > 0; i--) {
-        float confidenceLevel = receivedTensor.at(receivedTensor.size() - i);
-
-        /* Only include the item if the confidence level is at threshold */
-        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= float(1.0)) {
-            /* Box points */
-            for(int j = 0; j < BOX_POINTS; j++)
-                sortedTensor.push_back(receivedTensor.at((receivedStride - i) * BOX_POINTS + j));
-
-            /* Item ID */
-            sortedTensor.push_back(receivedTensor.at(receivedTensor.size() - ((receivedStride * 2)) + (receivedStride - i)));
-
-            /* Confidence level */
-            sortedTensor.push_back(confidenceLevel);
-        }
-    }
-
-    return sortedTensor;
+    setStartStopButton(uiOD->pushButtonStartStop, uiOD->labelTotalFps);
 }
 
 void objectDetection::runInference(QVector<float> receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat)
 {
-    float totalFps;
-
-    outputTensor = sortTensor(receivedTensor, receivedStride);
+    outputTensor = postProcess::sortTensorSSD(receivedTensor, receivedStride);
 
     uiOD->labelInferenceTimeOD->setText(TEXT_INFERENCE + QString("%1 ms").arg(receivedTimeElapsed));
 
@@ -157,23 +75,14 @@ void objectDetection::runInference(QVector<float> receivedTensor, int receivedSt
 
     emit sendMatToView(receivedMat);
 
-    if (continuousMode) {
-        /* Stop Total FPS timer and display it to GUI, then restart timer before getting the next frame */
-        utilOD->timeTotalFps(false);
-        totalFps = utilOD->calculateTotalFps();
-        uiOD->labelTotalFps->setText(TEXT_TOTAL_FPS + QString::number(double(totalFps), 'f', 1));
-        utilOD->timeTotalFps(true);
-
-        emit getFrame();
-    } else {
-        setButtonState(true);
-    }
+    finishFrame();
 
     emit getBoxes(outputTensor, labelList);
 }
 
 void objectDetection::updateObjectList(const QVector<float> receivedList)
 {
+    TRACE_SCOPE("updateObjectList");
     QStringList objectsDetectedList;
     QTableWidgetItem* objectName;
     QTableWidgetItem* objectAmount;
@@ -202,41 +111,10 @@ void objectDetection::updateObjectList(const QVector<float> receivedList)
     uiOD->tableWidgetOD->insertRow(uiOD->tableWidgetOD->rowCount());
 }
 
-void objectDetection::setCameraMode()
+void objectDetection::clearResults()
 {
-    inputModeOD = cameraMode;
-
-    uiOD->actionLoad_Periph->setEnabled(false);
-    uiOD->actionLoad_File->setText(TEXT_LOAD_FILE);
-}
-
-void objectDetection::setImageMode()
-{
-    inputModeOD = imageMode;
-
-    uiOD->actionLoad_Periph->setEnabled(camConnect);
-    uiOD->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
-}
-
-void objectDetection::setVideoMode()
-{
-    inputModeOD = videoMode;
-
-    uiOD->actionLoad_Periph->setEnabled(camConnect);
-    uiOD->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
-}
-
-void objectDetection::stopContinuousMode()
-{
-    continuousMode = false;
-
-    stopVideo();
-    setButtonState(true);
+    modeController::clearResults();
 
     uiOD->labelInferenceTimeOD->setText(TEXT_INFERENCE);
-    uiOD->labelTotalFps->setText(TEXT_TOTAL_FPS);
     uiOD->tableWidgetOD->setRowCount(0);
-
-    if (inputModeOD != videoMode)
-        emit startVideo();
 }
@@ -24,48 +24,34 @@
 #include <opencv2/videoio.hpp>
 
 #include "edge-utils.h"
+#include "modecontroller.h"
 
 class QGraphicsScene;
 
 namespace Ui { class MainWindow; }
 
-class objectDetection : public QObject
+class objectDetection : public modeController
 {
      Q_OBJECT
 
 public:
     objectDetection(Ui::MainWindow *ui, QStringList labelFileList, QString modelPath, QString inferenceEngine, bool cameraConnect);
-    void setImageMode();
-    void setVideoMode();
-    void setCameraMode();
 
 public slots:
     void runInference(QVector<float> receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat&receivedMat);
 
 signals:
-    void getFrame();
     void getBoxes(const QVector<float>& receivedTensor, QStringList labelList);
-    void sendMatToView(const cv::Mat&receivedMat);
-    void startVideo();
-    void stopVideo();
 
-private slots:
-    void stopContinuousMode();
-    void triggerInference();
+protected:
+    void clearResults() override;
 
 private:
-    void setButtonState(bool enable);
-    QVector<float> sortTensor(QVector<float> &receivedTensor, int receivedStride);
     void updateObjectList(const QVector<float> receivedList);
 
     Ui::MainWindow *uiOD;
-    edgeUtils *utilOD;
     QVector<float> outputTensor;
-    bool buttonState;
-    bool continuousMode;
-    bool camConnect;
     QStringList labelList;
-    Input inputModeOD;
 };
 
 #endif // OBJECTDETECTION_H
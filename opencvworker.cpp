@@ -16,7 +16,12 @@
  * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
+#include <algorithm>
+
+#include <QDateTime>
 #include <QDebug>
+#include <QFileInfo>
+#include <QImageReader>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -25,7 +30,11 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#include "framepool.h"
 #include "opencvworker.h"
+#include "pipelinetrace.h"
+#include "resultcache.h"
+#include "threadplacement.h"
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -34,23 +43,47 @@
 #define G2M_CAM_INIT "media-ctl -d /dev/media0 -r && media-ctl -d /dev/media0 -l \"'rcar_csi2 fea80000.csi2':1->'VIN0 output':0 [1]\" && media-ctl -d /dev/media0 -V \"'rcar_csi2 fea80000.csi2':1 [fmt:UYVY8_2X8/800x600 field:none]\" && media-ctl -d /dev/media0 -V \"'ov5645 2-003c':0 [fmt:UYVY8_2X8/800x600 field:none]\""
 #define G2E_CAM_INIT "media-ctl -d /dev/media0 -r && media-ctl -d /dev/media0 -l \"'rcar_csi2 feaa0000.csi2':1->'VIN4 output':0 [1]\" && media-ctl -d /dev/media0 -V \"'rcar_csi2 feaa0000.csi2':1 [fmt:UYVY8_2X8/800x600 field:none]\" && media-ctl -d /dev/media0 -V \"'ov5645 3-003c':0 [fmt:UYVY8_2X8/800x600 field:none]\""
 
-#define GST_CODEC_PIPELINE " ! qtdemux ! queue ! h264parse ! omxh264dec ! queue ! vspmfilter dmabuf-use=true ! "
-#define GST_NO_CODEC_PIPELINE " ! decodebin ! videoscale ! videoconvert ! "
-
 #define RESOLUTION_ERR "Resolution of file is not supported."
 #define FILE_OPEN_ERR "File could not be opened, please check resolution"
 #define STREAM_OPEN_ERR "Could not open video file for streaming"
 
 #define SCALE_RATE 0.95
 
-opencvWorker::opencvWorker(QString cameraLocation, Board board)
+#define MJPEG_DECODE_WORKERS_MAX 3
+#define CAMERA_CAPTURE_FAILURES_MAX 10
+
+/* The newest frame, the one being shown and the one being inferred, plus a
+ * spare for the capture thread */
+#define CAMERA_POOL_BUFFERS 4
+
+/* Used when the driver does not report the frame rate */
+#define CAMERA_DEFAULT_FRAME_RATE 30
+
+opencvWorker::opencvWorker(QString cameraLocation, Board board, CameraFormat format)
 {
     webcamName = cameraLocation.toStdString();
+    cameraFormat = format;
+    captureRunning = false;
+    captureDecoding = true;
+    frameNotified = false;
+    latestSequence = 0;
+    returnedSequence = 0;
+    cameraFrameRate = 0;
     connectionAttempts = 0;
     inputOpenCV = cameraMode;
     videoCodecs = true;
+    videoLoop = true;
+    videoRealTime = true;
+    videoReader.reset(new gstVideoReader());
+    webcamOpened = false;
 
-    setupCamera();
+    /* File input gives no device, so there is no camera to probe */
+    if (cameraLocation.isEmpty()) {
+        webcamInitialised = false;
+        usingMipi = false;
+    } else {
+        setupCamera();
+    }
 
     if (webcamInitialised && usingMipi) {
         if (board == G2M)
@@ -66,6 +99,9 @@ opencvWorker::opencvWorker(QString cameraLocation, Board board)
 
     if (webcamInitialised)
         connectCamera();
+
+    if (webcamInitialised && webcamOpened)
+        startCapture();
 }
 
 int opencvWorker::runCommand(std::string command, std::string &stdoutput)
@@ -154,6 +190,20 @@ void opencvWorker::connectCamera()
         webcamOpened = true;
     }
 
+    if (!usingMipi && cameraFormat != uyvyCapture) {
+        /* MJPEG fits 720p at full frame rate into USB 2.0 bandwidth. The
+         * compressed frames are passed through and decoded by jpegDecoder */
+        camera.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+        camera.set(cv::CAP_PROP_CONVERT_RGB, 0);
+        camera.set(cv::CAP_PROP_FPS, 30);
+        camera.set(cv::CAP_PROP_BUFFERSIZE, 1);
+        camera.set(cv::CAP_PROP_FRAME_WIDTH, 1280);
+        camera.set(cv::CAP_PROP_FRAME_HEIGHT, 720);
+
+        checkCamera();
+        return;
+    }
+
     if (!usingMipi) {
         camera.set(cv::CAP_PROP_FPS, 10);
         camera.set(cv::CAP_PROP_BUFFERSIZE, 1);
@@ -173,7 +223,9 @@ void opencvWorker::checkCamera()
     /* Check to see if camera can retrieve a frame*/
     camera >> picture;
 
-    if (picture.empty()) {
+    if (!picture.empty()) {
+        cameraFrameRate = camera.get(cv::CAP_PROP_FPS);
+    } else {
         qWarning("Lost connection to camera, reconnecting");
         camera.release();
 
@@ -186,56 +238,252 @@ void opencvWorker::checkCamera()
     }
 }
 
+/* Frames are read from the camera on their own thread, so the GUI thread
+ * never waits on the driver. Raw frames are converted to RGB there, MJPEG
+ * frames are handed to the decoder pool. getImage() then takes the newest
+ * frame and frameReady() tells the display that one has arrived */
+void opencvWorker::startCapture()
+{
+    if (!usingMipi && cameraFormat != uyvyCapture) {
+        unsigned int decodeWorkers = std::max(1u, std::min(std::thread::hardware_concurrency(),
+                                                            unsigned(MJPEG_DECODE_WORKERS_MAX)));
+
+        jpegDecoder.reset(new mjpegDecoder(decodeWorkers));
+
+        /* Decode close to the size the frames are displayed at */
+        if (cameraFormat == mjpegCapture)
+            jpegDecoder->setTargetSize(cv::Size(GRAPHICS_VIEW_WIDTH, GRAPHICS_VIEW_HEIGHT));
+
+        jpegDecoder->setFrameCallback([this] { notifyFrame(); });
+    } else if (!picture.empty()) {
+        /* Raw frames are converted into pooled buffers the size of the
+         * first frame read when connecting */
+        framePool::reserve(picture.size(), CV_8UC3, CAMERA_POOL_BUFFERS);
+    }
+
+    captureRunning = true;
+    captureThread = std::thread(&opencvWorker::captureLoop, this);
+}
+
+void opencvWorker::stopCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        captureRunning = false;
+    }
+    frameCondition.notify_all();
+
+    if (captureThread.joinable())
+        captureThread.join();
+
+    if (jpegDecoder)
+        jpegDecoder->stop();
+}
+
+void opencvWorker::captureLoop()
+{
+    pipelineTrace::setThreadName("camera");
+    threadPlacement::applyRole(captureRole);
+    int failures = 0;
+    cv::Mat capturedFrame;
+
+    while (captureRunning) {
+        cv::Mat rgbFrame;
+
+        {
+            TRACE_SCOPE("capture");
+
+            if (!camera.read(capturedFrame) || capturedFrame.empty()) {
+                if (++failures >= CAMERA_CAPTURE_FAILURES_MAX) {
+                    qWarning("Lost connection to camera");
+
+                    if (jpegDecoder)
+                        jpegDecoder->stop();
+
+                    {
+                        std::lock_guard<std::mutex> lock(frameMutex);
+                        captureRunning = false;
+                    }
+                    frameCondition.notify_all();
+
+                    /* Let the display find out from getImage() */
+                    notifyFrame();
+                    return;
+                }
+
+                continue;
+            }
+        }
+
+        failures = 0;
+
+        /* Keep reading while a file is shown so the camera stays current,
+         * but do not spend time converting */
+        if (!captureDecoding)
+            continue;
+
+        if (jpegDecoder) {
+            jpegDecoder->submit(capturedFrame.ptr<uint8_t>(), capturedFrame.total() * capturedFrame.elemSize());
+            continue;
+        }
+
+        {
+            TRACE_SCOPE("cvtColor");
+            rgbFrame = framePool::acquire(capturedFrame.size(), CV_8UC3);
+            cv::cvtColor(capturedFrame, rgbFrame, cv::COLOR_BGR2RGB);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            latestFrame = rgbFrame;
+            latestSequence++;
+        }
+        frameCondition.notify_all();
+
+        notifyFrame();
+    }
+}
+
+/* Only one notification is outstanding at a time, the next is sent once
+ * getImage() has taken a frame, so a slow GUI does not build up a queue */
+void opencvWorker::notifyFrame()
+{
+    if (!frameNotified.exchange(true))
+        emit frameReady();
+}
+
+/* Waits for a frame newer than the one returned last time */
+bool opencvWorker::getCameraFrame()
+{
+    frameNotified = false;
+
+    if (jpegDecoder)
+        return jpegDecoder->getFrame(picture);
+
+    std::unique_lock<std::mutex> lock(frameMutex);
+
+    frameCondition.wait(lock, [this] { return !captureRunning || latestSequence > returnedSequence; });
+
+    if (latestSequence <= returnedSequence)
+        return false;
+
+    picture = latestFrame;
+    returnedSequence = latestSequence;
+
+    return true;
+}
+
+/* True when getImage() would not wait for the camera, because there is a
+ * newer frame or the capture has stopped. A notification for a frame that
+ * was already taken is answered with false, and notifications start again */
+bool opencvWorker::newFrameAvailable()
+{
+    bool available;
+
+    if (jpegDecoder) {
+        available = jpegDecoder->frameAvailable();
+    } else {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        available = !captureRunning || latestSequence > returnedSequence;
+    }
+
+    if (!available)
+        frameNotified = false;
+
+    return available;
+}
+
+double opencvWorker::getCameraFrameRate()
+{
+    if (cameraFrameRate > 0)
+        return cameraFrameRate;
+
+    return CAMERA_DEFAULT_FRAME_RATE;
+}
+
 opencvWorker::~opencvWorker() {
+    stopCapture();
     camera.release();
-    videoFile->release();
+    videoReader->close();
 }
 
-cv::Mat* opencvWorker::getImage(unsigned int iterations)
+cv::Mat* opencvWorker::getImage()
 {
+    TRACE_SCOPE("capture");
+
     if (inputOpenCV == imageMode) {
-        /* For image file input, read image from file */
-        picture = cv::imread(imagePath.toStdString());
+        /* For image file input, use the decoded image, it is already RGB */
+        if (!loadImageFile())
+            return nullptr;
+
+        picture = imageFile;
+
+        return &picture;
     } else if (inputOpenCV == videoMode) {
         /* For video file input, grab the current frame from the video playback device */
         getVideoFileFrame();
 
         if (picture.empty()) {
-            qWarning("Video frame retrieval error");
+            if (videoLoop)
+                qWarning("Video frame retrieval error");
+
             return nullptr;
         }
-    } else {
-        /* For camera input, grab the latest frame from the camera */
-        do {
-            camera >> picture;
 
-            if (picture.empty()) {
-                qWarning("Image retrieval error");
-                return nullptr;
-            }
+        /* The video pipeline already delivers RGB */
+        return &picture;
+    }
 
-        } while (--iterations);
+    /* For camera input, take the newest frame from the capture thread, it is
+     * already RGB */
+    if (!getCameraFrame()) {
+        qWarning("Image retrieval error");
+        return nullptr;
     }
-    cv::cvtColor(picture, picture, cv::COLOR_BGR2RGB);
 
     return &picture;
 }
 
+/* Returns the frame from the last getImage() call at the model input size,
+ * when the video pipeline provides one */
+cv::Mat* opencvWorker::getModelImage()
+{
+    if (inputOpenCV != videoMode || modelPicture.empty())
+        return nullptr;
+
+    return &modelPicture;
+}
+
+/* Model input size used by the next useVideoMode() call, so that the video
+ * pipeline also scales frames for the model. An empty size disables it */
+void opencvWorker::setModelInputSize(cv::Size inputSize)
+{
+    modelInputSize = inputSize;
+}
+
 void opencvWorker::getVideoFileFrame()
 {
-    if (videoFile == 0)
+    if (!videoReader->isOpened()) {
+        picture.release();
         return;
+    }
 
-    int prevFramePos = videoFile->get(cv::CAP_PROP_POS_FRAMES);
+    if (videoReader->read(picture, modelPicture))
+        return;
 
-    *videoFile >> picture;
+    /* Looping is normally handled inside the pipeline, so the end is only
+     * reached here when looping is disabled or the file cannot be seeked */
+    if (!videoLoop) {
+        picture.release();
+        modelPicture.release();
+        return;
+    }
+
+    qWarning("Reached end of video, restarted playback");
 
-    /* Set the position of the video back to the start when it reaches the end */
-    if (videoFile->get(cv::CAP_PROP_POS_FRAMES) == prevFramePos) {
-        qWarning("Reached end of video, restarted playback");
-        videoFile->release();
-        useVideoMode(videoLoadedPath);
-        *videoFile >> picture;
+    if (!videoReader->rewind() || !videoReader->read(picture, modelPicture)) {
+        picture.release();
+        modelPicture.release();
     }
 }
 
@@ -243,45 +491,103 @@ void opencvWorker::useImageMode(QString imageFilePath)
 {
     checkVideoFile();
     inputOpenCV = imageMode;
+    captureDecoding = false;
     imagePath = imageFilePath;
+
+    resultCache::prepareMediaKey(imagePath);
 }
 
 void opencvWorker::useCameraMode()
 {
     checkVideoFile();
     inputOpenCV = cameraMode;
+    captureDecoding = true;
+
+    /* Only show frames captured from now on */
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        returnedSequence = latestSequence;
+    }
+    frameNotified = false;
+}
+
+/* The image is only decoded again when a different file is selected or the
+ * file changes. Large JPEG files are decoded at a reduced size, scaled in
+ * the DCT by libjpeg, as long as the result still covers the display */
+bool opencvWorker::loadImageFile()
+{
+    TRACE_SCOPE("imageDecode");
+    QFileInfo imageFileInfo(imagePath);
+    QString imageKey = imageFileInfo.absoluteFilePath() + "@" +
+            QString::number(imageFileInfo.lastModified().toMSecsSinceEpoch());
+    QSize imageDims;
+    int readFlags = cv::IMREAD_COLOR;
+
+    if (imageKey == imageFileKey && !imageFile.empty())
+        return true;
+
+    /* Only the header is read to get the dimensions */
+    imageDims = QImageReader(imagePath).size();
+
+    if (imageDims.isValid()) {
+        float reduction = std::max(float(imageDims.width()) / GRAPHICS_VIEW_WIDTH,
+                                   float(imageDims.height()) / GRAPHICS_VIEW_HEIGHT);
+
+        if (reduction >= 8)
+            readFlags = cv::IMREAD_REDUCED_COLOR_8;
+        else if (reduction >= 4)
+            readFlags = cv::IMREAD_REDUCED_COLOR_4;
+        else if (reduction >= 2)
+            readFlags = cv::IMREAD_REDUCED_COLOR_2;
+    }
+
+    imageFile = cv::imread(imagePath.toStdString(), readFlags);
+    imageFileKey.clear();
+
+    if (imageFile.empty()) {
+        qWarning("Image retrieval error");
+        return false;
+    }
+
+    cv::cvtColor(imageFile, imageFile, cv::COLOR_BGR2RGB);
+    imageFileKey = imageKey;
+
+    return true;
 }
 
 bool opencvWorker::useVideoMode(QString videoFilePath)
 {
-    QString videoDecodePipeline;
+    bool opened;
 
     checkVideoFile();
     inputOpenCV = videoMode;
+    captureDecoding = false;
     videoLoadedPath = videoFilePath;
 
     if (!setVideoDims()) {
         videoLoadedPath = "";
-        videoFile = 0;
 
         return false;
     }
 
-    /* Check which decoding pipeline to use */
-    if (videoCodecs)
-        videoDecodePipeline = GST_CODEC_PIPELINE;
-    else
-        videoDecodePipeline = GST_NO_CODEC_PIPELINE;
+    resultCache::prepareMediaKey(videoLoadedPath);
 
-    QString videoPipeline = "filesrc location=" + QString(videoLoadedPath) + QString(videoDecodePipeline) +
-            " video/x-raw, format=BGR, width=" + QString::number(videoWidth) + ", height=" + QString::number(videoHeight) + " ! appsink";
+    videoReader->setLooping(videoLoop);
 
-    videoFile = new cv::VideoCapture(videoPipeline.toStdString(), cv::CAP_GSTREAMER);
+    /* Real time playback only keeps the newest frame, otherwise a couple of
+     * frames are decoded ahead */
+    videoReader->setRealTime(videoRealTime);
+    videoReader->setQueueLimit(videoRealTime ? 1 : GST_READER_DEFAULT_MAX_BUFFERS, false);
+
+    /* Hardware decode and scaling is used when the board has video codecs.
+     * The pipeline starts its streaming threads here, on the capture cores */
+    {
+        threadRoleScope captureCores(captureRole);
+        opened = videoReader->open(videoLoadedPath, videoCodecs, cv::Size(videoWidth, videoHeight), modelInputSize);
+    }
 
-    if (!videoFile->isOpened()) {
+    if (!opened) {
         qWarning("Could not open video file for streaming");
-        videoFile->release();
-        videoFile = 0;
         emit resolutionError(STREAM_OPEN_ERR);
 
         return false;
@@ -290,38 +596,110 @@ bool opencvWorker::useVideoMode(QString videoFilePath)
     return true;
 }
 
+/* Video files restart when they reach the end unless looping is disabled,
+ * in which case getImage() returns nullptr at the end of the file */
+void opencvWorker::setVideoLoop(bool loop)
+{
+    videoLoop = loop;
+}
+
+/* Play video files at their own frame rate, dropping the frames that are
+ * not collected in time, rather than as fast as they are read. Takes effect
+ * on the next useVideoMode() call */
+void opencvWorker::setVideoRealTime(bool realTime)
+{
+    videoRealTime = realTime;
+}
+
+unsigned long opencvWorker::getDroppedFrames()
+{
+    return videoReader->getDroppedFrames();
+}
+
+/* Identifies the frame returned by the last getImage() call for the result
+ * cache: the media file contents and, for videos, the frame timestamp.
+ * Camera frames are never the same twice, so they have no key */
+QString opencvWorker::getFrameKey()
+{
+    QString mediaKey;
+    GstClockTime frameTime;
+
+    if (inputOpenCV == imageMode)
+        mediaKey = resultCache::mediaKey(imagePath);
+    else if (inputOpenCV == videoMode)
+        mediaKey = resultCache::mediaKey(videoLoadedPath);
+
+    if (mediaKey.isEmpty())
+        return QString();
+
+    if (inputOpenCV == imageMode)
+        return mediaKey;
+
+    frameTime = videoReader->getFrameTime();
+
+    if (!GST_CLOCK_TIME_IS_VALID(frameTime))
+        return QString();
+
+    return mediaKey + "@" + QString::number(frameTime);
+}
+
 void opencvWorker::checkVideoFile()
 {
-    /* Close video file capture device */
-    if (inputOpenCV == videoMode && videoFile)
-        videoFile->release();
+    /* Close video file pipeline */
+    if (inputOpenCV == videoMode) {
+        /* The frames wrap the pipeline's buffers, drop them before those
+         * are released */
+        picture.release();
+        modelPicture.release();
+        videoReader->close();
+    }
+}
+
+/* Opening a second capture device to read the dimensions is slow, so the
+ * result is kept for each file and only probed again if the file changes */
+QSize opencvWorker::probeVideoDims(QString videoFilePath)
+{
+    static QHash<QString, QSize> probedDims;
+    QFileInfo videoFileInfo(videoFilePath);
+    QString probeKey = videoFileInfo.absoluteFilePath() + "@" +
+            QString::number(videoFileInfo.lastModified().toMSecsSinceEpoch());
+
+    if (probedDims.contains(probeKey))
+        return probedDims.value(probeKey);
+
+    cv::VideoCapture videoChecker(videoFilePath.toStdString());
+
+    if (!videoChecker.isOpened())
+        return QSize();
+
+    QSize videoFileDims(videoChecker.get(cv::CAP_PROP_FRAME_WIDTH), videoChecker.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    videoChecker.release();
+    probedDims.insert(probeKey, videoFileDims);
+
+    return videoFileDims;
 }
 
 bool opencvWorker::setVideoDims()
 {
-    cv::VideoCapture *videoChecker = new cv::VideoCapture(videoLoadedPath.toStdString());
+    QSize videoFileDims = probeVideoDims(videoLoadedPath);
 
-    if (!videoChecker->isOpened()) {
+    if (!videoFileDims.isValid()) {
         qWarning("Could not open video file for dimension reading");
         emit resolutionError(FILE_OPEN_ERR);
 
         return false;
     }
 
-    double videoFileHeight = videoChecker->get(cv::CAP_PROP_FRAME_HEIGHT);
-    double videoFileWidth = videoChecker->get(cv::CAP_PROP_FRAME_WIDTH);
-
-    videoChecker->release();
-
-    if (videoFileHeight == 0 || videoFileWidth == 0) {
+    if (videoFileDims.isEmpty()) {
         qWarning("File resolution error.");
         emit resolutionError(RESOLUTION_ERR);
 
         return false;
     }
 
-    videoHeight = videoFileHeight;
-    videoWidth = videoFileWidth;
+    videoHeight = videoFileDims.height();
+    videoWidth = videoFileDims.width();
 
     /* Scale down the image without changing aspect ratio to ensure it fits on the GUI */
     while (videoHeight > GRAPHICS_VIEW_HEIGHT || videoWidth > GRAPHICS_VIEW_WIDTH) {
@@ -19,14 +19,24 @@
 #ifndef OPENCVCAPTUREWORKER_H
 #define OPENCVCAPTUREWORKER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 
 #include "edge-utils.h"
+#include "gstvideoreader.h"
+#include "mjpegdecoder.h"
 
 #include <string.h>
 
+#include <QHash>
 #include <QObject>
+#include <QSize>
 
 Q_DECLARE_METATYPE(cv::Mat)
 
@@ -35,18 +45,27 @@ class opencvWorker : public QObject
     Q_OBJECT
 
 public:
-    opencvWorker(QString cameraLocation, Board board);
+    opencvWorker(QString cameraLocation, Board board, CameraFormat format = uyvyCapture);
     ~opencvWorker();
-    cv::Mat* getImage(unsigned int iterations);
+    cv::Mat* getImage();
+    bool newFrameAvailable();
+    double getCameraFrameRate();
+    cv::Mat* getModelImage();
+    void setModelInputSize(cv::Size inputSize);
     bool cameraInit();
     bool getCameraOpen();
     bool getUsingMipi();
     void useCameraMode();
     void useImageMode(QString imageFilePath);
     bool useVideoMode(QString videoFilePath);
+    void setVideoLoop(bool loop);
+    void setVideoRealTime(bool realTime);
+    unsigned long getDroppedFrames();
+    QString getFrameKey();
 
 signals:
     void resolutionError(QString message);
+    void frameReady();
 
 private slots:
     void getVideoFileFrame();
@@ -56,24 +75,48 @@ private:
     void setupCamera();
     void connectCamera();
     void checkCamera();
+    void startCapture();
+    void stopCapture();
+    void captureLoop();
+    void notifyFrame();
+    bool getCameraFrame();
     void checkVideoFile();
     bool setVideoDims();
+    QSize probeVideoDims(QString videoFilePath);
+    bool loadImageFile();
 
     std::unique_ptr<cv::VideoCapture> videoCapture;
     bool webcamInitialised;
     bool webcamOpened;
     bool usingMipi;
     bool videoCodecs;
+    bool videoLoop;
+    bool videoRealTime;
     int videoHeight;
     int videoWidth;
     int connectionAttempts;
     QString imagePath;
+    QString imageFileKey;
     QString videoLoadedPath;
     std::string webcamName;
     cv::Mat picture;
+    cv::Mat modelPicture;
+    cv::Size modelInputSize;
     cv::VideoCapture camera;
+    CameraFormat cameraFormat;
+    std::unique_ptr<mjpegDecoder> jpegDecoder;
+    std::thread captureThread;
+    std::atomic<bool> captureRunning;
+    std::atomic<bool> captureDecoding;
+    std::atomic<bool> frameNotified;
+    std::mutex frameMutex;
+    std::condition_variable frameCondition;
+    cv::Mat latestFrame;
+    uint64_t latestSequence;
+    uint64_t returnedSequence;
+    double cameraFrameRate;
     cv::Mat imageFile;
-    cv::VideoCapture *videoFile;
+    std::unique_ptr<gstVideoReader> videoReader;
     std::string cameraInitialization;
     Input inputOpenCV;
 };
@@ -0,0 +1,263 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "pipelinetrace.h"
+
+/* Oldest events are overwritten once a thread has recorded this many */
+#define TRACE_EVENTS_PER_THREAD 65536
+
+/* The fields are atomic as writeTrace() copies them while the owning thread
+ * may be overwriting them, see traceThreadBufferCopy() */
+struct traceEvent {
+    std::atomic<const char*> name;
+    std::atomic<int64_t> startTime;
+    std::atomic<int64_t> duration;
+};
+
+struct traceThreadBuffer {
+    long threadId;
+    QString threadName;
+    std::unique_ptr<traceEvent[]> events;
+    std::atomic<uint64_t> written;
+};
+
+struct traceEventCopy {
+    const char *name;
+    int64_t startTime;
+    int64_t duration;
+};
+
+std::atomic<bool> pipelineTrace::enabled(false);
+
+static QString traceFilePath;
+static std::mutex traceThreadsMutex;
+static std::mutex traceWriteMutex;
+static std::vector<std::unique_ptr<traceThreadBuffer>> traceThreads;
+static thread_local traceThreadBuffer *traceCurrentThread = nullptr;
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+static int traceSignalPipe[2] = { -1, -1 };
+
+/* The buffer is allocated the first time a thread records an event, the
+ * registration is the only point where a lock is taken */
+static traceThreadBuffer *traceThreadBufferGet()
+{
+    if (traceCurrentThread == nullptr) {
+        std::unique_ptr<traceThreadBuffer> buffer(new traceThreadBuffer());
+
+        buffer->threadId = syscall(SYS_gettid);
+        buffer->events.reset(new traceEvent[TRACE_EVENTS_PER_THREAD]);
+        buffer->written.store(0, std::memory_order_relaxed);
+
+        traceCurrentThread = buffer.get();
+
+        std::lock_guard<std::mutex> lock(traceThreadsMutex);
+        traceThreads.push_back(std::move(buffer));
+    }
+
+    return traceCurrentThread;
+}
+
+/* Copy the events of a ring buffer while its thread keeps recording. The
+ * count is read again after the copy, and any event the thread may have
+ * overwritten meanwhile, including the one it may be writing, is left out */
+static std::vector<traceEventCopy> traceThreadBufferCopy(const traceThreadBuffer &buffer)
+{
+    std::vector<traceEventCopy> events;
+    uint64_t written = buffer.written.load(std::memory_order_acquire);
+    uint64_t first = 0;
+    uint64_t rewritten;
+
+    if (written > TRACE_EVENTS_PER_THREAD)
+        first = written - TRACE_EVENTS_PER_THREAD;
+
+    for (uint64_t i = first; i < written; i++) {
+        const traceEvent &event = buffer.events[i % TRACE_EVENTS_PER_THREAD];
+
+        events.push_back({ event.name.load(std::memory_order_relaxed),
+                           event.startTime.load(std::memory_order_relaxed),
+                           event.duration.load(std::memory_order_relaxed) });
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    rewritten = buffer.written.load(std::memory_order_relaxed);
+
+    if (rewritten + 1 > first + TRACE_EVENTS_PER_THREAD)
+        events.erase(events.begin(), events.begin() +
+                     std::min<uint64_t>(events.size(), rewritten + 1 - TRACE_EVENTS_PER_THREAD - first));
+
+    return events;
+}
+
+static void traceWriteAtExit()
+{
+    pipelineTrace::writeTrace();
+}
+
+/* Enable tracing, the trace is written to filePath on writeTrace(), whenever
+ * the process receives SIGUSR1 and when it exits, whichever mode it ran */
+void pipelineTrace::enable(QString filePath)
+{
+    struct sigaction action = {};
+
+    traceFilePath = filePath;
+    enabled.store(true, std::memory_order_relaxed);
+    setThreadName("gui");
+    std::atexit(traceWriteAtExit);
+
+    /* The signal handler only writes a byte to the pipe, the trace itself is
+     * written by a thread waiting on the other end */
+    if (pipe2(traceSignalPipe, O_CLOEXEC) != 0) {
+        qWarning("Warning: Cannot create trace signal pipe, SIGUSR1 dumps disabled");
+        return;
+    }
+
+    std::thread([]() {
+        char signalByte;
+
+        while (read(traceSignalPipe[0], &signalByte, sizeof(signalByte)) > 0)
+            writeTrace();
+    }).detach();
+
+    action.sa_handler = handleDumpSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+void pipelineTrace::handleDumpSignal(int)
+{
+    char signalByte = 1;
+
+    if (write(traceSignalPipe[1], &signalByte, sizeof(signalByte)) < 0)
+        return;
+}
+
+void pipelineTrace::setThreadName(const char *name)
+{
+    traceThreadBuffer *buffer;
+
+    if (!isEnabled())
+        return;
+
+    buffer = traceThreadBufferGet();
+
+    /* writeTrace() reads the names under the same lock */
+    std::lock_guard<std::mutex> lock(traceThreadsMutex);
+    buffer->threadName = name;
+}
+
+void pipelineTrace::record(const char *name, int64_t startTime, int64_t endTime)
+{
+    traceThreadBuffer *buffer = traceThreadBufferGet();
+    uint64_t written = buffer->written.load(std::memory_order_relaxed);
+    traceEvent &event = buffer->events[written % TRACE_EVENTS_PER_THREAD];
+
+    /* A copy that sees any part of this event also sees the count of the
+     * events before it, so it knows the slot may be half written */
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event.name.store(name, std::memory_order_relaxed);
+    event.startTime.store(startTime, std::memory_order_relaxed);
+    event.duration.store(endTime - startTime, std::memory_order_relaxed);
+
+    buffer->written.store(written + 1, std::memory_order_release);
+}
+
+/* Microseconds since the application started */
+int64_t pipelineTrace::timestamp()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+/* Write the events of every thread in the Chrome trace event format, which
+ * can be opened in chrome://tracing or ui.perfetto.dev. Threads keep recording
+ * while this runs, so events that wrap around during the copy are left out */
+bool pipelineTrace::writeTrace()
+{
+    QJsonArray traceEvents;
+    QJsonObject trace;
+    QFile traceFile(traceFilePath);
+    qint64 processId = QCoreApplication::applicationPid();
+
+    if (!isEnabled())
+        return false;
+
+    std::lock_guard<std::mutex> writeLock(traceWriteMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(traceThreadsMutex);
+
+        for (const std::unique_ptr<traceThreadBuffer> &buffer : traceThreads) {
+            if (!buffer->threadName.isEmpty()) {
+                QJsonObject threadName;
+
+                threadName["name"] = "thread_name";
+                threadName["ph"] = "M";
+                threadName["pid"] = processId;
+                threadName["tid"] = qint64(buffer->threadId);
+                threadName["args"] = QJsonObject { { "name", buffer->threadName } };
+                traceEvents.append(threadName);
+            }
+
+            for (const traceEventCopy &event : traceThreadBufferCopy(*buffer)) {
+                QJsonObject traceEntry;
+
+                traceEntry["name"] = event.name;
+                traceEntry["ph"] = "X";
+                traceEntry["ts"] = qint64(event.startTime);
+                traceEntry["dur"] = qint64(event.duration);
+                traceEntry["pid"] = processId;
+                traceEntry["tid"] = qint64(buffer->threadId);
+                traceEvents.append(traceEntry);
+            }
+        }
+    }
+
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Warning: Cannot open trace file %s", qPrintable(traceFilePath));
+        return false;
+    }
+
+    traceFile.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    qInfo("Pipeline trace written to %s", qPrintable(traceFilePath));
+
+    return true;
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef PIPELINETRACE_H
+#define PIPELINETRACE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <QString>
+
+/* Records the duration of a named pipeline stage from construction to the
+ * end of the enclosing scope. The name must be a string literal */
+#define TRACE_SCOPE_NAME(line) traceScopeLine ## line
+#define TRACE_SCOPE_EXPAND(line) TRACE_SCOPE_NAME(line)
+#define TRACE_SCOPE(name) traceScope TRACE_SCOPE_EXPAND(__LINE__)(name)
+
+/* Scoped begin/end events are stored in a fixed size ring buffer owned by the
+ * recording thread, so recording never takes a lock. Tracing is compiled in
+ * but disabled until enable() is called, at which point a disabled trace
+ * point costs a single relaxed atomic load */
+class pipelineTrace
+{
+public:
+    static void enable(QString filePath);
+    static bool writeTrace();
+    static void setThreadName(const char *name);
+    static void record(const char *name, int64_t startTime, int64_t endTime);
+    static int64_t timestamp();
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+private:
+    static void handleDumpSignal(int signal);
+
+    static std::atomic<bool> enabled;
+};
+
+class traceScope
+{
+public:
+    explicit traceScope(const char *name) : eventName(name), startTime(-1) {
+        if (pipelineTrace::isEnabled())
+            startTime = pipelineTrace::timestamp();
+    }
+
+    ~traceScope() {
+        if (startTime >= 0)
+            pipelineTrace::record(eventName, startTime, pipelineTrace::timestamp());
+    }
+
+private:
+    const char *eventName;
+    int64_t startTime;
+};
+
+#endif // PIPELINETRACE_H
@@ -17,21 +17,16 @@
  *****************************************************************************************/
 
 #include "poseestimation.h"
+#include "pipelinetrace.h"
+#include "postprocess.h"
 #include "ui_mainwindow.h"
 
-#include <QEventLoop>
 #include <QGraphicsScene>
 #include <QGraphicsTextItem>
 
 #define BLAZE_POSE_INPUT_SIZE 256.0
 #define HAND_POSE_INPUT_SIZE 224.0
 
-#define HAND_POSE_CONFIDENCE_INDEX 63
-
-#define POSE_DETECT_THRESHOLD 0.3
-
-#define IDENTIFIER_HAND_POSE "hand_landmark"
-
 enum MoveNetPoints { NOSE, LEFT_EYE, RIGHT_EYE, LEFT_EAR, RIGHT_EAR, LEFT_SHOULDER, RIGHT_SHOULDER,
                      LEFT_ELBOW, RIGHT_ELBOW, LEFT_WRIST, RIGHT_WRIST, LEFT_HIP, RIGHT_HIP, LEFT_KNEE,
                      RIGHT_KNEE, LEFT_ANKLE, RIGHT_ANKLE};
@@ -54,22 +49,13 @@ enum HandPosePoints { HP_WRIST, HP_THUMB_CMC, HP_THUMB_MCP, HP_THUMB_IP, HP_THUM
 #define PEN_WIDTH_HAND_POSE 3
 
 poseEstimation::poseEstimation(Ui::MainWindow *ui, QString modelPath, QString inferenceEngine, bool cameraConnect)
+    : modeController(ui, cameraConnect)
 {
     QString modelName;
 
     uiPE = ui;
-    inputModePE = cameraMode;
-    buttonState = true;
-    camConnect = cameraConnect;
-
-    utilPE = new edgeUtils();
 
-    if (modelPath.contains(IDENTIFIER_MOVE_NET))
-        poseModelSet = MoveNet;
-    else if (modelPath.contains(IDENTIFIER_HAND_POSE))
-        poseModelSet = HandPose;
-    else
-        poseModelSet = BlazePose;
+    poseModelSet = postProcess::getPoseModel(modelPath);
 
     modelName = modelPath.section('/', -1);
     frameHeight = GRAPHICS_VIEW_HEIGHT;
@@ -95,91 +81,13 @@ poseEstimation::poseEstimation(Ui::MainWindow *ui, QString modelPath, QString in
 
     QGraphicsScene *scenePointProjection = new QGraphicsScene(this);
     uiPE->graphicsViewPointProjection->setScene(scenePointProjection);
-}
-
-void poseEstimation::setButtonState(bool enable)
-{
-    buttonState = enable;
 
-    if (buttonState) {
-        uiPE->pushButtonStartStopPose->setText("Start\nInference");
-        uiPE->pushButtonStartStopPose->setStyleSheet(BUTTON_BLUE);
-    } else {
-        uiPE->pushButtonStartStopPose->setText("Stop\nInference");
-        uiPE->pushButtonStartStopPose->setStyleSheet(BUTTON_RED);
-    }
-
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
-}
-
-QVector<float> poseEstimation::sortTensorMoveNet(const QVector<float> receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-
-    float nanValue = std::nanf("NAN");
-
-    for(int i = 0; i < receivedStride; i += 3) {
-        float confidenceLevel = receivedTensor.at(i + 2);
-
-        if (confidenceLevel > POSE_DETECT_THRESHOLD && confidenceLevel <= 1.0) {
-            sortedTensor.push_back(receivedTensor.at(i));     // y-coordinate
-            sortedTensor.push_back(receivedTensor.at(i + 1)); // x-coordinate
-            sortedTensor.push_back(receivedTensor.at(i + 2)); // confidence
-        } else {
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-        }
-     }
-
-    return sortedTensor;
-}
-QVector<float> poseEstimation::sortTensorBlazePose(const QVector<float> receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-
-    float nanValue = std::nanf("NAN");
-
-    for(int i = 0; i < receivedStride; i += 5) {
-        float confidenceLevel = edgeUtils::calculateSigmoid(receivedTensor.at(i + 4));
-
-        if (confidenceLevel > 0.5 && confidenceLevel <= 1.0) {
-            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
-            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
-            sortedTensor.push_back(confidenceLevel);          // presence confidence
-        } else {
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-        }
-     }
-
-    return sortedTensor;
-}
-
-QVector<float> poseEstimation::sortTensorHandPose(const QVector<float> receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-
-    float nanValue = std::nanf("NAN");
-    float confidenceValue = receivedTensor.at(HAND_POSE_CONFIDENCE_INDEX);
-
-    for(int i = 0; i < receivedStride; i += 3) {
-
-        if (confidenceValue > 0.5 && confidenceValue <= 1.0) {
-            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
-            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
-        } else {
-            sortedTensor.push_back(nanValue);
-            sortedTensor.push_back(nanValue);
-        }
-     }
-
-    return sortedTensor;
+    setStartStopButton(uiPE->pushButtonStartStopPose, uiPE->labelTotalFpsPose);
 }
 
 void poseEstimation::drawLimbsMoveNet(const QVector<float> &outputTensor, bool updateGraphicalView)
 {
+    TRACE_SCOPE("drawLimbsMoveNet");
     QPen pen;
     xCoordinate = QVector<float>();
     yCoordinate = QVector<float>();
@@ -249,6 +157,7 @@ void poseEstimation::drawLimbsMoveNet(const QVector<float> &outputTensor, bool u
 
 void poseEstimation::drawLimbsBlazePose(const QVector<float> &outputTensor, bool updateGraphicalView)
 {
+    TRACE_SCOPE("drawLimbsBlazePose");
     QPen pen;
     xCoordinate = QVector<float>();
     yCoordinate = QVector<float>();
@@ -341,6 +250,7 @@ void poseEstimation::drawLimbsBlazePose(const QVector<float> &outputTensor, bool
 
 void poseEstimation::drawLimbsHandPose(const QVector<float> &outputTensor, bool updateGraphicalView)
 {
+    TRACE_SCOPE("drawLimbsHandPose");
     QPen pen;
     xCoordinate = QVector<float>();
     yCoordinate = QVector<float>();
@@ -445,29 +355,17 @@ void poseEstimation::connectLimbs(int limb1, int limb2, bool drawGraphicalViewLi
 
 void poseEstimation::runInference(const QVector<float> &receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat)
 {
-    float totalFps;
-
     if (poseModelSet == MoveNet)
-        outputTensor = sortTensorMoveNet(receivedTensor, receivedStride);
+        outputTensor = postProcess::sortTensorMoveNet(receivedTensor, receivedStride);
     else if (poseModelSet == HandPose)
-        outputTensor = sortTensorHandPose(receivedTensor, receivedStride);
+        outputTensor = postProcess::sortTensorHandPose(receivedTensor, receivedStride);
     else
-        outputTensor = sortTensorBlazePose(receivedTensor, receivedStride);
+        outputTensor = postProcess::sortTensorBlazePose(receivedTensor, receivedStride);
 
     uiPE->labelInferenceTimePE->setText(TEXT_INFERENCE + QString("%1 ms").arg(receivedTimeElapsed));
 
     emit sendMatToView(receivedMat);
-    if (continuousMode) {
-        /* Stop Total FPS timer and display it to GUI, then restart timer before getting the next frame */
-        utilPE->timeTotalFps(false);
-        totalFps = utilPE->calculateTotalFps();
-        uiPE->labelTotalFpsPose->setText(TEXT_TOTAL_FPS + QString::number(double(totalFps), 'f', 1));
-        utilPE->timeTotalFps(true);
-
-        emit getFrame();
-    } else {
-        setButtonState(true);
-    }
+    finishFrame();
 
     /* Draw onto image first then the graphical view */
     if (poseModelSet == MoveNet) {
@@ -482,77 +380,12 @@ void poseEstimation::runInference(const QVector<float> &receivedTensor, int rece
     }
 }
 
-void poseEstimation::stopContinuousMode()
+void poseEstimation::clearResults()
 {
-    continuousMode = false;
-
-    stopVideo();
-    setButtonState(true);
+    modeController::clearResults();
 
     uiPE->labelInferenceTimePE->setText(TEXT_INFERENCE);
-    uiPE->labelTotalFpsPose->setText(TEXT_TOTAL_FPS);
     uiPE->graphicsViewPointProjection->scene()->clear();
-
-    if (inputModePE != videoMode)
-        emit startVideo();
-}
-
-void poseEstimation::triggerInference()
-{
-    if (inputModePE == imageMode) {
-        continuousMode = false;
-
-        stopVideo();
-        setButtonState(false);
-
-        emit getFrame();
-    } else {
-        if (buttonState) {
-            continuousMode = true;
-
-            utilPE->timeTotalFps(true);
-            setButtonState(false);
-            stopVideo();
-            emit getFrame();
-        } else {
-            continuousMode = false;
-
-            setButtonState(true);
-
-            if (inputModePE == videoMode) {
-                stopVideo();
-            } else {
-                startVideo();
-                uiPE->labelInferenceTimePE->setText(TEXT_INFERENCE);
-                uiPE->labelTotalFpsPose->setText(TEXT_TOTAL_FPS);
-                uiPE->graphicsViewPointProjection->scene()->clear();
-            }
-        }
-    }
-}
-
-void poseEstimation::setCameraMode()
-{
-    inputModePE = cameraMode;
-
-    uiPE->actionLoad_Periph->setEnabled(false);
-    uiPE->actionLoad_File->setText(TEXT_LOAD_FILE);
-}
-
-void poseEstimation::setImageMode()
-{
-    inputModePE = imageMode;
-
-    uiPE->actionLoad_Periph->setEnabled(camConnect);
-    uiPE->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
-}
-
-void poseEstimation::setVideoMode()
-{
-    inputModePE = videoMode;
-
-    uiPE->actionLoad_Periph->setEnabled(camConnect);
-    uiPE->actionLoad_File->setText(TEXT_LOAD_NEW_FILE);
 }
 
 void poseEstimation::setFrameDims(int height, int width)
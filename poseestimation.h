@@ -24,59 +24,38 @@
 #include <opencv2/videoio.hpp>
 
 #include "edge-utils.h"
-
-#define IDENTIFIER_MOVE_NET "lite-model_movenet_singlepose"
-
-class edgeUtils;
+#include "modecontroller.h"
+#include "postprocess.h"
 
 namespace Ui { class MainWindow; }
 
-enum PoseModel { MoveNet, BlazePose, HandPose };
-
-class poseEstimation : public QObject
+class poseEstimation : public modeController
 {
     Q_OBJECT
 
 public:
     poseEstimation(Ui::MainWindow *ui, QString modelPath, QString inferenceEngine, bool cameraConnect);
-    void setCameraMode();
-    void setImageMode();
-    void setVideoMode();
     void setFrameDims(int height, int width);
 
 public slots:
     void runInference(const QVector<float>& receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat);
-    void stopContinuousMode();
-    void triggerInference();
 
-signals:
-    void getFrame();
-    void sendMatToView(const cv::Mat&receivedMat);
-    void startVideo();
-    void stopVideo();
+protected:
+    void clearResults() override;
 
 private:
-    void setButtonState(bool enable);
-    QVector<float> sortTensorMoveNet(const QVector<float> receivedTensor, int receivedStride);
-    QVector<float> sortTensorBlazePose(const QVector<float> receivedTensor, int receivedStride);
-    QVector<float> sortTensorHandPose(const QVector<float> receivedTensor, int receivedStride);
     void drawLimbsMoveNet(const QVector<float>& outputTensor, bool updateGraphicalView);
     void drawLimbsBlazePose(const QVector<float>& outputTensor, bool updateGraphicalView);
     void drawLimbsHandPose(const QVector<float>& outputTensor, bool updateGraphicalView);
     void connectLimbs(int limb1, int limb2, bool drawGraphicalViewLimbs);
 
     Ui::MainWindow *uiPE;
-    Input inputModePE;
     PoseModel poseModelSet;
-    edgeUtils *utilPE;
     QVector<float> outputTensor;
     QVector<float> xCoordinate;
     QVector<float> yCoordinate;
-    bool continuousMode;
-    bool buttonState;
     int frameHeight;
     int frameWidth;
-    bool camConnect;
 };
 
 #endif // POSEESTIMATION_H
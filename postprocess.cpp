@@ -0,0 +1,386 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "edge-utils.h"
+#include "pipelinetrace.h"
+#include "postprocess.h"
+
+#define FACE_DETECTION_BOX_INDEX 4
+#define FACE_DETECTION_OUTPUT_INDEX 16
+#define FACE_DETECTION_RIGHT_EYE_INDEX 4
+#define FACE_DETECTION_LEFT_EYE_INDEX 6
+#define FACE_DETECTION_NMS_THRESHOLD 0.3
+
+#define HAND_POSE_CONFIDENCE_INDEX 63
+
+#define POSE_DETECT_THRESHOLD 0.3
+
+#define ANCHOR_CENTER 0.5
+#define DETECT_BOUNDING_BOX_INCREASE 0.1 //Needed to ensure crop contains entire face
+
+/* Output layout of SSD MobileNet models: boxes, classes, scores and count.
+ * Returns box points, item ID and confidence for each item over threshold */
+QVector<float> postProcess::sortTensorSSD(QVector<float> &receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorSSD");
+    QVector<float> sortedTensor = QVector<float>();
+
+    /* The final output tensor of the model is unused in this demo mode */
+    receivedTensor.removeLast();
+
+    for(int i = receivedStride; i > 0; i--) {
+        float confidenceLevel = receivedTensor.at(receivedTensor.size() - i);
+
+        /* Only include the item if the confidence level is at threshold */
+        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= float(1.0)) {
+            /* Box points */
+            for(int j = 0; j < BOX_POINTS; j++)
+                sortedTensor.push_back(receivedTensor.at((receivedStride - i) * BOX_POINTS + j));
+
+            /* Item ID */
+            sortedTensor.push_back(receivedTensor.at(receivedTensor.size() - (receivedStride * 2) + (receivedStride - i)));
+
+            /* Confidence level */
+            sortedTensor.push_back(confidenceLevel);
+        }
+    }
+
+    return sortedTensor;
+}
+
+PoseModel postProcess::getPoseModel(QString modelPath)
+{
+    if (modelPath.contains(IDENTIFIER_MOVE_NET))
+        return MoveNet;
+    else if (modelPath.contains(IDENTIFIER_HAND_POSE))
+        return HandPose;
+
+    return BlazePose;
+}
+
+QVector<float> postProcess::sortTensorMoveNet(const QVector<float> receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorMoveNet");
+    QVector<float> sortedTensor = QVector<float>();
+
+    float nanValue = std::nanf("NAN");
+
+    for(int i = 0; i < receivedStride; i += 3) {
+        float confidenceLevel = receivedTensor.at(i + 2);
+
+        if (confidenceLevel > POSE_DETECT_THRESHOLD && confidenceLevel <= 1.0) {
+            sortedTensor.push_back(receivedTensor.at(i));     // y-coordinate
+            sortedTensor.push_back(receivedTensor.at(i + 1)); // x-coordinate
+            sortedTensor.push_back(receivedTensor.at(i + 2)); // confidence
+        } else {
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+        }
+     }
+
+    return sortedTensor;
+}
+
+QVector<float> postProcess::sortTensorBlazePose(const QVector<float> receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorBlazePose");
+    QVector<float> sortedTensor = QVector<float>();
+
+    float nanValue = std::nanf("NAN");
+
+    for(int i = 0; i < receivedStride; i += 5) {
+        float confidenceLevel = edgeUtils::calculateSigmoid(receivedTensor.at(i + 4));
+
+        if (confidenceLevel > 0.5 && confidenceLevel <= 1.0) {
+            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
+            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
+            sortedTensor.push_back(confidenceLevel);          // presence confidence
+        } else {
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+        }
+     }
+
+    return sortedTensor;
+}
+
+QVector<float> postProcess::sortTensorHandPose(const QVector<float> receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorHandPose");
+    QVector<float> sortedTensor = QVector<float>();
+
+    float nanValue = std::nanf("NAN");
+    float confidenceValue = receivedTensor.at(HAND_POSE_CONFIDENCE_INDEX);
+
+    for(int i = 0; i < receivedStride; i += 3) {
+
+        if (confidenceValue > 0.5 && confidenceValue <= 1.0) {
+            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
+            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
+        } else {
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+        }
+     }
+
+    return sortedTensor;
+}
+
+QVector<float> postProcess::sortTensorFaceLandmark(const QVector<float> receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorFaceLandmark");
+    QVector<float> sortedTensor = QVector<float>();
+    float nanValue = std::nanf("NAN");
+    float confidenceLevel = edgeUtils::calculateSigmoid(receivedTensor.at(receivedStride));
+
+    for (int i = 0; i < receivedStride; i += 3) {
+
+        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= 1.0) {
+            sortedTensor.push_back(receivedTensor.at(i));     // x-coordinate
+            sortedTensor.push_back(receivedTensor.at(i + 1)); // y-coordinate
+        } else {
+            sortedTensor.push_back(nanValue);
+            sortedTensor.push_back(nanValue);
+        }
+     }
+
+    return sortedTensor;
+}
+
+QVector<float> postProcess::sortTensorIrisLandmark(const QVector<float> receivedTensor, int receivedStride)
+{
+    TRACE_SCOPE("sortTensorIrisLandmark");
+    QVector<float> sortedTensorIris = QVector<float>();
+
+    float nanValueIris = std::nanf("NAN");
+
+    for (int i = receivedStride; i < receivedTensor.size(); i += 3) {
+        if (receivedTensor.at(i) >= 0 && receivedTensor.at(i + 1) >= 0) {
+            sortedTensorIris.push_back(receivedTensor.at(i));     // x-coordinate
+            sortedTensorIris.push_back(receivedTensor.at(i + 1)); // y-coordinate
+        } else {
+            sortedTensorIris.push_back(nanValueIris);
+            sortedTensorIris.push_back(nanValueIris);
+        }
+    }
+
+    return sortedTensorIris;
+}
+
+/* Decode the BlazeFace output for an image of the given size. Returns the top
+ * left x, y, width and height of the most confident face */
+QVector<float> postProcess::detectFace(const QVector<float> &faceDetectOutputTensor, int receivedStride,
+                                       int inputImageHeight, int inputImageWidth)
+{
+    return detectFaces(faceDetectOutputTensor, receivedStride, inputImageHeight, inputImageWidth, 1);
+}
+
+/* As above for up to maxFaces faces, four values per face, most confident
+ * first. There is always at least one box, see sortBoundingBoxes(). When
+ * faceAngles is given, it gets the roll of each face in radians, the angle
+ * of the line from the right eye to the left eye in the input image */
+QVector<float> postProcess::detectFaces(const QVector<float> &faceDetectOutputTensor, int receivedStride,
+                                        int inputImageHeight, int inputImageWidth, int maxFaces,
+                                        QVector<float> *faceAngles)
+{
+    TRACE_SCOPE("detectFace");
+    QVector<QPair<float, float>> anchorCoords;
+    QVector<float> coordinatesTensor;
+    QVector<float> confidenceTensor;
+    QVector<float> angleTensor;
+    float faceDetectScaleHeight = inputImageHeight / FACE_DETECTION_INPUT_SIZE;
+    float faceDetectScaleWidth = inputImageWidth / FACE_DETECTION_INPUT_SIZE;
+
+    anchorCoords = generateAnchorCoords(inputImageHeight, inputImageWidth);
+
+    for (int j = receivedStride; j < faceDetectOutputTensor.size(); j ++) {
+        int iteration = j - receivedStride;
+        float confidenceLevel = edgeUtils::calculateSigmoid(faceDetectOutputTensor.at(j));
+
+        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= 1.0) {
+            /* BlazeFace outputs the x and y coordinates as offsets from an anchor point, so
+             * the anchor coordinates must be added to the values */
+            float yCenter = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX) + anchorCoords.at(iteration).second;
+            float xCenter = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 1) + anchorCoords.at(iteration).first;
+            float height = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 2);
+            float width = faceDetectOutputTensor.at(iteration * FACE_DETECTION_OUTPUT_INDEX + 3);
+
+            /* Scale coordinates to the input image and provide the top left coordinates
+             * along with the height and width of the box */
+            float xTopLeft = (xCenter - 2 * width);
+            float yTopLeft = (yCenter - 2 * height);
+            float scaledWidth = width * faceDetectScaleWidth;
+            float scaledHeight = height * faceDetectScaleHeight;
+
+            coordinatesTensor.push_back(xTopLeft);
+            coordinatesTensor.push_back(yTopLeft);
+            coordinatesTensor.push_back(scaledWidth);
+            coordinatesTensor.push_back(scaledHeight);
+            confidenceTensor.push_back(confidenceLevel);
+
+            /* The eye keypoints are x, y offsets from the same anchor, so
+             * only their difference is needed */
+            if (faceAngles) {
+                int eyeIndex = iteration * FACE_DETECTION_OUTPUT_INDEX;
+                float eyeDistanceX = faceDetectOutputTensor.at(eyeIndex + FACE_DETECTION_LEFT_EYE_INDEX) -
+                                     faceDetectOutputTensor.at(eyeIndex + FACE_DETECTION_RIGHT_EYE_INDEX);
+                float eyeDistanceY = faceDetectOutputTensor.at(eyeIndex + FACE_DETECTION_LEFT_EYE_INDEX + 1) -
+                                     faceDetectOutputTensor.at(eyeIndex + FACE_DETECTION_RIGHT_EYE_INDEX + 1);
+
+                angleTensor.push_back(std::atan2(eyeDistanceY * faceDetectScaleHeight, eyeDistanceX * faceDetectScaleWidth));
+            }
+        }
+    }
+
+    return sortBoundingBoxes(confidenceTensor, coordinatesTensor, maxFaces, angleTensor, faceAngles);
+}
+
+/* Intersection over union of two boxes given as top left x, y, width and height */
+float postProcess::boxOverlap(const float *box1, const float *box2)
+{
+    float overlapWidth = std::min(box1[0] + box1[2], box2[0] + box2[2]) - std::max(box1[0], box2[0]);
+    float overlapHeight = std::min(box1[1] + box1[3], box2[1] + box2[3]) - std::max(box1[1], box2[1]);
+    float overlapArea, unionArea;
+
+    if (overlapWidth <= 0 || overlapHeight <= 0)
+        return 0;
+
+    overlapArea = overlapWidth * overlapHeight;
+    unionArea = box1[2] * box1[3] + box2[2] * box2[3] - overlapArea;
+
+    return unionArea > 0 ? overlapArea / unionArea : 0;
+}
+
+QVector<QPair<float, float>> postProcess::generateAnchorCoords(int inputHeight, int inputWidth)
+{
+    /* BlazeFace uses two Conv layers (16x16, 8x8) for anchor computation */
+    QVector<int> anchorGridDims = {16, 8};
+    QVector<int> anchorTotalPoints = {2, 6};
+    QPair<float, float> anchor;
+    QVector<QPair<float, float>> anchorList;
+
+    /* Get x and y anchor coordinates and store the points to a QVector */
+    for (int i = 0; i < anchorGridDims.size(); i++) {
+        int gridSize = anchorGridDims.at(i);
+        float strideHeight = inputHeight / gridSize;
+        float strideWidth = inputWidth / gridSize;
+        int anchorAmount = anchorTotalPoints.at(i);
+
+        for (int y = 0; y < gridSize; y++) {
+            anchor.second = strideHeight * (y + ANCHOR_CENTER);
+
+            for (int x = 0; x < gridSize; x++) {
+                anchor.first = strideWidth * (x + ANCHOR_CENTER);
+
+                for (int n = 0; n < anchorAmount; n++)
+                    anchorList.push_back(anchor);
+            }
+        }
+    }
+
+    return anchorList;
+}
+
+/* Non-maximum suppression: take the boxes in order of confidence and drop
+ * those that overlap a box already taken, as BlazeFace detects each face from
+ * several anchors */
+QVector<float> postProcess::sortBoundingBoxes(const QVector<float> receivedConfidenceTensor, const QVector<float> receivedCoordinatesTensor,
+                                              int maxFaces, const QVector<float> receivedAngleTensor, QVector<float> *faceAngles)
+{
+    TRACE_SCOPE("sortBoundingBoxes");
+    QVector<float> identifiedFaceDims;
+    QVector<int> boxOrder(receivedConfidenceTensor.size());
+
+    if (faceAngles)
+        faceAngles->clear();
+
+    for (int i = 0; i < boxOrder.size(); i++)
+        boxOrder[i] = i;
+
+    std::sort(boxOrder.begin(), boxOrder.end(), [&receivedConfidenceTensor](int box1, int box2) {
+        return receivedConfidenceTensor.at(box1) > receivedConfidenceTensor.at(box2);
+    });
+
+    foreach (int box, boxOrder) {
+        const float *boxCoordinates = receivedCoordinatesTensor.constData() + FACE_DETECTION_BOX_INDEX * box;
+        bool suppressed = false;
+
+        if (identifiedFaceDims.size() >= FACE_DETECTION_BOX_INDEX * maxFaces)
+            break;
+
+        for (int i = 0; i < identifiedFaceDims.size() && !suppressed; i += FACE_DETECTION_BOX_INDEX)
+            suppressed = boxOverlap(boxCoordinates, identifiedFaceDims.constData() + i) > FACE_DETECTION_NMS_THRESHOLD;
+
+        if (suppressed)
+            continue;
+
+        for (int i = 0; i < FACE_DETECTION_BOX_INDEX; i++)
+            identifiedFaceDims.push_back(boxCoordinates[i]);
+
+        if (faceAngles)
+            faceAngles->push_back(receivedAngleTensor.value(box));
+    }
+
+    if (identifiedFaceDims.isEmpty()) {
+        /* Set crop dimensions to Face Landmark input size when a face is not identified */
+        identifiedFaceDims.push_back(0);
+        identifiedFaceDims.push_back(0);
+        identifiedFaceDims.push_back(FACE_LANDMARK_INPUT_SIZE);
+        identifiedFaceDims.push_back(FACE_LANDMARK_INPUT_SIZE);
+
+        if (faceAngles)
+            faceAngles->push_back(0);
+    }
+
+    return identifiedFaceDims;
+}
+
+/* Returns the x, y, width and height of the region to crop for the face
+ * landmark model, clipped to the frame */
+QVector<float> postProcess::getFaceCropDims(const QVector<float> &faceDims, int frameHeight, int frameWidth)
+{
+    float heightOffset = DETECT_BOUNDING_BOX_INCREASE * frameHeight;
+    float widthOffset = DETECT_BOUNDING_BOX_INCREASE * frameWidth;
+    float faceTopLeftX, faceTopLeftY, faceWidth, faceHeight;
+
+    /* Increase the dimensions of the bounding box to ensure crop contains entire face */
+    faceTopLeftX = faceDims.at(0) - widthOffset;
+    faceTopLeftY = faceDims.at(1) - heightOffset;
+    faceWidth = faceDims.at(2) + (2 * widthOffset);
+    faceHeight = faceDims.at(3) + (2 * heightOffset);
+
+    /* Ensure that cropping coordinates are not outside of the image */
+    if (faceTopLeftX < 0)
+        faceTopLeftX = 0;
+
+    if (faceTopLeftY < 0)
+        faceTopLeftY = 0;
+
+    if ((faceWidth + faceTopLeftX) > frameWidth)
+        faceWidth = frameWidth - faceTopLeftX;
+
+    if ((faceHeight + faceTopLeftY) > frameHeight)
+        faceHeight = frameHeight - faceTopLeftY;
+
+    return { faceTopLeftX, faceTopLeftY, faceWidth, faceHeight };
+}
@@ -0,0 +1,61 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#define IDENTIFIER_MOVE_NET "lite-model_movenet_singlepose"
+#define IDENTIFIER_HAND_POSE "hand_landmark"
+
+#define FACE_DETECTION_INPUT_SIZE 128.0
+#define FACE_LANDMARK_INPUT_SIZE 192.0
+
+enum PoseModel { MoveNet, BlazePose, HandPose };
+
+/* Decoding of the raw model output tensors, kept free of any GUI state so
+ * that the demo modes and the headless runner share the same logic */
+class postProcess
+{
+public:
+    static QVector<float> sortTensorSSD(QVector<float> &receivedTensor, int receivedStride);
+    static PoseModel getPoseModel(QString modelPath);
+    static QVector<float> sortTensorMoveNet(const QVector<float> receivedTensor, int receivedStride);
+    static QVector<float> sortTensorBlazePose(const QVector<float> receivedTensor, int receivedStride);
+    static QVector<float> sortTensorHandPose(const QVector<float> receivedTensor, int receivedStride);
+    static QVector<float> sortTensorFaceLandmark(const QVector<float> receivedTensor, int receivedStride);
+    static QVector<float> sortTensorIrisLandmark(const QVector<float> receivedTensor, int receivedStride);
+    static QVector<float> detectFace(const QVector<float> &faceDetectOutputTensor, int receivedStride,
+                                     int inputImageHeight, int inputImageWidth);
+    static QVector<float> detectFaces(const QVector<float> &faceDetectOutputTensor, int receivedStride,
+                                      int inputImageHeight, int inputImageWidth, int maxFaces,
+                                      QVector<float> *faceAngles = nullptr);
+    static QVector<float> getFaceCropDims(const QVector<float> &faceDims, int frameHeight, int frameWidth);
+
+private:
+    static QVector<QPair<float, float>> generateAnchorCoords(int inputHeight, int inputWidth);
+    static QVector<float> sortBoundingBoxes(const QVector<float> receivedConfidenceTensor, const QVector<float> receivedCoordinatesTensor,
+                                            int maxFaces, const QVector<float> receivedAngleTensor = QVector<float>(),
+                                            QVector<float> *faceAngles = nullptr);
+    static float boxOverlap(const float *box1, const float *box2);
+};
+
+#endif // POSTPROCESS_H
@@ -0,0 +1,263 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QtConcurrent>
+
+#include "resultcache.h"
+
+std::atomic<bool> resultCache::enabled(false);
+
+static int cacheFd = -1;
+static const char *cacheMap = nullptr;
+static size_t cacheMapSize = 0;
+static std::mutex cacheMutex;
+static QHash<QByteArray, size_t> mappedRecords;
+static QHash<QByteArray, QPair<int, QVector<float>>> storedRecords;
+static std::mutex mediaKeysMutex;
+static QHash<QString, QString> mediaKeys;
+
+static bool writeFileHeader()
+{
+    resultCacheFileHeader fileHeader;
+
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader.magic, RESULT_CACHE_MAGIC, RESULT_CACHE_MAGIC_SIZE);
+    fileHeader.version = RESULT_CACHE_VERSION;
+
+    return ftruncate(cacheFd, 0) == 0 &&
+            write(cacheFd, &fileHeader, sizeof(fileHeader)) == ssize_t(sizeof(fileHeader));
+}
+
+bool resultCache::enable(QString filePath)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    struct stat cacheStat;
+
+    cacheFd = open(filePath.toStdString().c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+
+    if (cacheFd < 0 || fstat(cacheFd, &cacheStat) != 0) {
+        qWarning("Warning: Cannot open result cache file %s", qPrintable(filePath));
+        return false;
+    }
+
+    cacheMapSize = cacheStat.st_size;
+
+    if (cacheMapSize > 0) {
+        void *map = mmap(nullptr, cacheMapSize, PROT_READ, MAP_SHARED, cacheFd, 0);
+
+        if (map == MAP_FAILED) {
+            qWarning("Warning: Cannot map result cache file %s", qPrintable(filePath));
+            close(cacheFd);
+            cacheFd = -1;
+            return false;
+        }
+
+        cacheMap = static_cast<const char*>(map);
+    }
+
+    if (cacheMapSize == 0) {
+        if (!writeFileHeader()) {
+            qWarning("Warning: Cannot write result cache file %s", qPrintable(filePath));
+            close(cacheFd);
+            cacheFd = -1;
+            return false;
+        }
+    } else if (!indexFile()) {
+        qWarning("Warning: %s is not a result cache, starting a new one", qPrintable(filePath));
+
+        if (cacheMap)
+            munmap(const_cast<char*>(cacheMap), cacheMapSize);
+
+        cacheMap = nullptr;
+        cacheMapSize = 0;
+        mappedRecords.clear();
+
+        if (!writeFileHeader()) {
+            qWarning("Warning: Cannot write result cache file %s", qPrintable(filePath));
+            close(cacheFd);
+            cacheFd = -1;
+            return false;
+        }
+    }
+
+    enabled = true;
+
+    return true;
+}
+
+/* Index the mapped records by key. A record cut short by the application
+ * being stopped mid-write is removed so that new records follow the last
+ * complete one */
+bool resultCache::indexFile()
+{
+    const resultCacheFileHeader *fileHeader = reinterpret_cast<const resultCacheFileHeader*>(cacheMap);
+    size_t offset = sizeof(resultCacheFileHeader);
+
+    if (cacheMapSize < sizeof(resultCacheFileHeader) ||
+        memcmp(fileHeader->magic, RESULT_CACHE_MAGIC, RESULT_CACHE_MAGIC_SIZE) != 0 ||
+        fileHeader->version != RESULT_CACHE_VERSION)
+        return false;
+
+    while (offset + sizeof(resultCacheRecordHeader) <= cacheMapSize) {
+        const resultCacheRecordHeader *header = reinterpret_cast<const resultCacheRecordHeader*>(cacheMap + offset);
+        size_t recordSize = sizeof(resultCacheRecordHeader) + size_t(header->valueCount) * sizeof(float);
+
+        if (offset + recordSize > cacheMapSize)
+            break;
+
+        mappedRecords.insert(QByteArray(reinterpret_cast<const char*>(header->key), RESULT_CACHE_KEY_SIZE), offset);
+        offset += recordSize;
+    }
+
+    if (offset != cacheMapSize && ftruncate(cacheFd, offset) != 0)
+        return false;
+
+    return true;
+}
+
+bool resultCache::lookup(const QByteArray &key, QVector<float> &outputTensor, int &itemStride)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    if (mappedRecords.contains(key)) {
+        const resultCacheRecordHeader *header =
+                reinterpret_cast<const resultCacheRecordHeader*>(cacheMap + mappedRecords.value(key));
+        const float *values = reinterpret_cast<const float*>(header + 1);
+
+        outputTensor.resize(header->valueCount);
+        memcpy(outputTensor.data(), values, header->valueCount * sizeof(float));
+        itemStride = header->itemStride;
+
+        return true;
+    }
+
+    if (storedRecords.contains(key)) {
+        itemStride = storedRecords.value(key).first;
+        outputTensor = storedRecords.value(key).second;
+
+        return true;
+    }
+
+    return false;
+}
+
+/* Only the first valueCount values of the output tensor are stored, models
+ * with large outputs that no demo mode reads can leave them out */
+void resultCache::store(const QByteArray &key, const QVector<float> &outputTensor, int valueCount, int itemStride)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    resultCacheRecordHeader header;
+    struct iovec record[2];
+    size_t recordSize;
+
+    if (cacheFd < 0 || mappedRecords.contains(key) || storedRecords.contains(key))
+        return;
+
+    valueCount = qMin(valueCount, outputTensor.size());
+
+    memcpy(header.key, key.constData(), RESULT_CACHE_KEY_SIZE);
+    header.itemStride = itemStride;
+    header.valueCount = valueCount;
+
+    record[0].iov_base = &header;
+    record[0].iov_len = sizeof(header);
+    record[1].iov_base = const_cast<float*>(outputTensor.constData());
+    record[1].iov_len = valueCount * sizeof(float);
+    recordSize = record[0].iov_len + record[1].iov_len;
+
+    if (writev(cacheFd, record, 2) != ssize_t(recordSize)) {
+        qWarning("Warning: Cannot write to result cache, caching disabled");
+        enabled = false;
+        return;
+    }
+
+    storedRecords.insert(key, qMakePair(itemStride, outputTensor.mid(0, valueCount)));
+}
+
+QByteArray resultCache::makeKey(QString frameKey, QString modelName, int delegate)
+{
+    QString keyString = frameKey + "|" + modelName + "|" + QString::number(delegate);
+
+    return QCryptographicHash::hash(keyString.toUtf8(), QCryptographicHash::Sha1).left(RESULT_CACHE_KEY_SIZE);
+}
+
+static QString mediaFileKey(QString mediaFilePath)
+{
+    QFileInfo mediaFileInfo(mediaFilePath);
+
+    return mediaFileInfo.absoluteFilePath() + "@" +
+            QString::number(mediaFileInfo.lastModified().toMSecsSinceEpoch());
+}
+
+/* Start hashing the contents of a media file on a worker thread. Hashing a
+ * large video takes seconds, so it is started when the file is opened and
+ * never run on the thread asking for frames. The hash is kept for each file
+ * and only redone if the file changes */
+void resultCache::prepareMediaKey(QString mediaFilePath)
+{
+    QString fileKey = mediaFileKey(mediaFilePath);
+
+    {
+        std::lock_guard<std::mutex> lock(mediaKeysMutex);
+
+        if (mediaKeys.contains(fileKey))
+            return;
+
+        /* Empty until the hash is ready */
+        mediaKeys.insert(fileKey, QString());
+    }
+
+    QtConcurrent::run([=] {
+        QCryptographicHash mediaHash(QCryptographicHash::Sha256);
+        QFile mediaFile(mediaFilePath);
+
+        if (!mediaFile.open(QIODevice::ReadOnly) || !mediaHash.addData(&mediaFile))
+            return;
+
+        std::lock_guard<std::mutex> lock(mediaKeysMutex);
+        mediaKeys.insert(fileKey, QString(mediaHash.result().toHex()));
+    });
+}
+
+/* Identifies a media file by its contents. Empty while the hash is still
+ * being worked out, so frames read before then are not cached */
+QString resultCache::mediaKey(QString mediaFilePath)
+{
+    QString fileKey = mediaFileKey(mediaFilePath);
+
+    prepareMediaKey(mediaFilePath);
+
+    std::lock_guard<std::mutex> lock(mediaKeysMutex);
+
+    return mediaKeys.value(fileKey);
+}
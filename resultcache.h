@@ -0,0 +1,78 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/* Cache file layout, all values in native (little-endian) byte order:
+ *
+ *   File header:   char magic[8] ("RZRCACHE"), uint32 version, uint32 reserved
+ *   Record header: uint8 key[16], uint32 item stride, uint32 value count
+ *   Record data:   float values[value count]
+ *
+ * Records are only ever appended. The records already in the file are mapped
+ * read-only when the cache is enabled rather than read in, so a large cache
+ * costs no start-up time */
+#define RESULT_CACHE_MAGIC "RZRCACHE"
+#define RESULT_CACHE_MAGIC_SIZE 8
+#define RESULT_CACHE_VERSION 1
+#define RESULT_CACHE_KEY_SIZE 16
+
+struct resultCacheFileHeader {
+    char magic[RESULT_CACHE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct resultCacheRecordHeader {
+    uint8_t key[RESULT_CACHE_KEY_SIZE];
+    uint32_t itemStride;
+    uint32_t valueCount;
+};
+
+/* Memoises the output of a model for a frame of a media file, keyed by the
+ * media file contents, the frame position, the model and the delegate. Demo
+ * units that loop the same clips then only run inference on the first pass */
+class resultCache
+{
+public:
+    static bool enable(QString filePath);
+    static bool lookup(const QByteArray &key, QVector<float> &outputTensor, int &itemStride);
+    static void store(const QByteArray &key, const QVector<float> &outputTensor, int valueCount, int itemStride);
+    static QByteArray makeKey(QString frameKey, QString modelName, int delegate);
+    static void prepareMediaKey(QString mediaFilePath);
+    static QString mediaKey(QString mediaFilePath);
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+private:
+    static bool indexFile();
+
+    static std::atomic<bool> enabled;
+};
+
+#endif // RESULTCACHE_H
@@ -16,36 +16,73 @@
 # along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
 #*****************************************************************************************
 
-QT += core gui multimedia widgets
+QT += concurrent core gui multimedia widgets
 
-CONFIG += c++14
+CONFIG += c++14 link_pkgconfig
+
+PKGCONFIG += \
+    gstreamer-1.0 \
+    gstreamer-app-1.0 \
+    gstreamer-video-1.0
 
 # Ignore a lot of build warnings from Qt code
 QMAKE_CXXFLAGS += "-Wno-deprecated-copy"
 
 SOURCES += \
+    armnnoptions.cpp \
     audiocommand.cpp \
+    audiotrace.cpp \
+    autotuner.cpp \
     edge-utils.cpp \
     facedetection.cpp \
+    framepool.cpp \
+    gstvideoreader.cpp \
+    headlessrunner.cpp \
+    inferencebenchmark.cpp \
     main.cpp \
     mainwindow.cpp \
+    memorymonitor.cpp \
+    mjpegdecoder.cpp \
+    modecontroller.cpp \
     objectdetection.cpp \
     opencvworker.cpp \
+    pipelinetrace.cpp \
     poseestimation.cpp \
+    postprocess.cpp \
+    resultcache.cpp \
     shoppingbasket.cpp \
+    tflitepool.cpp \
+    tfliteprofiler.cpp \
     tfliteworker.cpp \
+    threadplacement.cpp \
     videoworker.cpp
 
 HEADERS += \
+    armnnoptions.h \
     audiocommand.h \
+    audiotrace.h \
+    autotuner.h \
     edge-utils.h \
     facedetection.h \
+    framepool.h \
+    gstvideoreader.h \
+    headlessrunner.h \
+    inferencebenchmark.h \
     mainwindow.h \
+    memorymonitor.h \
+    mjpegdecoder.h \
+    modecontroller.h \
     objectdetection.h \
     opencvworker.h \
+    pipelinetrace.h \
     poseestimation.h \
+    postprocess.h \
+    resultcache.h \
     shoppingbasket.h \
+    tflitepool.h \
+    tfliteprofiler.h \
     tfliteworker.h \
+    threadplacement.h \
     videoworker.h
 
 FORMS += \
@@ -62,6 +99,7 @@ LIBS += \
     -larmnnDelegate \
     -larmnnUtils \
     -lasound \
+    -ljpeg \
     -lopencv_core \
     -lopencv_imgproc \
     -lopencv_imgcodecs \
@@ -17,6 +17,8 @@
  *****************************************************************************************/
 
 #include "shoppingbasket.h"
+#include "pipelinetrace.h"
+#include "postprocess.h"
 #include "ui_mainwindow.h"
 
 #include <QFile>
@@ -33,15 +35,14 @@
 
 shoppingBasket::shoppingBasket(Ui::MainWindow *ui, QStringList labelFileList, QString pricesFile,
                                QString modelPath, QString inferenceEngine, bool cameraConnect)
+    : modeController(ui, cameraConnect)
 {
     QFont font;
     QString modelName;
 
     uiSB = ui;
-    inputModeSB = cameraMode;
     labelList = labelFileList;
     costs = readPricesFile(pricesFile);
-    camConnect = cameraConnect;
 
     modelName = modelPath.section('/', -1);
 
@@ -109,20 +110,21 @@ void shoppingBasket::setNextButton(bool enable)
         uiSB->pushButtonNextBasket->setEnabled(false);
     }
 
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
+    /* The frame is processed straight after, so paint now */
+    uiSB->pushButtonNextBasket->repaint();
 }
 
 void shoppingBasket::setProcessButton(bool enable)
 {
     if (enable) {
-           uiSB->pushButtonProcessBasket->setStyleSheet(BUTTON_BLUE);
-           uiSB->pushButtonProcessBasket->setEnabled(true);
-       } else {
-           uiSB->pushButtonProcessBasket->setStyleSheet(BUTTON_GREYED_OUT);
-           uiSB->pushButtonProcessBasket->setEnabled(false);
-       }
-
-       qApp->processEvents(QEventLoop::WaitForMoreEvents);
+        uiSB->pushButtonProcessBasket->setStyleSheet(BUTTON_BLUE);
+        uiSB->pushButtonProcessBasket->setEnabled(true);
+    } else {
+        uiSB->pushButtonProcessBasket->setStyleSheet(BUTTON_GREYED_OUT);
+        uiSB->pushButtonProcessBasket->setEnabled(false);
+    }
+
+    uiSB->pushButtonProcessBasket->repaint();
 }
 
 void shoppingBasket::nextBasket()
@@ -134,7 +136,7 @@ void shoppingBasket::nextBasket()
     uiSB->labelInferenceTimeSB->setText(TEXT_INFERENCE);
     uiSB->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
 
-    if (inputModeSB == imageMode)
+    if (inputMode == imageMode)
         emit getStaticImage();
     else
         emit startVideo();
@@ -142,7 +144,7 @@ void shoppingBasket::nextBasket()
 
 void shoppingBasket::processBasket()
 {
-    if (inputModeSB == cameraMode)
+    if (inputMode == cameraMode)
         emit stopVideo();
 
     setProcessButton(false);
@@ -156,40 +158,13 @@ void shoppingBasket::processBasket()
     emit getFrame();
 }
 
-QVector<float> shoppingBasket::sortTensor(QVector<float> &receivedTensor, int receivedStride)
-{
-    QVector<float> sortedTensor = QVector<float>();
-
-    /* The final output tensor of the model is unused in this demo mode */
-    receivedTensor.removeLast();
-
-    for(int i = receivedStride; i > 0; i--) {
-        float confidenceLevel = receivedTensor.at(receivedTensor.size() - i);
-
-        /* Only include the item if the confidence level is at threshold */
-        if (confidenceLevel > DETECT_DEFAULT_THRESHOLD && confidenceLevel <= float(1.0)) {
-            /* Box points */
-            for(int j = 0; j < BOX_POINTS; j++)
-                sortedTensor.push_back(receivedTensor.at((receivedStride - i) * BOX_POINTS + j));
-
-            /* Item ID */
-            sortedTensor.push_back(receivedTensor.at(receivedTensor.size() - (receivedStride * 2) + (receivedStride - i)));
-
-            /* Confidence level */
-            sortedTensor.push_back(confidenceLevel);
-        }
-    }
-
-    return sortedTensor;
-}
-
 void shoppingBasket::runInference(QVector<float> receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat &receivedMat)
 {
     QTableWidgetItem* item;
     QTableWidgetItem* price;
     QStringList *labelSet = new QStringList();
     float totalCost = 0;
-    outputTensor = sortTensor(receivedTensor, receivedStride);
+    outputTensor = postProcess::sortTensorSSD(receivedTensor, receivedStride);
 
     uiSB->tableWidget->setRowCount(0);
     labelListSorted.clear();
@@ -243,20 +218,31 @@ void shoppingBasket::runInference(QVector<float> receivedTensor, int receivedStr
     emit getBoxes(outputTensor, labelList);
 }
 
-void shoppingBasket::setImageMode(bool imageStatus)
+/* Shopping basket only takes still images besides the camera */
+void shoppingBasket::setCameraMode()
 {
-    if (imageStatus) {
-        inputModeSB = imageMode;
-        uiSB->actionLoad_File->setText(TEXT_LOAD_NEW_IMAGE);
+    inputMode = cameraMode;
 
-        emit getStaticImage();
-    } else {
-        inputModeSB = cameraMode;
-        uiSB->actionLoad_File->setText(TEXT_LOAD_IMAGE);
+    uiSB->actionLoad_Periph->setEnabled(false);
+    uiSB->actionLoad_File->setText(TEXT_LOAD_IMAGE);
 
-        emit startVideo();
-    }
-    uiSB->actionLoad_Periph->setEnabled(imageStatus && camConnect);
+    emit startVideo();
+    resetBasket();
+}
+
+void shoppingBasket::setImageMode()
+{
+    inputMode = imageMode;
+
+    uiSB->actionLoad_Periph->setEnabled(camConnect);
+    uiSB->actionLoad_File->setText(TEXT_LOAD_NEW_IMAGE);
+
+    emit getStaticImage();
+    resetBasket();
+}
+
+void shoppingBasket::resetBasket()
+{
     uiSB->labelInferenceTimeSB->setText(TEXT_INFERENCE);
     uiSB->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
     uiSB->tableWidget->setRowCount(0);
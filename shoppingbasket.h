@@ -22,6 +22,7 @@
 #include <opencv2/videoio.hpp>
 
 #include "edge-utils.h"
+#include "modecontroller.h"
 
 #define TEXT_TOTAL_ITEMS "Total Items: "
 
@@ -29,14 +30,15 @@ class QGraphicsScene;
 
 namespace Ui { class MainWindow; }
 
-class shoppingBasket  : public QObject
+class shoppingBasket : public modeController
 {
     Q_OBJECT
 
 public:
     shoppingBasket(Ui::MainWindow *ui, QStringList labelFileList, QString pricesFile,
                    QString modelPath, QString inferenceEngine, bool cameraConnect);
-    void setImageMode(bool imageStatus);
+    void setCameraMode() override;
+    void setImageMode() override;
     void updateInferenceLabel();
     void updateModelLabel();
 
@@ -44,12 +46,8 @@ public slots:
     void runInference(QVector<float> receivedTensor, int receivedStride, int receivedTimeElapsed, const cv::Mat&receivedMat);
 
 signals:
-    void getFrame();
     void getStaticImage();
     void getBoxes(const QVector<float>& receivedTensor, QStringList labelList);
-    void sendMatToView(const cv::Mat&receivedMat);
-    void startVideo();
-    void stopVideo();
 
 private slots:
     void processBasket();
@@ -59,7 +57,7 @@ private:
     void setNextButton(bool enable);
     void setProcessButton(bool enable);
     std::vector<float> readPricesFile(QString pricesPath);
-    QVector<float> sortTensor(QVector<float> &receivedTensor, int receivedStride);
+    void resetBasket();
 
     Ui::MainWindow *uiSB;
     QStringList labelListSorted;
@@ -67,8 +65,6 @@ private:
     std::vector<float> costs;
     QString currency;
     QStringList labelList;
-    Input inputModeSB;
-    bool camConnect;
 };
 
 #endif // SHOPPINGBASKET_H
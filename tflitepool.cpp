@@ -0,0 +1,270 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <QtGlobal>
+
+#include "framepool.h"
+#include "pipelinetrace.h"
+#include "threadplacement.h"
+#include "tflitepool.h"
+
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+tflitePool::tflitePool(const tflite::FlatBufferModel &model, Delegate delegateType, unsigned int laneCount,
+                       const armnnOptionSet &armnnSettings, std::string weightsCachePath,
+                       std::function<void()> resultCallback) :
+    tfliteModel(model), delegateType(delegateType), armnnSettings(armnnSettings), weightsCachePath(weightsCachePath), resultCallback(resultCallback), lanes(laneCount),
+    nextSequence(0), nextDelivery(0), generation(0), busyLanes(0), readyLanes(0), stopping(false)
+{
+    std::vector<int> inferenceCpus;
+    unsigned int cpuCount;
+    cpu_set_t inferenceCores;
+
+    /* Share out the cores of the inference role, which are all cores unless
+     * --cpu-affinity sets them */
+    threadPlacement::getCores(inferenceRole, inferenceCores);
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &inferenceCores))
+            inferenceCpus.push_back(cpu);
+    }
+
+    if (inferenceCpus.empty())
+        inferenceCpus.push_back(0);
+
+    cpuCount = inferenceCpus.size();
+
+    /* Give each lane a contiguous group of cores, so on big.LITTLE parts such
+     * as the RZ/G2M a lane only straddles both clusters when it has to. With
+     * more lanes than cores, lanes share */
+    for (unsigned int i = 0; i < laneCount; i++) {
+        unsigned int firstCpu = i * cpuCount / laneCount;
+        unsigned int endCpu = std::max((i + 1) * cpuCount / laneCount, firstCpu + 1);
+
+        for (unsigned int cpu = firstCpu; cpu < endCpu; cpu++)
+            lanes[i].cpus.push_back(inferenceCpus[cpu % cpuCount]);
+    }
+
+    for (unsigned int i = 0; i < laneCount; i++)
+        lanes[i].thread = std::thread(&tflitePool::laneLoop, this, i);
+
+    /* Building the interpreters, and for ArmNN optimising the graph, takes a
+     * while. Wait for it here so that the pool is ready once constructed */
+    std::unique_lock<std::mutex> lock(poolMutex);
+    laneReady.wait(lock, [this] { return readyLanes == lanes.size(); });
+}
+
+tflitePool::~tflitePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for (lane &poolLane : lanes) {
+        if (poolLane.thread.joinable())
+            poolLane.thread.join();
+    }
+}
+
+unsigned int tflitePool::getLaneCount()
+{
+    return lanes.size();
+}
+
+/* True when a frame submitted now would start straight away */
+bool tflitePool::hasIdleLane()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    return busyLanes + jobs.size() < lanes.size();
+}
+
+/* Queue a frame for the next free lane. The input must already be at the
+ * model input size and type, it is copied */
+void tflitePool::submit(const cv::Mat &inputMat, frameResult frame)
+{
+    frame.inputMat = framePool::copy(inputMat);
+    frame.outputTensor.clear();
+    frame.outputTensorCount.clear();
+    frame.invoked = false;
+    frame.itemStride = -1;
+    frame.timeElapsed = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+
+        frame.sequence = nextSequence++;
+        frame.generation = generation;
+        jobs.push_back(std::move(frame));
+    }
+    jobReady.notify_one();
+}
+
+/* Add a frame whose results are already known, such as from the result
+ * cache, so that it is still handed back in order */
+void tflitePool::complete(frameResult frame)
+{
+    frame.invoked = true;
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+
+        frame.sequence = nextSequence++;
+        frame.generation = generation;
+        completed[frame.sequence] = std::move(frame);
+    }
+
+    resultCallback();
+}
+
+/* Takes the results of the oldest frame not yet handed back, if they are
+ * ready. Frames that finish early wait here for the ones before them */
+bool tflitePool::takeResult(frameResult &result)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::map<uint64_t, frameResult>::iterator oldest = completed.begin();
+
+    if (oldest == completed.end() || oldest->first != nextDelivery)
+        return false;
+
+    result = std::move(oldest->second);
+    completed.erase(oldest);
+    nextDelivery++;
+
+    return true;
+}
+
+/* Drop the queued frames and the results of all frames submitted so far,
+ * used when inference is stopped. Frames already running finish, but their
+ * results are not handed back */
+void tflitePool::discardPending()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    generation++;
+    jobs.clear();
+    completed.clear();
+    nextDelivery = nextSequence;
+}
+
+void tflitePool::laneLoop(unsigned int laneIndex)
+{
+    pipelineTrace::setThreadName("inference");
+    std::unique_ptr<tflite::Interpreter> interpreter;
+    TfLiteDelegate *xnnpackDelegate = nullptr;
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+
+    for (int cpu : lanes[laneIndex].cpus)
+        CPU_SET(cpu, &cpuSet);
+
+    /* Pin before the interpreter is built, so the threads it starts are
+     * pinned to the same cores */
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        qWarning("Warning: Could not set the CPU affinity of inference lane %u", laneIndex);
+
+    /* The worker has already built an interpreter for the model, so the
+     * weights cache is warm and every lane maps the same packed weights
+     * rather than holding its own copy */
+    interpreter = tfliteWorker::buildInterpreter(tfliteModel, delegateType, int(lanes[laneIndex].cpus.size()),
+                                                 armnnSettings, weightsCachePath, &xnnpackDelegate);
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        readyLanes++;
+    }
+    laneReady.notify_all();
+
+    /* Warm the lane up once the pool is ready, frames wait in the queue
+     * until it is done */
+    if (tfliteWorker::getWarmupInvokes() > 0) {
+        std::chrono::microseconds coldTime, warmTime;
+
+        tfliteWorker::warmUp(interpreter.get(), tfliteWorker::getWarmupInvokes(), coldTime, warmTime);
+    }
+
+    while (true) {
+        std::chrono::steady_clock::time_point startTime, stopTime;
+        TfLiteTensor *inputTensor;
+        frameResult frame;
+
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping)
+                break;
+
+            frame = std::move(jobs.front());
+            jobs.pop_front();
+            busyLanes++;
+        }
+
+        inputTensor = interpreter->tensor(interpreter->inputs()[0]);
+
+        if (frame.inputMat.total() * frame.inputMat.elemSize() == inputTensor->bytes) {
+            memcpy(inputTensor->data.raw, frame.inputMat.data, inputTensor->bytes);
+
+            startTime = std::chrono::steady_clock::now();
+
+            {
+                TRACE_SCOPE("invoke");
+                frame.invoked = interpreter->Invoke() == kTfLiteOk;
+            }
+
+            stopTime = std::chrono::steady_clock::now();
+        }
+
+        if (frame.invoked) {
+            tfliteWorker::readOutputs(interpreter.get(), frame.outputTensor, frame.outputTensorCount);
+            frame.timeElapsed = int(std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count());
+        }
+
+        frame.inputMat.release();
+
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+
+            busyLanes--;
+
+            /* Inference was stopped while this frame was running */
+            if (frame.generation != generation)
+                continue;
+
+            completed[frame.sequence] = std::move(frame);
+        }
+
+        resultCallback();
+    }
+
+    interpreter.reset();
+
+    if (xnnpackDelegate != nullptr)
+        TfLiteXNNPackDelegateDelete(xnnpackDelegate);
+}
@@ -0,0 +1,101 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef TFLITEPOOL_H
+#define TFLITEPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tensorflow/lite/interpreter.h>
+#include <tensorflow/lite/model.h>
+
+#include <QString>
+#include <QVector>
+
+#include <opencv2/core.hpp>
+
+#include "tfliteworker.h"
+
+/* Runs consecutive frames on several interpreters of the same model at once,
+ * each on its own thread pinned to its own share of the CPU cores. Small
+ * models scale poorly with intra-op threads, so this trades a few frames of
+ * latency for throughput that scales with the core count. Results are handed
+ * back in frame order through a reorder buffer */
+class tflitePool
+{
+public:
+    struct frameResult {
+        uint64_t sequence;
+        uint64_t generation;
+        bool invoked;
+        cv::Mat inputMat;
+        cv::Mat displayMat;
+        QString frameKey;
+        QVector<float> outputTensor;
+        QVector<int> outputTensorCount;
+        int itemStride;
+        int timeElapsed;
+    };
+
+    tflitePool(const tflite::FlatBufferModel &model, Delegate delegateType, unsigned int laneCount,
+               const armnnOptionSet &armnnSettings, std::string weightsCachePath,
+               std::function<void()> resultCallback);
+    ~tflitePool();
+    unsigned int getLaneCount();
+    bool hasIdleLane();
+    void submit(const cv::Mat &inputMat, frameResult frame);
+    void complete(frameResult frame);
+    bool takeResult(frameResult &result);
+    void discardPending();
+
+private:
+    struct lane {
+        std::thread thread;
+        std::vector<int> cpus;
+    };
+
+    void laneLoop(unsigned int laneIndex);
+
+    const tflite::FlatBufferModel &tfliteModel;
+    Delegate delegateType;
+    armnnOptionSet armnnSettings;
+    std::string weightsCachePath;
+    std::function<void()> resultCallback;
+    std::vector<lane> lanes;
+    std::deque<frameResult> jobs;
+    std::map<uint64_t, frameResult> completed;
+    std::mutex poolMutex;
+    std::condition_variable jobReady;
+    std::condition_variable laneReady;
+    uint64_t nextSequence;
+    uint64_t nextDelivery;
+    uint64_t generation;
+    unsigned int busyLanes;
+    unsigned int readyLanes;
+    bool stopping;
+};
+
+#endif // TFLITEPOOL_H
@@ -0,0 +1,284 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+
+#include <QJsonArray>
+
+#include <tensorflow/lite/builtin_ops.h>
+
+#include "tfliteprofiler.h"
+
+#define PARTITION_CPU "CPU"
+#define PARTITION_DELEGATE_INTERNAL "delegate internal"
+
+/* Number of op types listed in the summary, the JSON report has them all */
+#define PROFILE_SUMMARY_OP_TYPES 10
+
+tfliteProfiler::tfliteProfiler(tflite::Interpreter *interpreter)
+{
+    profiledInterpreter = interpreter;
+    invokes = 0;
+}
+
+/* Only operator events are timed, the interpreter also reports runtime and
+ * memory events which are ignored. A handle of 0 tells the interpreter the
+ * event is not recorded */
+uint32_t tfliteProfiler::BeginEvent(const char *tag, EventType eventType,
+                                    int64_t eventMetadata1, int64_t eventMetadata2)
+{
+    openEvent event;
+
+    if (eventType != EventType::OPERATOR_INVOKE_EVENT &&
+        eventType != EventType::DELEGATE_OPERATOR_INVOKE_EVENT)
+        return 0;
+
+    event.tag = tag ? tag : "";
+    event.type = eventType;
+    event.node = eventMetadata1;
+    event.subgraph = eventMetadata2;
+    event.startTime = std::chrono::steady_clock::now();
+
+    openEvents.push_back(event);
+
+    return openEvents.size();
+}
+
+void tfliteProfiler::EndEvent(uint32_t eventHandle)
+{
+    std::chrono::steady_clock::time_point stopTime = std::chrono::steady_clock::now();
+    uint64_t elapsed;
+
+    if (eventHandle == 0 || eventHandle > openEvents.size())
+        return;
+
+    const openEvent &event = openEvents[eventHandle - 1];
+
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(stopTime - event.startTime).count();
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        std::map<std::pair<int64_t, int64_t>, nodeStats> &statsMap =
+                (event.type == EventType::OPERATOR_INVOKE_EVENT) ? nodes : delegateNodes;
+        std::pair<int64_t, int64_t> key(event.subgraph, event.node);
+        auto stats = statsMap.find(key);
+
+        if (stats == statsMap.end()) {
+            statsMap[key] = { event.tag, event.type, event.node, event.subgraph, 1, elapsed, elapsed, elapsed };
+        } else {
+            stats->second.count++;
+            stats->second.totalTime += elapsed;
+            stats->second.minTime = std::min(stats->second.minTime, elapsed);
+            stats->second.maxTime = std::max(stats->second.maxTime, elapsed);
+        }
+    }
+
+    /* Operator events nest at most one level (a delegate kernel reporting its
+     * own ops), so once the outermost event ends the list can be reused */
+    if (eventHandle == 1)
+        openEvents.clear();
+}
+
+void tfliteProfiler::invokeFinished()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    invokes++;
+}
+
+void tfliteProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    nodes.clear();
+    delegateNodes.clear();
+    invokes = 0;
+}
+
+/* Work out where a node of the primary subgraph ran. Nodes replaced by a
+ * delegate kernel are reported under the delegate name, along with the
+ * number of original nodes that kernel covers */
+QString tfliteProfiler::nodePartition(const nodeStats &stats, int *replacedNodes)
+{
+    const std::pair<TfLiteNode, TfLiteRegistration> *nodeAndRegistration;
+
+    *replacedNodes = 0;
+
+    if (stats.type == EventType::DELEGATE_OPERATOR_INVOKE_EVENT)
+        return PARTITION_DELEGATE_INTERNAL;
+
+    if (stats.subgraph != 0 || stats.node < 0 || size_t(stats.node) >= profiledInterpreter->nodes_size())
+        return PARTITION_CPU;
+
+    nodeAndRegistration = profiledInterpreter->node_and_registration(int(stats.node));
+
+    if (nodeAndRegistration == nullptr ||
+        nodeAndRegistration->second.builtin_code != kTfLiteBuiltinDelegate)
+        return PARTITION_CPU;
+
+    if (nodeAndRegistration->first.builtin_data != nullptr) {
+        const TfLiteDelegateParams *params =
+                static_cast<const TfLiteDelegateParams *>(nodeAndRegistration->first.builtin_data);
+
+        if (params->nodes_to_replace != nullptr)
+            *replacedNodes = params->nodes_to_replace->size;
+    }
+
+    if (nodeAndRegistration->second.custom_name != nullptr)
+        return nodeAndRegistration->second.custom_name;
+
+    return QString::fromStdString(stats.tag);
+}
+
+std::vector<tfliteProfiler::opTypeStats> tfliteProfiler::sortedOpTypes()
+{
+    std::map<std::string, opTypeStats> opTypes;
+    std::vector<opTypeStats> sorted;
+
+    for (const auto &node : nodes) {
+        opTypeStats &stats = opTypes[node.second.tag];
+
+        stats.tag = node.second.tag;
+        stats.count += node.second.count;
+        stats.totalTime += node.second.totalTime;
+    }
+
+    for (const auto &opType : opTypes)
+        sorted.push_back(opType.second);
+
+    std::sort(sorted.begin(), sorted.end(), [](const opTypeStats &a, const opTypeStats &b) {
+        return a.totalTime > b.totalTime;
+    });
+
+    return sorted;
+}
+
+/* Short summary for the GUI: time per partition and the slowest op types */
+QString tfliteProfiler::textReport()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    std::map<QString, uint64_t> partitionTime;
+    std::map<QString, int> partitionNodes;
+    uint64_t totalTime = 0;
+    QString report;
+    int shown = 0;
+
+    if (invokes == 0)
+        return "No invokes profiled yet\n";
+
+    for (const auto &node : nodes) {
+        int replacedNodes;
+        QString partition = nodePartition(node.second, &replacedNodes);
+
+        partitionTime[partition] += node.second.totalTime;
+        partitionNodes[partition] += replacedNodes ? replacedNodes : 1;
+        totalTime += node.second.totalTime;
+    }
+
+    report += QString("Operator profile over %1 invokes\n\n").arg(invokes);
+
+    for (const auto &partition : partitionTime)
+        report += QString("%1: %2 nodes, %3 ms/invoke\n").arg(partition.first)
+                  .arg(partitionNodes[partition.first])
+                  .arg(double(partition.second) / invokes / 1000.0, 0, 'f', 2);
+
+    report += "\n";
+
+    for (const opTypeStats &opType : sortedOpTypes()) {
+        if (shown++ == PROFILE_SUMMARY_OP_TYPES)
+            break;
+
+        report += QString("%1: %2 ms/invoke (%3%)\n").arg(QString::fromStdString(opType.tag))
+                  .arg(double(opType.totalTime) / invokes / 1000.0, 0, 'f', 2)
+                  .arg(totalTime ? 100.0 * opType.totalTime / totalTime : 0.0, 0, 'f', 1);
+    }
+
+    return report;
+}
+
+/* One line per executed node, in execution order */
+QString tfliteProfiler::textNodeReport()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    QString report;
+
+    if (invokes == 0)
+        return report;
+
+    for (const std::map<std::pair<int64_t, int64_t>, nodeStats> *statsMap : { &nodes, &delegateNodes }) {
+        for (const auto &node : *statsMap) {
+            int replacedNodes;
+            QString partition = nodePartition(node.second, &replacedNodes);
+
+            report += QString("[%1:%2] %3 (%4): avg %5 us, min %6 us, max %7 us\n")
+                      .arg(node.second.subgraph).arg(node.second.node)
+                      .arg(QString::fromStdString(node.second.tag)).arg(partition)
+                      .arg(node.second.totalTime / node.second.count)
+                      .arg(node.second.minTime).arg(node.second.maxTime);
+        }
+    }
+
+    return report;
+}
+
+QJsonObject tfliteProfiler::jsonReport()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    QJsonObject report;
+    QJsonArray opTypes;
+    QJsonArray nodeArray;
+
+    report["invokes"] = qint64(invokes);
+
+    if (invokes == 0)
+        return report;
+
+    for (const opTypeStats &opType : sortedOpTypes()) {
+        QJsonObject entry;
+
+        entry["op"] = QString::fromStdString(opType.tag);
+        entry["count"] = qint64(opType.count);
+        entry["us_per_invoke"] = double(opType.totalTime) / invokes;
+        opTypes.append(entry);
+    }
+
+    for (const std::map<std::pair<int64_t, int64_t>, nodeStats> *statsMap : { &nodes, &delegateNodes }) {
+        for (const auto &node : *statsMap) {
+            QJsonObject entry;
+            int replacedNodes;
+
+            entry["subgraph"] = qint64(node.second.subgraph);
+            entry["node"] = qint64(node.second.node);
+            entry["op"] = QString::fromStdString(node.second.tag);
+            entry["partition"] = nodePartition(node.second, &replacedNodes);
+            entry["avg_us"] = double(node.second.totalTime) / node.second.count;
+            entry["min_us"] = qint64(node.second.minTime);
+            entry["max_us"] = qint64(node.second.maxTime);
+
+            if (replacedNodes)
+                entry["replaced_nodes"] = replacedNodes;
+
+            nodeArray.append(entry);
+        }
+    }
+
+    report["op_types"] = opTypes;
+    report["nodes"] = nodeArray;
+
+    return report;
+}
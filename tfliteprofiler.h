@@ -0,0 +1,89 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef TFLITEPROFILER_H
+#define TFLITEPROFILER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+
+#include <tensorflow/lite/core/api/profiler.h>
+#include <tensorflow/lite/interpreter.h>
+
+/* Aggregates the per-operator events that the interpreter reports while a
+ * profiler is attached. Timings are accumulated per node and per op type,
+ * so memory use does not grow with the number of invokes */
+class tfliteProfiler : public tflite::Profiler
+{
+public:
+    explicit tfliteProfiler(tflite::Interpreter *interpreter);
+
+    uint32_t BeginEvent(const char *tag, EventType eventType,
+                        int64_t eventMetadata1, int64_t eventMetadata2) override;
+    void EndEvent(uint32_t eventHandle) override;
+
+    void invokeFinished();
+    void reset();
+    QString textReport();
+    QString textNodeReport();
+    QJsonObject jsonReport();
+
+private:
+    struct openEvent {
+        std::string tag;
+        EventType type;
+        int64_t node;
+        int64_t subgraph;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    struct nodeStats {
+        std::string tag;
+        EventType type;
+        int64_t node;
+        int64_t subgraph;
+        uint64_t count;
+        uint64_t totalTime;
+        uint64_t minTime;
+        uint64_t maxTime;
+    };
+
+    struct opTypeStats {
+        std::string tag;
+        uint64_t count;
+        uint64_t totalTime;
+    };
+
+    QString nodePartition(const nodeStats &stats, int *replacedNodes);
+    std::vector<opTypeStats> sortedOpTypes();
+
+    tflite::Interpreter *profiledInterpreter;
+    std::vector<openEvent> openEvents;
+    std::map<std::pair<int64_t, int64_t>, nodeStats> nodes;
+    std::map<std::pair<int64_t, int64_t>, nodeStats> delegateNodes;
+    uint64_t invokes;
+    std::mutex statsMutex;
+};
+
+#endif // TFLITEPROFILER_H
@@ -16,8 +16,20 @@
  * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include "framepool.h"
+#include "memorymonitor.h"
+#include "pipelinetrace.h"
+#include "resultcache.h"
+#include "threadplacement.h"
+#include "tflitepool.h"
 #include "tfliteworker.h"
 
 #include <opencv2/imgproc/imgproc.hpp>
@@ -27,6 +39,7 @@
 #include <delegate/armnn_delegate.hpp>
 #include <delegate/DelegateOptions.hpp>
 #include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#include "tensorflow/lite/version.h"
 
 #define WARNING_IMAGE_RETREIVAL "Received invalid image path, could not run inference"
 #define WARNING_INVOKE "Failed to run invoke"
@@ -34,56 +47,285 @@
 
 #define SCALE_FACTOR_UCHAR_TO_FLOAT (1/255.0F)
 
-tfliteWorker::tfliteWorker(QString modelLocation, Delegate delegateType, int defaultThreads)
+#define BATCH_SIZE_MAX 8
+/* Calls with fewer images in a row before the batch is made smaller again */
+#define BATCH_SHRINK_CALLS 30
+
+/* Set with --warmup, see startWarmup() */
+static std::atomic<unsigned int> warmupInvokes(0);
+
+/* The bytes between the first and the last byte of the tensors of an
+ * allocation type. The memory planner places all arena tensors in one
+ * buffer and reuses memory between tensors that are not live at the same
+ * time, so this is the size of the arena rather than the sum of the tensors */
+static int64_t tfliteWorkerArenaSpan(tflite::Interpreter *interpreter, TfLiteAllocationType allocationType)
+{
+    uintptr_t arenaStart = UINTPTR_MAX;
+    uintptr_t arenaEnd = 0;
+
+    for (size_t i = 0; i < interpreter->tensors_size(); i++) {
+        const TfLiteTensor *tensor = interpreter->tensor(int(i));
+
+        if (tensor->allocation_type != allocationType || tensor->data.raw == nullptr || tensor->bytes == 0)
+            continue;
+
+        arenaStart = std::min(arenaStart, uintptr_t(tensor->data.raw));
+        arenaEnd = std::max(arenaEnd, uintptr_t(tensor->data.raw) + tensor->bytes);
+    }
+
+    return arenaEnd > arenaStart ? int64_t(arenaEnd - arenaStart) : 0;
+}
+
+#define XNNPACK_WEIGHTS_CACHE_DIR "xnnpack"
+#define XNNPACK_WEIGHTS_CACHE_SUFFIX ".xnnpack-weights"
+
+/* File backed XNNPack weights caches were added in TensorFlow Lite 2.17 */
+#if TF_MAJOR_VERSION > 2 || (TF_MAJOR_VERSION == 2 && TF_MINOR_VERSION >= 17)
+#define XNNPACK_WEIGHTS_CACHE_SUPPORTED
+#endif
+
+tfliteWorker::tfliteWorker(QString modelLocation, Delegate delegateType, int defaultThreads) :
+    tfliteWorker(modelLocation, delegateType, defaultThreads, armnnOptions::get(modelLocation))
+{
+}
+
+tfliteWorker::tfliteWorker(QString modelLocation, Delegate delegateType, int defaultThreads,
+                           const armnnOptionSet &armnnSettings)
 {
-    tflite::ops::builtin::BuiltinOpResolver tfliteResolver;
     TfLiteIntArray *wantedDimensions;
     this->delegateType = delegateType;
+    this->armnnSettings = armnnSettings;
+    invokeTimeTotal = 0;
+    invokeCount = 0;
+    warmupDone = false;
+    sharedArena = false;
+    batchSize = 1;
+    batchShrinkCount = 0;
+    batchUnsupported = false;
+    buildRssBytes = memoryMonitor::readRss();
+    lastItemStride = 0;
+    lastTimeElapsed = 0;
     modelName = modelLocation;
+    xnnpack_delegate = nullptr;
+    weightsCacheState = "off";
 
     tfliteModel = tflite::FlatBufferModel::BuildFromFile(modelLocation.toStdString().c_str());
-    tflite::InterpreterBuilder(*tfliteModel, tfliteResolver) (&tfliteInterpreter);
+
+    if (delegateType == xnnpack) {
+        weightsCachePath = getWeightsCachePath(modelLocation);
+
+        if (!weightsCachePath.empty())
+            weightsCacheState = QFileInfo::exists(QString::fromStdString(weightsCachePath)) ? "warm" : "cold";
+    }
+
+    {
+        /* The delegate thread pools are started here, so start them on the
+         * inference cores */
+        threadRoleScope inferenceCores(inferenceRole);
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+        tfliteInterpreter = buildInterpreter(*tfliteModel, delegateType, defaultThreads, armnnSettings,
+                                             weightsCachePath, &xnnpack_delegate);
+
+        buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - startTime);
+    }
+
+    buildRssBytes = memoryMonitor::readRss() - buildRssBytes;
+
+    if (!weightsCachePath.empty())
+        qInfo("XNNPack weights cache %s for %s, interpreter built in %lld ms", qPrintable(weightsCacheState),
+              qPrintable(QFileInfo(modelLocation).fileName()), (long long) buildTime.count());
+
+    wantedDimensions = tfliteInterpreter->tensor(tfliteInterpreter->inputs()[0])->dims;
+    wantedHeight = wantedDimensions->data[1];
+    wantedWidth = wantedDimensions->data[2];
+    wantedChannels = wantedDimensions->data[3];
+}
+
+tfliteWorker::~tfliteWorker() {
+    waitForWarmup();
+
+    /* The benchmark reports its own times */
+    if (delegateType == armNN && invokeCount > 0)
+        armnnOptions::recordTimes(modelName, armnnSettings, buildTime.count(),
+                                  double(invokeTimeTotal) / invokeCount, invokeCount);
+
+    /* The pool interpreters share the model */
+    pool.reset();
+    tfliteInterpreter.reset();
+    profiler.reset();
+
+    if (xnnpack_delegate != nullptr)
+        TfLiteXNNPackDelegateDelete(xnnpack_delegate);
+}
+
+/* XNNPack repacks every weight into its own layout when the graph is
+ * delegated, which for the larger models is most of the start up time and
+ * briefly holds two copies of the weights. With a weights cache file the
+ * packed weights are written the first time and mapped from the file by
+ * every later build. The file is named after the model and keyed on its
+ * size and modification time, so a replaced model gets a new cache. Returns
+ * an empty path when the cache is not available */
+std::string tfliteWorker::getWeightsCachePath(QString modelLocation)
+{
+#ifdef XNNPACK_WEIGHTS_CACHE_SUPPORTED
+    QFileInfo modelInfo(modelLocation);
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" +
+                       XNNPACK_WEIGHTS_CACHE_DIR;
+    QString cacheName = QString("%1-%2-%3" XNNPACK_WEIGHTS_CACHE_SUFFIX).arg(modelInfo.completeBaseName())
+                        .arg(modelInfo.size()).arg(modelInfo.lastModified().toSecsSinceEpoch());
+
+    if (!modelInfo.exists() || !QDir().mkpath(cacheDir)) {
+        qWarning("Warning: Cannot create XNNPack weights cache directory %s", qPrintable(cacheDir));
+        return std::string();
+    }
+
+    return (cacheDir + "/" + cacheName).toStdString();
+#else
+    static bool warned = false;
+
+    Q_UNUSED(modelLocation);
+
+    if (!warned) {
+        qWarning("Warning: XNNPack weights cache needs TensorFlow Lite 2.17 or later, weights are repacked on "
+                 "every start");
+        warned = true;
+    }
+
+    return std::string();
+#endif
+}
+
+/* Create an interpreter for the model with the delegate applied and the
+ * tensors allocated. The XNNPack delegate is returned through
+ * xnnpackDelegate, it must be deleted after the interpreter. The ArmNN
+ * options are only used by the ArmNN delegate, the weights cache path only
+ * by the XNNPack delegate when not empty. The path must outlive the
+ * delegate */
+std::unique_ptr<tflite::Interpreter> tfliteWorker::buildInterpreter(const tflite::FlatBufferModel &model,
+                                                                    Delegate delegateType, int threads,
+                                                                    const armnnOptionSet &armnnSettings,
+                                                                    const std::string &weightsCachePath,
+                                                                    TfLiteDelegate **xnnpackDelegate)
+{
+    tflite::ops::builtin::BuiltinOpResolver tfliteResolver;
+    std::unique_ptr<tflite::Interpreter> interpreter;
+
+    tflite::InterpreterBuilder(model, tfliteResolver) (&interpreter);
 
     /* Setup the delegate */
     if(delegateType == armNN) {
         std::vector<armnn::BackendId> backends = {armnn::Compute::CpuAcc};
-        armnnDelegate::DelegateOptions delegateOptions(backends);
+        armnn::OptimizerOptions optimizerOptions;
+        unsigned int armnnThreads = armnnSettings.threads > 0 ? armnnSettings.threads : threads;
+
+        /* FP16 reduction only pays off on cores with FP16 arithmetic, such
+         * as the Cortex-A55 of the RZ/G2L */
+        optimizerOptions.m_ReduceFp32ToFp16 = armnnSettings.reduceFp16;
+        optimizerOptions.m_ModelOptions.push_back(armnn::BackendOptions("CpuAcc", {
+            { "FastMathEnabled", armnnSettings.fastMath },
+            { "NumberOfThreads", armnnThreads }
+        }));
+
+        armnnDelegate::DelegateOptions delegateOptions(backends, optimizerOptions);
         std::unique_ptr<TfLiteDelegate, decltype(&armnnDelegate::TfLiteArmnnDelegateDelete)>
             armnnTfLiteDelegate(armnnDelegate::TfLiteArmnnDelegateCreate(delegateOptions),
             armnnDelegate::TfLiteArmnnDelegateDelete);
 
         /* Instruct the Interpreter to use the armnnDelegate */
-        if (tfliteInterpreter->ModifyGraphWithDelegate(std::move(armnnTfLiteDelegate)) != kTfLiteOk)
+        if (interpreter->ModifyGraphWithDelegate(std::move(armnnTfLiteDelegate)) != kTfLiteOk)
            qWarning("ArmNN Delegate could not be used to modify the graph\n");
     }
 
     if (delegateType == xnnpack) {
         TfLiteXNNPackDelegateOptions xnnpack_options = TfLiteXNNPackDelegateOptionsDefault();
 
-        xnnpack_options.num_threads = defaultThreads;
-        xnnpack_delegate = TfLiteXNNPackDelegateCreate(&xnnpack_options);
+        xnnpack_options.num_threads = threads;
+#ifdef XNNPACK_WEIGHTS_CACHE_SUPPORTED
+        if (!weightsCachePath.empty())
+            xnnpack_options.weight_cache_file_path = weightsCachePath.c_str();
+#else
+        Q_UNUSED(weightsCachePath);
+#endif
+        *xnnpackDelegate = TfLiteXNNPackDelegateCreate(&xnnpack_options);
 
-        if (tfliteInterpreter->ModifyGraphWithDelegate(xnnpack_delegate) != kTfLiteOk)
+        if (interpreter->ModifyGraphWithDelegate(*xnnpackDelegate) != kTfLiteOk)
             qWarning("Could not modifiy Graph with XNNPack Delegate\n");
     }
 
-    if (tfliteInterpreter->AllocateTensors() != kTfLiteOk)
+    if (interpreter->AllocateTensors() != kTfLiteOk)
         qFatal("Failed to allocate tensors!");
 
-    tfliteInterpreter->SetProfiler(nullptr);
-    tfliteInterpreter->SetNumThreads(defaultThreads);
+    interpreter->SetProfiler(nullptr);
+    interpreter->SetNumThreads(threads);
 
-    wantedDimensions = tfliteInterpreter->tensor(tfliteInterpreter->inputs()[0])->dims;
-    wantedHeight = wantedDimensions->data[1];
-    wantedWidth = wantedDimensions->data[2];
-    wantedChannels = wantedDimensions->data[3];
+    return interpreter;
 }
 
-tfliteWorker::~tfliteWorker() {
-    tfliteInterpreter.reset();
+/* Run frames on laneCount interpreters at once, see tflitePool. Results
+ * are still sent in frame order, but receiveImage() returns before they are
+ * ready. Only frames are run on the pool, the profiler and the benchmark
+ * keep using the interpreter created with the worker */
+void tfliteWorker::setInterpreterPool(unsigned int laneCount)
+{
+    pool.reset();
 
-    if (delegateType == xnnpack)
-        TfLiteXNNPackDelegateDelete(xnnpack_delegate);
+    if (laneCount > 1)
+        pool.reset(new tflitePool(*tfliteModel, delegateType, laneCount, armnnSettings, weightsCachePath, [this] {
+            QMetaObject::invokeMethod(this, "deliverPoolResults", Qt::QueuedConnection);
+        }));
+}
+
+/* Interpreters that are only ever run one after another, such as the face
+ * and iris landmark models, never need their scratch arenas at the same
+ * time. With a shared arena the memory is only held during processData()
+ * and freed afterwards, so the next interpreter of the chain reuses it and
+ * the chain needs about as much memory as its largest arena rather than all
+ * of them. The input is copied in and the outputs copied out within the
+ * call, so nothing in the arena has to outlive it. Not for the benchmark,
+ * which loads the input and invokes separately */
+void tfliteWorker::setSharedArena(bool enable)
+{
+    waitForWarmup();
+
+    if (enable == sharedArena)
+        return;
+
+    sharedArena = enable;
+
+    if (sharedArena)
+        tfliteInterpreter->ReleaseNonPersistentMemory();
+    else if (tfliteInterpreter->AllocateTensors() != kTfLiteOk)
+        qWarning("Warning: Failed to allocate tensors of %s", qPrintable(QFileInfo(modelName).fileName()));
+}
+
+/* After ReleaseNonPersistentMemory() the graph keeps its plan and prepared
+ * operators, so AllocateTensors() only allocates the arena again and points
+ * the tensors back into it */
+bool tfliteWorker::acquireArena()
+{
+    return !sharedArena || tfliteInterpreter->AllocateTensors() == kTfLiteOk;
+}
+
+void tfliteWorker::releaseArena()
+{
+    if (sharedArena)
+        tfliteInterpreter->ReleaseNonPersistentMemory();
+}
+
+/* True when another frame would be run straight away, without the
+ * interpreter pool there is only ever one frame at a time */
+bool tfliteWorker::canAcceptFrame()
+{
+    return pool && pool->hasIdleLane();
+}
+
+/* Results of frames already given to the interpreter pool are not sent */
+void tfliteWorker::discardPendingResults()
+{
+    if (pool)
+        pool->discardPending();
 }
 
 /* Resize the input image and manipulate the data such that the alpha channel
@@ -92,7 +334,8 @@ tfliteWorker::~tfliteWorker() {
 void tfliteWorker::receiveImage(const cv::Mat& sentMat)
 {
     cv::Mat sentImageMat;
-    int input;
+
+    waitForWarmup();
 
     if(sentMat.empty()) {
         qWarning(WARNING_IMAGE_RETREIVAL);
@@ -102,26 +345,129 @@ void tfliteWorker::receiveImage(const cv::Mat& sentMat)
 
     displayMat = &sentMat;
 
-    input = tfliteInterpreter->inputs()[0];
+    if (pool) {
+        submitToPool(sentMat, sentMat);
+        return;
+    }
+
+    if (replayCachedResult())
+        return;
+
+    prepareInputImage(sentMat, sentImageMat);
+
+    processData(sentImageMat.data, sentImageMat.total() * sentImageMat.elemSize());
+}
+
+/* As above, but the input comes from a frame that has already been scaled to
+ * the model input size, while the results are sent with the display frame */
+void tfliteWorker::receiveImage(const cv::Mat& displayImage, const cv::Mat& modelImage)
+{
+    cv::Mat sentImageMat;
+
+    waitForWarmup();
+
+    if(displayImage.empty() || modelImage.empty()) {
+        qWarning(WARNING_IMAGE_RETREIVAL);
+        emit sendInferenceWarning(WARNING_IMAGE_RETREIVAL);
+        return;
+    }
+
+    displayMat = &displayImage;
+
+    if (pool) {
+        submitToPool(displayImage, modelImage);
+        return;
+    }
+
+    if (replayCachedResult())
+        return;
+
+    prepareInputImage(modelImage, sentImageMat);
+
+    processData(sentImageMat.data, sentImageMat.total() * sentImageMat.elemSize());
+}
+
+void tfliteWorker::submitToPool(const cv::Mat& displayImage, const cv::Mat& modelImage)
+{
+    tflitePool::frameResult frame;
+    cv::Mat preparedMat;
+
+    /* By the time the results are sent the capture buffers have been
+     * reused for later frames, so keep a copy */
+    frame.displayMat = framePool::copy(displayImage);
+    frame.frameKey = frameKey;
+    frameKey.clear();
 
-    cv::resize(sentMat, sentImageMat, cv::Size(wantedWidth, wantedHeight));
+    if (lookupResult(frame.frameKey, frame.outputTensor, frame.itemStride)) {
+        frame.timeElapsed = lastTimeElapsed;
+        pool->complete(std::move(frame));
+        return;
+    }
+
+    prepareInputImage(modelImage, preparedMat);
+
+    pool->submit(preparedMat, std::move(frame));
+}
+
+/* Send the results of the pool frames that are ready, in frame order */
+void tfliteWorker::deliverPoolResults()
+{
+    tflitePool::frameResult result;
+
+    while (pool && pool->takeResult(result)) {
+        if (!result.invoked) {
+            qWarning(WARNING_INVOKE);
+            emit sendInferenceWarning(WARNING_INVOKE);
+            continue;
+        }
+
+        poolDisplayMat = result.displayMat;
+        displayMat = &poolDisplayMat;
+        outputTensor = result.outputTensor;
+
+        /* Replayed results already have their item stride, they are not
+         * counted in the average inference time as nothing was run */
+        if (result.itemStride >= 0) {
+            sendResults(result.itemStride, result.timeElapsed);
+            continue;
+        }
+
+        frameKey = result.frameKey;
+        finishResults(result.outputTensorCount, result.timeElapsed);
+    }
+}
+
+cv::Size tfliteWorker::getInputSize()
+{
+    return cv::Size(wantedWidth, wantedHeight);
+}
+
+void tfliteWorker::prepareInputImage(const cv::Mat& inputMat, cv::Mat& preparedMat)
+{
+    TRACE_SCOPE("preprocess");
+    int input = tfliteInterpreter->inputs()[0];
+
+    /* Frames from the video pipeline may already be at the model input size */
+    if (inputMat.cols == wantedWidth && inputMat.rows == wantedHeight) {
+        preparedMat = inputMat.isContinuous() ? inputMat : framePool::copy(inputMat);
+    } else {
+        preparedMat = framePool::acquire(cv::Size(wantedWidth, wantedHeight), inputMat.type());
+        cv::resize(inputMat, preparedMat, preparedMat.size());
+    }
 
     if (tfliteInterpreter->tensor(input)->type == kTfLiteFloat32) {
+        cv::Mat floatMat = framePool::acquire(preparedMat.size(), CV_32FC3);
+
         /* Convert cv::Mat data type from 8-bit unsigned char to 32-bit float.
          * The data of the image needs to be divided by 255.0f as CV_8UC3 ranges
          * from 0 to 255, whereas CV_32FC3 ranges from 0 to 1 */
-        sentImageMat.convertTo(sentImageMat, CV_32FC3, SCALE_FACTOR_UCHAR_TO_FLOAT);
+        preparedMat.convertTo(floatMat, CV_32FC3, SCALE_FACTOR_UCHAR_TO_FLOAT);
+        preparedMat = floatMat;
     }
-
-    processData(sentImageMat.data, sentImageMat.total() * sentImageMat.elemSize());
 }
 
-void tfliteWorker::processData(void *data, size_t inputDataSize)
+bool tfliteWorker::copyInputData(void *data, size_t inputDataSize)
 {
-    std::chrono::high_resolution_clock::time_point startTime, stopTime;
-    QVector<int> outputTensorCount;
-    int timeElapsed;
-    int itemStride;
     int input = tfliteInterpreter->inputs()[0];
 
     if (tfliteInterpreter->tensor(input)->type == kTfLiteFloat32) {
@@ -131,13 +477,47 @@ void tfliteWorker::processData(void *data, size_t inputDataSize)
     } else {
         qWarning("Model data type currently not supported!");
         emit sendInferenceWarning(WARNING_UNSUPPORTED_DATA_TYPE);
+        return false;
+    }
+
+    return true;
+}
+
+void tfliteWorker::processData(void *data, size_t inputDataSize)
+{
+    std::chrono::high_resolution_clock::time_point startTime, stopTime;
+    QVector<int> outputTensorCount;
+    TfLiteStatus status;
+    int timeElapsed;
+
+    waitForWarmup();
+
+    /* After a batch, the single image runs alone */
+    if (batchSize > 1 && !resizeBatch(1))
+        qWarning("Warning: Failed to resize the input of %s", qPrintable(QFileInfo(modelName).fileName()));
+
+    if (!acquireArena()) {
+        qWarning(WARNING_INVOKE);
+        emit sendInferenceWarning(WARNING_INVOKE);
+        return;
+    }
+
+    if (!copyInputData(data, inputDataSize)) {
+        releaseArena();
         return;
     }
 
     startTime = std::chrono::high_resolution_clock::now();
 
-    if (tfliteInterpreter->Invoke() != kTfLiteOk) {
+    {
+        TRACE_SCOPE("invoke");
+        threadRoleScope inferenceCores(inferenceRole);
+        status = tfliteInterpreter->Invoke();
+    }
+
+    if (status != kTfLiteOk) {
         stopTime = std::chrono::high_resolution_clock::now();
+        releaseArena();
 
         qWarning(WARNING_INVOKE);
         emit sendInferenceWarning(WARNING_INVOKE);
@@ -146,25 +526,220 @@ void tfliteWorker::processData(void *data, size_t inputDataSize)
 
     stopTime = std::chrono::high_resolution_clock::now();
 
-    /* Cycle through each output tensor and store all data */
-    for (size_t i = 0; i < tfliteInterpreter->outputs().size(); i++) {
+    if (profiler)
+        profiler->invokeFinished();
+
+    readOutputs(tfliteInterpreter.get(), outputTensor, outputTensorCount);
+    releaseArena();
+
+    timeElapsed = int(std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count());
+
+    finishResults(outputTensorCount, timeElapsed);
+}
+
+/* Run the model on several images with one invoke, by resizing the batch
+ * dimension of the input. Much of an invoke of a small model goes on reading
+ * the weights and on running each operator, which the whole batch shares.
+ * The results of each image are sent together, in image order, with the
+ * item stride of one image and the total invoke time. Not for the interpreter
+ * pool or the result cache, which work on single frames */
+void tfliteWorker::receiveImageBatch(const QVector<cv::Mat>& images)
+{
+    std::chrono::microseconds invokeTime(0);
+    QList<QVector<float>> results;
+    QVector<int> outputCounts;
+    int itemStride;
+
+    waitForWarmup();
+
+    if (images.isEmpty())
+        return;
+
+    selectBatchSize(images.size());
+
+    for (int first = 0; first < images.size(); first += batchSize) {
+        if (!invokeBatch(images.mid(first, batchSize), results, outputCounts, invokeTime)) {
+            qWarning(WARNING_INVOKE);
+            emit sendInferenceWarning(WARNING_INVOKE);
+            return;
+        }
+    }
+
+    invokeTimeTotal += invokeTime.count() / 1000;
+    invokeCount++;
+
+    /* As finishResults(), the final output is unused */
+    outputCounts.removeLast();
+    itemStride = outputCounts.isEmpty() ? 0 : outputCounts.takeLast();
+
+    emit sendOutputTensorBatch(results, itemStride, int(invokeTime.count() / 1000));
+}
+
+/* The batch is rounded up to a power of two and only made smaller after
+ * BATCH_SHRINK_CALLS calls that needed less, so that the input is not resized
+ * every time the number of images changes. Resizing prepares the operators
+ * again, and delegates that cannot resize their part of the graph are
+ * applied to it again. Models that cannot be resized run one image at a time */
+void tfliteWorker::selectBatchSize(int imageCount)
+{
+    int wantedBatch = 1;
+
+    if (batchUnsupported)
+        return;
+
+    while (wantedBatch < imageCount && wantedBatch < BATCH_SIZE_MAX)
+        wantedBatch *= 2;
+
+    if (wantedBatch == batchSize) {
+        batchShrinkCount = 0;
+        return;
+    }
+
+    if (wantedBatch < batchSize && ++batchShrinkCount < BATCH_SHRINK_CALLS)
+        return;
+
+    batchShrinkCount = 0;
+
+    if (resizeBatch(wantedBatch))
+        return;
+
+    qWarning("Warning: %s does not support batches, running images one at a time",
+             qPrintable(QFileInfo(modelName).fileName()));
+    batchUnsupported = true;
+
+    if (!resizeBatch(1))
+        qWarning("Warning: Failed to resize the input of %s", qPrintable(QFileInfo(modelName).fileName()));
+}
+
+bool tfliteWorker::resizeBatch(int size)
+{
+    int input = tfliteInterpreter->inputs()[0];
+    TfLiteIntArray *dimensions = tfliteInterpreter->tensor(input)->dims;
+    std::vector<int> resizedDimensions(dimensions->data, dimensions->data + dimensions->size);
+
+    resizedDimensions[0] = size;
+
+    if (tfliteInterpreter->ResizeInputTensor(input, resizedDimensions) != kTfLiteOk ||
+        tfliteInterpreter->AllocateTensors() != kTfLiteOk)
+        return false;
+
+    batchSize = size;
+    releaseArena();
+
+    return true;
+}
+
+/* Invoke once on up to batchSize images and append the outputs of each image
+ * to results. Unused slots of the batch keep whatever they held, their
+ * outputs are dropped. Only float outputs are read, as the face models have */
+bool tfliteWorker::invokeBatch(const QVector<cv::Mat>& images, QList<QVector<float>>& results, QVector<int>& outputCounts,
+                               std::chrono::microseconds& invokeTime)
+{
+    std::chrono::high_resolution_clock::time_point startTime;
+    TfLiteTensor *inputTensor;
+    TfLiteStatus status;
+    size_t itemBytes;
+    int firstResult = results.size();
+
+    if (!acquireArena())
+        return false;
+
+    inputTensor = tfliteInterpreter->tensor(tfliteInterpreter->inputs()[0]);
+    itemBytes = inputTensor->bytes / batchSize;
+
+    for (int i = 0; i < images.size(); i++) {
+        cv::Mat preparedMat;
+
+        prepareInputImage(images.at(i), preparedMat);
+
+        if (preparedMat.total() * preparedMat.elemSize() != itemBytes) {
+            releaseArena();
+            return false;
+        }
+
+        memcpy(inputTensor->data.raw + i * itemBytes, preparedMat.data, itemBytes);
+    }
+
+    startTime = std::chrono::high_resolution_clock::now();
+
+    {
+        TRACE_SCOPE("invoke");
+        threadRoleScope inferenceCores(inferenceRole);
+        status = tfliteInterpreter->Invoke();
+    }
+
+    invokeTime += std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::high_resolution_clock::now() - startTime);
+
+    if (status != kTfLiteOk) {
+        releaseArena();
+        return false;
+    }
+
+    if (profiler)
+        profiler->invokeFinished();
+
+    outputCounts.clear();
+
+    for (int i = 0; i < images.size(); i++)
+        results.append(QVector<float>());
+
+    for (size_t output = 0; output < tfliteInterpreter->outputs().size(); output++) {
+        const float *outputData = tfliteInterpreter->typed_output_tensor<float>(output);
+        int itemCount = int(tfliteInterpreter->output_tensor(output)->bytes / sizeof(float)) / batchSize;
+
+        if (outputData == nullptr) {
+            releaseArena();
+            return false;
+        }
+
+        outputCounts.push_back(itemCount);
+
+        for (int i = 0; i < images.size(); i++) {
+            QVector<float> &itemResults = results[firstResult + i];
+
+            for (int k = 0; k < itemCount; k++)
+                itemResults.push_back(outputData[i * itemCount + k]);
+        }
+    }
+
+    releaseArena();
+
+    return true;
+}
+
+/* Cycle through each output tensor and append all data to outputs, with the
+ * number of values of each output tensor in outputCounts */
+void tfliteWorker::readOutputs(tflite::Interpreter *interpreter, QVector<float> &outputs, QVector<int> &outputCounts)
+{
+    for (size_t i = 0; i < interpreter->outputs().size(); i++) {
         size_t dataSize = sizeof(float);
 
-        if (tfliteInterpreter->output_tensor(i)->type == kTfLiteFloat32)
+        if (interpreter->output_tensor(i)->type == kTfLiteFloat32)
             dataSize = sizeof(float);
-        else if (tfliteInterpreter->output_tensor(i)->type == kTfLiteUInt8)
+        else if (interpreter->output_tensor(i)->type == kTfLiteUInt8)
             dataSize = sizeof(uint8_t);
 
         /* Total number of data elements */
-        int outputCount = tfliteInterpreter->output_tensor(i)->bytes / dataSize;
+        int outputCount = interpreter->output_tensor(i)->bytes / dataSize;
 
-        outputTensorCount.push_back(outputCount);
+        outputCounts.push_back(outputCount);
 
         for (int k = 0; k < outputCount; k++) {
-                float output = tfliteInterpreter->typed_output_tensor<float>(i)[k];
-                outputTensor.push_back(output);
+                float output = interpreter->typed_output_tensor<float>(i)[k];
+                outputs.push_back(output);
         }
     }
+}
+
+/* Work out the item stride of the results in outputTensor, store them for
+ * the frame key and send them */
+void tfliteWorker::finishResults(QVector<int> outputTensorCount, int timeElapsed)
+{
+    int itemStride;
+
+    invokeTimeTotal += timeElapsed;
+    invokeCount++;
 
     /* Set the item stride based on demo mode being used */
     if (modeSelected == PE) {
@@ -176,8 +751,28 @@ void tfliteWorker::processData(void *data, size_t inputDataSize)
         itemStride = outputTensorCount.takeLast();
     }
 
-    timeElapsed = int(std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count());
+    if (!frameKey.isEmpty() && resultCache::isEnabled()) {
+        /* Pose models also output heatmaps and segmentation masks which are
+         * not used, only keep the landmarks and the score that follows them */
+        int cachedCount = (modeSelected == PE) ? itemStride + 1 : outputTensor.size();
+
+        resultCache::store(resultCache::makeKey(frameKey, modelName, delegateType), outputTensor,
+                           cachedCount, itemStride);
+    }
+
+    /* Kept for a still image being shown again, sharing the data with
+     * outputTensor so it is not copied */
+    lastResultKey = frameKey;
+    lastResult = outputTensor;
+    lastItemStride = itemStride;
+    lastTimeElapsed = timeElapsed;
+    frameKey.clear();
+
+    sendResults(itemStride, timeElapsed);
+}
 
+void tfliteWorker::sendResults(int itemStride, int timeElapsed)
+{
     if (modeSelected == FD && modelName != MODEL_PATH_FD_FACE_DETECTION)
         emit sendOutputTensorImageless(outputTensor, itemStride, timeElapsed);
     else if (modeSelected == AC)
@@ -188,7 +783,293 @@ void tfliteWorker::processData(void *data, size_t inputDataSize)
     outputTensor.clear();
 }
 
+/* Key of the frame passed to the next receiveImage() call, results for
+ * frames with a key are stored in and replayed from the result cache */
+void tfliteWorker::setFrameKey(QString key)
+{
+    frameKey = key;
+}
+
+/* Finds the results of a frame that was already run, either the last frame
+ * when it had the same key, such as the same still image, or the frame's
+ * results in the result cache */
+bool tfliteWorker::lookupResult(QString key, QVector<float> &outputs, int &itemStride)
+{
+    if (key.isEmpty())
+        return false;
+
+    if (key == lastResultKey) {
+        outputs = lastResult;
+        itemStride = lastItemStride;
+
+        return true;
+    }
+
+    if (!resultCache::isEnabled())
+        return false;
+
+    return resultCache::lookup(resultCache::makeKey(key, modelName, delegateType), outputs, itemStride);
+}
+
+/* Sends the results of a frame that was already run instead of running
+ * inference, see lookupResult(). The last measured inference time is reported
+ * with them, and as nothing is run they are not counted in the average */
+bool tfliteWorker::replayCachedResult()
+{
+    int itemStride;
+
+    if (!lookupResult(frameKey, outputTensor, itemStride))
+        return false;
+
+    frameKey.clear();
+    sendResults(itemStride, lastTimeElapsed);
+
+    return true;
+}
+
 void tfliteWorker::setDemoMode(Mode demoMode)
 {
     modeSelected = demoMode;
 }
+
+/* Fill the input tensor from an image without running inference, used by the
+ * benchmark so that only Invoke() is measured */
+bool tfliteWorker::loadInputImage(const cv::Mat& inputMat)
+{
+    cv::Mat preparedMat;
+    TfLiteTensor *inputTensor;
+
+    waitForWarmup();
+
+    inputTensor = tfliteInterpreter->tensor(tfliteInterpreter->inputs()[0]);
+
+    if (inputMat.empty() || inputTensor->dims->size != 4)
+        return false;
+
+    prepareInputImage(inputMat, preparedMat);
+
+    if (preparedMat.total() * preparedMat.elemSize() != inputTensor->bytes)
+        return false;
+
+    return copyInputData(preparedMat.data, inputTensor->bytes);
+}
+
+/* Fill every input tensor with reproducible pseudo-random data, for models
+ * without image input or when no input file is given */
+void tfliteWorker::loadInputSynthetic()
+{
+    waitForWarmup();
+    loadInputSynthetic(tfliteInterpreter.get());
+}
+
+void tfliteWorker::loadInputSynthetic(tflite::Interpreter *interpreter)
+{
+    cv::RNG rng(0);
+
+    for (int input : interpreter->inputs()) {
+        TfLiteTensor *inputTensor = interpreter->tensor(input);
+
+        if (inputTensor->type == kTfLiteFloat32) {
+            cv::Mat inputMat(1, inputTensor->bytes / sizeof(float), CV_32F, inputTensor->data.raw);
+            rng.fill(inputMat, cv::RNG::UNIFORM, 0.0F, 1.0F);
+        } else {
+            cv::Mat inputMat(1, inputTensor->bytes, CV_8U, inputTensor->data.raw);
+            rng.fill(inputMat, cv::RNG::UNIFORM, 0, 256);
+        }
+    }
+}
+
+/* Run Invoke() on the current input tensor contents and report the time
+ * taken, the output tensors are left untouched */
+bool tfliteWorker::timedInvoke(std::chrono::microseconds& timeElapsed)
+{
+    std::chrono::steady_clock::time_point startTime, stopTime;
+    TfLiteStatus status;
+
+    waitForWarmup();
+
+    threadRoleScope inferenceCores(inferenceRole);
+
+    startTime = std::chrono::steady_clock::now();
+    status = tfliteInterpreter->Invoke();
+    stopTime = std::chrono::steady_clock::now();
+
+    timeElapsed = std::chrono::duration_cast<std::chrono::microseconds>(stopTime - startTime);
+
+    if (profiler && status == kTfLiteOk)
+        profiler->invokeFinished();
+
+    return status == kTfLiteOk;
+}
+
+/* The first invokes of a model are much slower than the rest, as kernels
+ * are prepared lazily, the delegates pack weights and the caches are cold.
+ * Run them on synthetic input on a background thread straight after the
+ * worker is created, so the first frame after a mode switch or Start does
+ * not pay for them. Anything that uses the interpreter waits for this to
+ * finish first */
+void tfliteWorker::startWarmup()
+{
+    unsigned int invokes = warmupInvokes.load();
+    bool shared = sharedArena;
+
+    if (invokes == 0 || warmup.valid() || warmupDone)
+        return;
+
+    warmup = std::async(std::launch::async, [this, invokes, shared] {
+        std::chrono::microseconds coldTime, warmTime;
+
+        pipelineTrace::setThreadName("warmup");
+        threadPlacement::applyRole(inferenceRole);
+
+        /* Keep the warm-up invokes out of the operator profile */
+        tfliteInterpreter->SetProfiler(nullptr);
+
+        if (shared)
+            tfliteInterpreter->AllocateTensors();
+
+        if (warmUp(tfliteInterpreter.get(), invokes, coldTime, warmTime))
+            qInfo("Warm-up of %s: cold invoke %lld us, warm invoke %lld us",
+                  qPrintable(QFileInfo(modelName).fileName()), (long long) coldTime.count(),
+                  (long long) warmTime.count());
+
+        if (shared)
+            tfliteInterpreter->ReleaseNonPersistentMemory();
+
+        tfliteInterpreter->SetProfiler(profiler.get());
+    });
+}
+
+void tfliteWorker::waitForWarmup()
+{
+    if (!warmup.valid())
+        return;
+
+    warmup.get();
+    warmupDone = true;
+}
+
+bool tfliteWorker::isWarmingUp()
+{
+    return warmup.valid() && warmup.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+/* Invoke the interpreter on synthetic input. The time of the first invoke is
+ * returned as coldTime and the mean of the rest as warmTime, which is the
+ * same as coldTime for a single invoke */
+bool tfliteWorker::warmUp(tflite::Interpreter *interpreter, unsigned int invokes,
+                          std::chrono::microseconds &coldTime, std::chrono::microseconds &warmTime)
+{
+    std::chrono::microseconds warmTotal(0);
+
+    TRACE_SCOPE("warmup");
+
+    loadInputSynthetic(interpreter);
+
+    for (unsigned int i = 0; i < invokes; i++) {
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        std::chrono::microseconds timeElapsed;
+
+        if (interpreter->Invoke() != kTfLiteOk)
+            return false;
+
+        timeElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - startTime);
+
+        if (i == 0)
+            coldTime = timeElapsed;
+        else
+            warmTotal += timeElapsed;
+    }
+
+    warmTime = (invokes > 1) ? warmTotal / (invokes - 1) : coldTime;
+
+    return invokes > 0;
+}
+
+void tfliteWorker::setWarmupInvokes(unsigned int invokes)
+{
+    warmupInvokes = invokes;
+}
+
+unsigned int tfliteWorker::getWarmupInvokes()
+{
+    return warmupInvokes.load();
+}
+
+/* Attach or detach the per-operator profiler. Enabling always starts from
+ * empty statistics */
+void tfliteWorker::setProfiling(bool enable)
+{
+    waitForWarmup();
+
+    if (enable) {
+        profiler.reset(new tfliteProfiler(tfliteInterpreter.get()));
+        tfliteInterpreter->SetProfiler(profiler.get());
+    } else {
+        tfliteInterpreter->SetProfiler(nullptr);
+        profiler.reset();
+    }
+}
+
+tfliteProfiler *tfliteWorker::getProfiler()
+{
+    return profiler.get();
+}
+
+QString tfliteWorker::getModelName()
+{
+    return modelName;
+}
+
+/* Time taken to build the interpreter, including delegating the graph.
+ * For the ArmNN delegate this is mostly optimising the network */
+std::chrono::milliseconds tfliteWorker::getBuildTime()
+{
+    return buildTime;
+}
+
+/* Memory used by the worker. The model file is mapped, so only the pages
+ * that have been used are resident. The build figure is how much the process
+ * RSS grew while the model was loaded and the interpreter built, which also
+ * covers the weights packed by the delegates and their own buffers. Other
+ * threads allocating at the same time make it approximate. A shared arena
+ * is only allocated during an invoke, so it reads as 0 here */
+QJsonObject tfliteWorker::getMemoryReport()
+{
+    const tflite::Allocation *allocation = tfliteModel->allocation();
+    QJsonObject report;
+
+    report["model"] = QFileInfo(modelName).fileName();
+
+    /* The interpreter belongs to the warm-up thread until it is done, and
+     * waiting for it here could hold up the GUI for the whole warm-up */
+    if (isWarmingUp()) {
+        report["warming_up"] = true;
+        return report;
+    }
+
+    waitForWarmup();
+
+    if (allocation != nullptr) {
+        report["model_bytes"] = qint64(allocation->bytes());
+        report["model_resident_bytes"] = qint64(memoryMonitor::residentBytes(allocation->base(), allocation->bytes()));
+    }
+
+    report["arena_bytes"] = qint64(tfliteWorkerArenaSpan(tfliteInterpreter.get(), kTfLiteArenaRw));
+    report["persistent_arena_bytes"] = qint64(tfliteWorkerArenaSpan(tfliteInterpreter.get(), kTfLiteArenaRwPersistent));
+    report["build_rss_bytes"] = qint64(buildRssBytes);
+    report["shared_arena"] = sharedArena;
+
+    if (pool)
+        report["pool_lanes"] = int(pool->getLaneCount());
+
+    return report;
+}
+
+/* "cold" when the XNNPack weights cache was written by this build, "warm"
+ * when it was read from an earlier one, otherwise "off" */
+QString tfliteWorker::getWeightsCacheState()
+{
+    return weightsCacheState;
+}
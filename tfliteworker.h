@@ -19,10 +19,17 @@
 #ifndef TFLITEWORKER_H
 #define TFLITEWORKER_H
 
+#include <chrono>
+#include <future>
+
 #include <tensorflow/lite/kernels/register.h>
 
+#include "armnnoptions.h"
 #include "edge-utils.h"
+#include "tfliteprofiler.h"
 
+#include <QJsonObject>
+#include <QList>
 #include <QObject>
 #include <QVector>
 
@@ -30,32 +37,108 @@
 
 enum Delegate { armNN, xnnpack, none };
 
+class tflitePool;
+
 class tfliteWorker : public QObject
 {
     Q_OBJECT
 
 public:
     tfliteWorker(QString modelLocation, Delegate armnnDelegate, int defaultThreads);
+    tfliteWorker(QString modelLocation, Delegate armnnDelegate, int defaultThreads,
+                 const armnnOptionSet &armnnSettings);
     ~tfliteWorker();
     void receiveImage(const cv::Mat&);
+    void receiveImage(const cv::Mat& displayImage, const cv::Mat& modelImage);
+    void receiveImageBatch(const QVector<cv::Mat>& images);
+    cv::Size getInputSize();
     void setDemoMode(Mode demoMode);
+    bool loadInputImage(const cv::Mat& inputMat);
+    void loadInputSynthetic();
+    void startWarmup();
+    void waitForWarmup();
+    bool isWarmingUp();
+    bool timedInvoke(std::chrono::microseconds& timeElapsed);
+    void setProfiling(bool enable);
+    tfliteProfiler *getProfiler();
+    QString getModelName();
+    std::chrono::milliseconds getBuildTime();
+    QString getWeightsCacheState();
+    QJsonObject getMemoryReport();
+    void setFrameKey(QString key);
+    void setInterpreterPool(unsigned int laneCount);
+    void setSharedArena(bool enable);
+    bool canAcceptFrame();
+
+    static std::unique_ptr<tflite::Interpreter> buildInterpreter(const tflite::FlatBufferModel &model,
+                                                                 Delegate delegateType, int threads,
+                                                                 const armnnOptionSet &armnnSettings,
+                                                                 const std::string &weightsCachePath,
+                                                                 TfLiteDelegate **xnnpackDelegate);
+    static void readOutputs(tflite::Interpreter *interpreter, QVector<float> &outputs, QVector<int> &outputCounts);
+    static void loadInputSynthetic(tflite::Interpreter *interpreter);
+    static bool warmUp(tflite::Interpreter *interpreter, unsigned int invokes,
+                       std::chrono::microseconds &coldTime, std::chrono::microseconds &warmTime);
+    static void setWarmupInvokes(unsigned int invokes);
+    static unsigned int getWarmupInvokes();
 
 public slots:
     void processData(void *data, size_t dataSize);
+    void discardPendingResults();
 
 signals:
     void sendOutputTensor(const QVector<float>&, int, int, const cv::Mat&);
     void sendOutputTensorImageless(const QVector<float>&, int, int);
+    void sendOutputTensorBatch(const QList<QVector<float>>&, int, int);
     void sendOutputTensorBasic(const QVector<float>&, int);
     void sendInferenceWarning(QString warningMessage);
 
+private slots:
+    void deliverPoolResults();
+
 private:
+    static std::string getWeightsCachePath(QString modelLocation);
+    void submitToPool(const cv::Mat& displayImage, const cv::Mat& modelImage);
+    void prepareInputImage(const cv::Mat& inputMat, cv::Mat& preparedMat);
+    bool copyInputData(void *data, size_t dataSize);
+    bool acquireArena();
+    void releaseArena();
+    void selectBatchSize(int imageCount);
+    bool resizeBatch(int size);
+    bool invokeBatch(const QVector<cv::Mat>& images, QList<QVector<float>>& results, QVector<int>& outputCounts,
+                     std::chrono::microseconds& invokeTime);
+    bool lookupResult(QString key, QVector<float> &outputs, int &itemStride);
+    bool replayCachedResult();
+    void finishResults(QVector<int> outputTensorCount, int timeElapsed);
+    void sendResults(int itemStride, int timeElapsed);
+
     std::unique_ptr<tflite::Interpreter> tfliteInterpreter;
     std::unique_ptr<tflite::FlatBufferModel> tfliteModel;
+    std::unique_ptr<tfliteProfiler> profiler;
+    std::unique_ptr<tflitePool> pool;
+    std::future<void> warmup;
+    bool warmupDone;
+    bool sharedArena;
+    int batchSize;
+    int batchShrinkCount;
+    bool batchUnsupported;
+    cv::Mat poolDisplayMat;
     QString modelName;
+    QString frameKey;
+    QString lastResultKey;
+    QVector<float> lastResult;
+    int lastItemStride;
+    int lastTimeElapsed;
     Delegate delegateType;
     Mode modeSelected;
     TfLiteDelegate* xnnpack_delegate;
+    std::string weightsCachePath;
+    QString weightsCacheState;
+    std::chrono::milliseconds buildTime;
+    int64_t buildRssBytes;
+    armnnOptionSet armnnSettings;
+    qint64 invokeTimeTotal;
+    unsigned long invokeCount;
     QVector<float> outputTensor;
     const cv::Mat *displayMat;
     int wantedWidth, wantedHeight, wantedChannels;
@@ -0,0 +1,274 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <QtGlobal>
+
+#include "threadplacement.h"
+
+#define AUDIO_FIFO_NOT_STARTED 0
+#define AUDIO_FIFO_APPLIED 1
+#define AUDIO_FIFO_REFUSED 2
+
+static const char *roleNames[THREAD_ROLE_COUNT] = { "gui", "capture", "inference", "audio" };
+static const char *roleTitles[THREAD_ROLE_COUNT] = { "GUI", "Capture", "Inference", "Audio" };
+static cpu_set_t roleCores[THREAD_ROLE_COUNT];
+static bool roleConfigured[THREAD_ROLE_COUNT] = { false, false, false, false };
+static cpu_set_t processCores;
+static bool placementActive = false;
+static bool audioRealTime = false;
+static std::atomic<int> audioFifoState(AUDIO_FIFO_NOT_STARTED);
+static bool memoryLocked = false;
+
+/* Each entry is role=cores, for example inference=4-5 or capture=0,2-3.
+ * Entries that cannot be parsed are skipped with a warning */
+bool threadPlacement::configure(const QStringList &roleSpecs)
+{
+    bool valid = true;
+
+    if (sched_getaffinity(0, sizeof(processCores), &processCores) != 0) {
+        qWarning("Warning: Could not read the CPU affinity of the process");
+        return false;
+    }
+
+    foreach (QString roleSpec, roleSpecs) {
+        QStringList specParts = roleSpec.split('=');
+        cpu_set_t cores;
+        int role;
+
+        if (specParts.size() != 2) {
+            qWarning("Warning: Invalid CPU affinity %s, expected role=cores", qPrintable(roleSpec));
+            valid = false;
+            continue;
+        }
+
+        for (role = 0; role < THREAD_ROLE_COUNT; role++) {
+            if (specParts.at(0).trimmed() == roleNames[role])
+                break;
+        }
+
+        if (role == THREAD_ROLE_COUNT) {
+            qWarning("Warning: Unknown thread role %s, expected gui, capture, inference or audio",
+                     qPrintable(specParts.at(0)));
+            valid = false;
+            continue;
+        }
+
+        if (!parseCores(specParts.at(1), cores)) {
+            qWarning("Warning: Invalid core list %s", qPrintable(specParts.at(1)));
+            valid = false;
+            continue;
+        }
+
+        roleCores[role] = cores;
+        roleConfigured[role] = true;
+        placementActive = true;
+    }
+
+    return valid;
+}
+
+/* Run the audio capture thread as SCHED_FIFO, this needs CAP_SYS_NICE or a
+ * realtime priority limit (ulimit -r) of at least AUDIO_FIFO_PRIORITY */
+void threadPlacement::setAudioRealTime(bool enable)
+{
+    audioRealTime = enable;
+}
+
+/* Lock the process memory so that it is not paged out or dropped from the
+ * page cache, such as the mapped model files */
+bool threadPlacement::lockMemory()
+{
+    int flags = MCL_CURRENT | MCL_FUTURE;
+
+#ifdef MCL_ONFAULT
+    /* Lock pages once they are first used. Otherwise every thread stack and
+     * all reserved heap would be populated up front */
+    flags |= MCL_ONFAULT;
+#endif
+
+    if (mlockall(flags) != 0) {
+        qWarning("Warning: Could not lock memory: %s", strerror(errno));
+        return false;
+    }
+
+    memoryLocked = true;
+
+    return true;
+}
+
+/* Called by a thread when it starts. Roles without a core set are moved
+ * back to all cores, as threads inherit the cores of the thread that
+ * started them */
+void threadPlacement::applyRole(ThreadRole role)
+{
+    cpu_set_t cores;
+
+    if (placementActive) {
+        getCores(role, cores);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) != 0)
+            qWarning("Warning: Could not set the CPU affinity of the %s thread", roleNames[role]);
+    }
+
+    if (role == audioRole && audioRealTime) {
+        struct sched_param schedParam;
+        int status;
+
+        schedParam.sched_priority = AUDIO_FIFO_PRIORITY;
+        status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
+
+        if (status != 0) {
+            qWarning("Warning: Could not run the audio thread as SCHED_FIFO: %s", strerror(status));
+            audioFifoState = AUDIO_FIFO_REFUSED;
+        } else {
+            audioFifoState = AUDIO_FIFO_APPLIED;
+        }
+    }
+}
+
+/* Cores for a role, all cores the process may use when none are set.
+ * Returns whether the role has its own core set */
+bool threadPlacement::getCores(ThreadRole role, cpu_set_t &cores)
+{
+    if (roleConfigured[role]) {
+        cores = roleCores[role];
+        return true;
+    }
+
+    if (!placementActive)
+        sched_getaffinity(0, sizeof(cores), &cores);
+    else
+        cores = processCores;
+
+    return false;
+}
+
+bool threadPlacement::isConfigured()
+{
+    return placementActive || audioRealTime || memoryLocked;
+}
+
+/* Summary of the placement for the Hardware dialog */
+QString threadPlacement::describe()
+{
+    QString description = "Thread Placement";
+
+    for (int role = 0; role < THREAD_ROLE_COUNT; role++) {
+        description += QString("\n%1: ").arg(roleTitles[role]);
+
+        if (roleConfigured[role])
+            description += "CPUs " + formatCores(roleCores[role]);
+        else
+            description += "all CPUs";
+
+        if (role == audioRole && audioRealTime) {
+            if (audioFifoState == AUDIO_FIFO_APPLIED)
+                description += QString(", SCHED_FIFO %1").arg(AUDIO_FIFO_PRIORITY);
+            else if (audioFifoState == AUDIO_FIFO_REFUSED)
+                description += ", SCHED_FIFO refused";
+            else
+                description += ", SCHED_FIFO when listening";
+        }
+    }
+
+    description += QString("\nMemory: ") + (memoryLocked ? "locked" : "not locked");
+
+    return description;
+}
+
+bool threadPlacement::parseCores(QString coreList, cpu_set_t &cores)
+{
+    CPU_ZERO(&cores);
+
+    foreach (QString coreRange, coreList.split(',')) {
+        QStringList rangeEnds = coreRange.split('-');
+        bool firstValid, lastValid;
+        int firstCore, lastCore;
+
+        if (rangeEnds.size() > 2)
+            return false;
+
+        firstCore = rangeEnds.first().trimmed().toInt(&firstValid);
+        lastCore = rangeEnds.last().trimmed().toInt(&lastValid);
+
+        if (!firstValid || !lastValid || firstCore < 0 || lastCore < firstCore || lastCore >= CPU_SETSIZE)
+            return false;
+
+        for (int core = firstCore; core <= lastCore; core++)
+            CPU_SET(core, &cores);
+    }
+
+    return CPU_COUNT(&cores) > 0;
+}
+
+QString threadPlacement::formatCores(const cpu_set_t &cores)
+{
+    QStringList coreRanges;
+
+    for (int core = 0; core < CPU_SETSIZE; core++) {
+        int lastCore = core;
+
+        if (!CPU_ISSET(core, &cores))
+            continue;
+
+        while (lastCore + 1 < CPU_SETSIZE && CPU_ISSET(lastCore + 1, &cores))
+            lastCore++;
+
+        if (lastCore == core)
+            coreRanges.append(QString::number(core));
+        else
+            coreRanges.append(QString("%1-%2").arg(core).arg(lastCore));
+
+        core = lastCore;
+    }
+
+    return coreRanges.join(',');
+}
+
+/* As applyRole(), a role without a core set runs on all cores, not on the
+ * cores of the calling thread, which may be the GUI thread */
+threadRoleScope::threadRoleScope(ThreadRole role) : changed(false)
+{
+    cpu_set_t cores;
+
+    if (!placementActive)
+        return;
+
+    threadPlacement::getCores(role, cores);
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(previousCores), &previousCores) != 0)
+        return;
+
+    if (CPU_EQUAL(&cores, &previousCores))
+        return;
+
+    changed = pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0;
+}
+
+threadRoleScope::~threadRoleScope()
+{
+    if (changed)
+        pthread_setaffinity_np(pthread_self(), sizeof(previousCores), &previousCores);
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <sched.h>
+
+#include <QString>
+#include <QStringList>
+
+#include "edge-utils.h"
+
+#define THREAD_ROLE_COUNT 4
+
+/* Priority used for the audio capture thread when it runs as SCHED_FIFO */
+#define AUDIO_FIFO_PRIORITY 50
+
+/* Places the application threads on configured CPU cores by their role, so
+ * that runs are reproducible on big.LITTLE parts such as the RZ/G2M. Roles
+ * without a core set are left on every core the process may use. Must be
+ * configured from main() before any worker thread is started */
+class threadPlacement
+{
+public:
+    static bool configure(const QStringList &roleSpecs);
+    static void setAudioRealTime(bool enable);
+    static bool lockMemory();
+    static void applyRole(ThreadRole role);
+    static bool getCores(ThreadRole role, cpu_set_t &cores);
+    static bool isConfigured();
+    static QString describe();
+
+private:
+    static bool parseCores(QString coreList, cpu_set_t &cores);
+    static QString formatCores(const cpu_set_t &cores);
+};
+
+/* Moves the calling thread to the cores of a role until the end of the
+ * enclosing scope. Threads started in the meantime, such as the inference
+ * thread pool of a delegate, stay on those cores */
+class threadRoleScope
+{
+public:
+    explicit threadRoleScope(ThreadRole role);
+    ~threadRoleScope();
+
+private:
+    cpu_set_t previousCores;
+    bool changed;
+};
+
+#endif // THREADPLACEMENT_H
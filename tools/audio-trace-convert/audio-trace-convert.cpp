@@ -0,0 +1,104 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+/* Converts a binary audio trace written by audioTrace back into the text
+ * format of debug.txt: "sample marker input debug threshold" per line */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../../audiotrace.h"
+
+int main(int argc, char *argv[])
+{
+    audioTraceFileHeader fileHeader;
+    audioTraceRecordHeader header;
+    std::vector<float> input;
+    std::vector<float> slices;
+    FILE *in;
+    FILE *out;
+    int sample = 0;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <debug.trace> <debug.txt>\n", argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fread(&fileHeader, sizeof(fileHeader), 1, in) != 1 ||
+        memcmp(fileHeader.magic, AUDIO_TRACE_MAGIC, AUDIO_TRACE_MAGIC_SIZE) != 0 ||
+        fileHeader.version != AUDIO_TRACE_VERSION) {
+        fprintf(stderr, "%s is not a supported audio trace file\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+
+    out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    while (fread(&header, sizeof(header), 1, in) == 1) {
+        /* Every sample maps to a slice of window samples */
+        if (header.window == 0 && header.sampleCount > 0) {
+            fprintf(stderr, "Malformed record in %s: window is 0\n", argv[1]);
+            fclose(out);
+            fclose(in);
+            return 1;
+        }
+
+        input.resize(header.sampleCount);
+        slices.resize(header.sliceCount);
+
+        if (fread(input.data(), sizeof(float), header.sampleCount, in) != header.sampleCount ||
+            fread(slices.data(), sizeof(float), header.sliceCount, in) != header.sliceCount) {
+            fprintf(stderr, "Truncated record in %s\n", argv[1]);
+            break;
+        }
+
+        for (unsigned int i = 0; i < header.sampleCount; i++) {
+            float marker = 0.0;
+            float debug = 0.0;
+            unsigned int slice = i / header.window;
+
+            if (i == 0)
+                marker = 1.0;
+            else if (i == 1)
+                marker = -1.0;
+
+            if (slice < header.sliceCount)
+                debug = slices[slice];
+
+            fprintf(out, "%d %f %f %f %f\n", sample++, marker, input[i], debug,
+                    header.threshold);
+        }
+    }
+
+    fclose(out);
+    fclose(in);
+
+    return 0;
+}
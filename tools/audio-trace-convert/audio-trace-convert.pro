@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = audio-trace-convert
+
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+SOURCES += \
+    audio-trace-convert.cpp
+
+HEADERS += \
+    ../../audiotrace.h
@@ -0,0 +1,178 @@
+/*****************************************************************************************
+ * Copyright (C) 2023 Renesas Electronics Corp.
+ * This file is part of the RZ Edge AI Demo.
+ *
+ * The RZ Edge AI Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZ Edge AI Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+/* Plays a recorded MJPEG stream (concatenated JPEG frames, as saved by
+ * "v4l2-ctl --stream-to" or "ffmpeg -c:v copy -f mjpeg") through mjpegDecoder
+ * at camera rate and reports the frame rate the decoder pool delivers.
+ * The last decoded frame can be written out as a PPM image to check it */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../../mjpegdecoder.h"
+
+struct jpegFrame {
+    size_t offset;
+    size_t size;
+};
+
+/* Split the stream on the start and end of image markers */
+static std::vector<jpegFrame> splitStream(const std::vector<uint8_t> &stream)
+{
+    std::vector<jpegFrame> frames;
+    size_t start = 0;
+    bool inFrame = false;
+
+    for (size_t i = 0; i + 1 < stream.size(); i++) {
+        if (stream[i] != 0xFF)
+            continue;
+
+        if (!inFrame && stream[i + 1] == 0xD8) {
+            start = i;
+            inFrame = true;
+        } else if (inFrame && stream[i + 1] == 0xD9) {
+            frames.push_back({ start, i + 2 - start });
+            inFrame = false;
+            i++;
+        }
+    }
+
+    return frames;
+}
+
+static bool writePpm(const char *filePath, const cv::Mat &frame)
+{
+    FILE *out = fopen(filePath, "wb");
+
+    if (out == NULL)
+        return false;
+
+    fprintf(out, "P6\n%d %d\n255\n", frame.cols, frame.rows);
+
+    for (int row = 0; row < frame.rows; row++)
+        fwrite(frame.ptr<uint8_t>(row), 3, frame.cols, out);
+
+    fclose(out);
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint8_t> stream;
+    std::vector<jpegFrame> frames;
+    unsigned int workers = 2;
+    double fps = 30;
+    cv::Size targetSize;
+    const char *ppmPath = NULL;
+    unsigned long received = 0;
+    cv::Mat frame;
+    FILE *in;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <stream.mjpeg> [workers] [fps] [<width>x<height>] [output.ppm]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 2)
+        workers = atoi(argv[2]);
+
+    if (argc > 3)
+        fps = atof(argv[3]);
+
+    if (argc > 4 && sscanf(argv[4], "%dx%d", &targetSize.width, &targetSize.height) != 2) {
+        fprintf(stderr, "Invalid target size %s\n", argv[4]);
+        return 1;
+    }
+
+    if (argc > 5)
+        ppmPath = argv[5];
+
+    in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    fseek(in, 0, SEEK_END);
+    stream.resize(ftell(in));
+    fseek(in, 0, SEEK_SET);
+
+    if (fread(stream.data(), 1, stream.size(), in) != stream.size()) {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+
+    fclose(in);
+
+    frames = splitStream(stream);
+
+    if (frames.empty() || fps <= 0) {
+        fprintf(stderr, "No JPEG frames found in %s\n", argv[1]);
+        return 1;
+    }
+
+    mjpegDecoder decoder(workers);
+    decoder.setTargetSize(targetSize);
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    /* Feed the frames at camera rate, as the capture thread would */
+    std::thread producer([&] {
+        std::chrono::duration<double> interval(1.0 / fps);
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * double(i)));
+            decoder.submit(stream.data() + frames[i].offset, frames[i].size);
+        }
+
+        /* Give the last frames time to finish before stopping */
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        decoder.stop();
+    });
+
+    std::chrono::steady_clock::time_point lastFrameTime = startTime;
+
+    while (decoder.getFrame(frame)) {
+        lastFrameTime = std::chrono::steady_clock::now();
+        received++;
+    }
+
+    producer.join();
+
+    double elapsed = std::chrono::duration<double>(lastFrameTime - startTime).count();
+
+    printf("frames: %zu\n", frames.size());
+    printf("delivered: %lu\n", received);
+    printf("dropped: %lu\n", (unsigned long) frames.size() - received);
+    printf("decode errors: %lu\n", decoder.getDecodeErrors());
+    printf("output size: %dx%d\n", frame.cols, frame.rows);
+    printf("fps: %.1f\n", elapsed > 0 ? received / elapsed : 0.0);
+
+    if (ppmPath != NULL && !frame.empty() && !writePpm(ppmPath, frame)) {
+        fprintf(stderr, "Cannot write %s\n", ppmPath);
+        return 1;
+    }
+
+    return 0;
+}
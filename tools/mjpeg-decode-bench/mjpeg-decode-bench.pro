@@ -0,0 +1,27 @@
+TEMPLATE = app
+TARGET = mjpeg-decode-bench
+
+QT = core
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+SOURCES += \
+    mjpeg-decode-bench.cpp \
+    ../../framepool.cpp \
+    ../../mjpegdecoder.cpp \
+    ../../pipelinetrace.cpp \
+    ../../threadplacement.cpp
+
+HEADERS += \
+    ../../framepool.h \
+    ../../mjpegdecoder.h \
+    ../../pipelinetrace.h \
+    ../../threadplacement.h
+
+INCLUDEPATH += \
+    $$(SDKTARGETSYSROOT)/usr/include/opencv4
+
+LIBS += \
+    -L $$(SDKTARGETSYSROOT)/usr/lib64 \
+    -ljpeg \
+    -lopencv_core
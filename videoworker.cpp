@@ -16,44 +16,76 @@
  * along with the RZ Edge AI Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
-#include <chrono>
-#include <thread>
-
 #include "videoworker.h"
 
 videoWorker::videoWorker(QObject *parent) :
-    QObject(parent), stopped(false), running(false), videoDelay(0)
-{}
+    QObject(parent), running(false), framePending(false), frameInterval(0)
+{
+    displayTimer.setSingleShot(true);
+    displayTimer.setTimerType(Qt::PreciseTimer);
+
+    connect(&displayTimer, SIGNAL(timeout()), this, SLOT(showPendingFrame()));
+}
 
-void videoWorker::play_video()
+/* Called for each frame the capture thread delivers. Notifications are not
+ * queued up behind a busy GUI, the camera only sends another once the frame
+ * has been taken, so the preview always continues from the newest frame */
+void videoWorker::frameArrived()
 {
-    if (!running || stopped) return;
+    qint64 sinceShown;
 
-    emit showVideo();
+    if (!running)
+        return;
+
+    sinceShown = lastShown.isValid() ? lastShown.elapsed() : frameInterval;
+
+    if (sinceShown < frameInterval) {
+        framePending = true;
+
+        if (!displayTimer.isActive())
+            displayTimer.start(int(frameInterval - sinceShown));
 
-    /* Limit play_video loop speed */
-    if (videoDelay != 0)
-        std::this_thread::sleep_for(std::chrono::milliseconds(videoDelay));
+        return;
+    }
 
-    /* Use QueuedConnection to give other threads a chance to be processed before next play_video */
-    QMetaObject::invokeMethod(this, "play_video", Qt::QueuedConnection);
+    showFrame();
+}
+
+void videoWorker::showPendingFrame()
+{
+    if (running && framePending)
+        showFrame();
+}
+
+void videoWorker::showFrame()
+{
+    framePending = false;
+    lastShown.start();
+
+    emit showVideo();
 }
 
 void videoWorker::StopVideo()
 {
-    stopped = true;
     running = false;
+    framePending = false;
+    displayTimer.stop();
 }
 
 void videoWorker::StartVideo()
 {
-    stopped = false;
     running = true;
 
-    play_video();
+    /* A frame that arrived while stopped has not been notified again */
+    showFrame();
 }
 
-void videoWorker::setDelayMS(unsigned int delay)
+/* Limits the preview to the camera frame rate, zero shows every frame as
+ * soon as it arrives */
+void videoWorker::setFrameRate(double framesPerSecond)
 {
-    videoDelay = delay;
+    if (framesPerSecond > 0)
+        frameInterval = int(1000 / framesPerSecond);
+    else
+        frameInterval = 0;
 }
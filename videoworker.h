@@ -19,15 +19,20 @@
 #ifndef VIDEOWORKER_H
 #define VIDEOWORKER_H
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QTimer>
 
+/* Schedules the camera preview on the GUI thread. A frame is shown when the
+ * capture thread reports one has arrived, no faster than the camera frame
+ * rate; frames that arrive early are shown when the display timer fires */
 class videoWorker : public QObject
 {
     Q_OBJECT
 
 public:
     explicit videoWorker(QObject *parent = 0);
-    void setDelayMS(unsigned int delay);
+    void setFrameRate(double framesPerSecond);
 
 signals:
     void showVideo();
@@ -35,14 +40,19 @@ signals:
 public slots:
     void StartVideo();
     void StopVideo();
+    void frameArrived();
 
 private slots:
-    void play_video();
+    void showPendingFrame();
 
 private:
-    bool stopped;
+    void showFrame();
+
+    QTimer displayTimer;
+    QElapsedTimer lastShown;
     bool running;
-    unsigned int videoDelay;
+    bool framePending;
+    int frameInterval;
 };
 
 #endif // VIDEOWORKER_H